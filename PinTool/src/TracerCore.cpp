@@ -2,6 +2,17 @@
 #include "amsg.h"
 #include "cli.h"
 #include "payload.h"
+#include "ring.h"
+#include "chunk.h"
+#include "budget.h"
+#include "callgraph.h"
+#include "prof.h"
+#include "sample.h"
+#include "count.h"
+#include "gram.h"
+#include "fork.h"
+#include "range.h"
+#include "ctl.h"
 #include <iostream>
 
 /**
@@ -24,7 +35,25 @@ int main(int argc, char* argv[])
         std::cout << "[!] PIN_Init failed" << std::endl;
         return EVIL_EXIT_INIT;
     }
+
+    if (EVIL_ARG == init_TrTag()) {
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrProcTag" << std::endl;
+        return EVIL_EXIT_VTAG;
+    }
     
+    if (EVIL_ARG == init_TrShm()) {
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrShmSlots or KNOB_TrShmFull" << std::endl;
+        return EVIL_EXIT_VSHM;
+    }
+
+    if (EVIL_ARG == init_TrCov()) {
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrCovPath or KNOB_TrCovType" << std::endl;
+        return EVIL_EXIT_VCOV;
+    }
+
     if (EVIL_ARG == init_TrDat()) {
         disp_usage();
         std::cout << "[!] Bad KNOB_TrDatPath" << std::endl;
@@ -43,12 +72,54 @@ int main(int argc, char* argv[])
         return EVIL_EXIT_VSCA;
     }
 
+    if (EVIL_ARG == init_TrMax()) {
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrMaxEvents or KNOB_TrMaxBytes" << std::endl;
+        return EVIL_EXIT_VMAX;
+    }
+
+    if (EVIL_ARG == init_TrSamp()){
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrSampMs or KNOB_TrSampDepth" << std::endl;
+        return EVIL_EXIT_VSMP;
+    }
+
+    if (EVIL_ARG == init_TrGram()){
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrGramN or KNOB_TrGramDim" << std::endl;
+        return EVIL_EXIT_VGRM;
+    }
+
+    if (EVIL_ARG == init_TrBlk()){
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrBlkPath" << std::endl;
+        return EVIL_EXIT_VBLK;
+    }
+
     if (EVIL_ARG == init_TrCut()){
         disp_usage();
         std::cout << "[!] Bad KNOB_TrCutName" << std::endl;
         return EVIL_EXIT_VCUT;
     }
 
+    if (EVIL_ARG == init_TrRange()){
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrRangeFile" << std::endl;
+        return EVIL_EXIT_VRNG;
+    }
+
+    if (EVIL_ARG == init_TrCtl()){
+        disp_usage();
+        std::cout << "[!] Bad KNOB_TrCtlPath or KNOB_TrCtlOff" << std::endl;
+        return EVIL_EXIT_VCTL;
+    }
+
+    SelectRecord();
+
+    if (TrRange) {
+        IMG_AddUnloadFunction(RangeImgUnload, 0);
+    }
+
     switch (TrSca)
     {
         case TL_INS:
@@ -60,11 +131,63 @@ int main(int argc, char* argv[])
         case TL_CAL:
             RTN_AddInstrumentFunction(AnalyseCAL, 0);
             break;
+        case TL_CGR:
+            RTN_AddInstrumentFunction(AnalyseCGR, 0);
+            PIN_AddThreadStartFunction(CgThreadStart, 0);
+            break;
+        case TL_IXB:
+            TRACE_AddInstrumentFunction(AnalyseIXB, 0);
+            PIN_AddContextChangeFunction(MarkEarlyExit, 0);
+            break;
+        case TL_SMP:
+            SampStart();
+            PIN_AddPrepareForFiniFunction(SampPrepareFini, 0);
+            break;
+        case TL_MUL:
+            TRACE_AddInstrumentFunction(AnalyseMUL, 0);
+            break;
+        case TL_PRF:
+            RTN_AddInstrumentFunction(AnalysePRF, 0);
+            PIN_AddThreadStartFunction(ProfThreadStart, 0);
+            PIN_AddThreadFiniFunction(ProfThreadFini, 0);
+            break;
+        case TL_CNT:
+            TRACE_AddInstrumentFunction(AnalyseCNT, 0);
+            PIN_AddThreadStartFunction(CntThreadStart, 0);
+            break;
+        case TL_GRM:
+            TRACE_AddInstrumentFunction(AnalyseGRM, 0);
+            PIN_AddThreadStartFunction(GramThreadStart, 0);
+            break;
         default:
             std::cout << "[!] Bad KNOB_TrScaType" << std::endl;
             return EVIL_EXIT_VSCA;
     }
 
+    if (TO_SHM == TrOut) {
+        PIN_AddThreadStartFunction(RingThreadStart, 0);
+    }
+
+    if (TO_CHUNK == TrOut) {
+        PIN_AddThreadStartFunction(ChunkThreadStart, 0);
+        PIN_AddThreadFiniFunction(ChunkThreadFini, 0);
+    }
+
+    if (TrBudget || TrCtl) {
+        PIN_AddDetachFunction(detach_files, 0);
+    }
+
+    if (TrCtl) {
+        CtlStart();
+        PIN_AddPrepareForFiniFunction(CtlPrepareFini, 0);
+    }
+
+    ForkInit(argc, argv);
+    PIN_AddForkFunction(FPOINT_BEFORE, ForkBefore, 0);
+    PIN_AddForkFunction(FPOINT_AFTER_IN_PARENT, ForkParent, 0);
+    PIN_AddForkFunction(FPOINT_AFTER_IN_CHILD, ForkChild, 0);
+    PIN_AddFollowChildProcessFunction(FollowChild, 0);
+
     PIN_AddFiniFunction(fini_files, 0);
     PIN_StartProgram();
     return GOOD_EXIT;
@@ -7,6 +7,24 @@
 #define TL_INS ((INT32) 100)
 #define TL_BBL ((INT32) 200)
 #define TL_CAL ((INT32) 300)
+#define TL_CGR ((INT32) 400)
+#define TL_IXB ((INT32) 500)
+#define TL_PRF ((INT32) 600)
+#define TL_MUL ((INT32) 700)
+#define TL_SMP ((INT32) 800)
+#define TL_CNT ((INT32) 900)
+#define TL_GRM ((INT32) 1000)
+
+#define LY_CAL ((UINT32) 0) //layers of `TL_MUL`, from the coarsest
+#define LY_BBL ((UINT32) 1)
+#define LY_INS ((UINT32) 2)
+#define LY_NUM ((UINT32) 3)
+#define LY_BIT(L) ((UINT32) 1 << (L))
+
+#define TO_FILE  ((INT32) 1000)
+#define TO_SHM   ((INT32) 2000)
+#define TO_CHUNK ((INT32) 3000)
+#define TO_MAP   ((INT32) 4000)
 
 #define GOOD_EXIT      ((int) 0)
 #define EVIL_EXIT_INIT ((int) 10) //about `PIN_Init`
@@ -15,5 +33,14 @@
 #define EVIL_EXIT_VCUT ((int) 101) //about `KNOB_TrCutName`
 #define EVIL_EXIT_VDAT ((int) 102) //failed file-open on `KNOB_TrDatPath`
 #define EVIL_EXIT_VSYM ((int) 103) //failed file-open on `KNOB_TrSymPath`
+#define EVIL_EXIT_VSHM ((int) 104) //about `KNOB_TrShmSlots` or `KNOB_TrShmFull`
+#define EVIL_EXIT_VMAX ((int) 105) //about `KNOB_TrMaxEvents` or `KNOB_TrMaxBytes`
+#define EVIL_EXIT_VCOV ((int) 106) //about `KNOB_TrCovPath` or `KNOB_TrCovType`
+#define EVIL_EXIT_VBLK ((int) 107) //failed file-open on `KNOB_TrBlkPath`
+#define EVIL_EXIT_VTAG ((int) 108) //about `KNOB_TrProcTag`
+#define EVIL_EXIT_VRNG ((int) 109) //about `KNOB_TrRangeFile`
+#define EVIL_EXIT_VCTL ((int) 110) //about `KNOB_TrCtlPath` or `KNOB_TrCtlOff`
+#define EVIL_EXIT_VSMP ((int) 111) //about `KNOB_TrSampMs` or `KNOB_TrSampDepth`
+#define EVIL_EXIT_VGRM ((int) 112) //about `KNOB_TrGramN` or `KNOB_TrGramDim`
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "blktab.h"
+#include "cli.h"
+#include <map>
+
+/**
+ * Static block table for `-TrScaType ixb`.
+ * Each distinct block gets an ID and one line in `-TrBlkPath`:
+ * "<id>,<addr of 1st instruction>,<addr of 2nd instruction>,..."
+ * all in hex like `hexstr`. Pin may cut the same code into blocks of
+ * different lengths in different traces, so a block is keyed by its
+ * address and number of instructions rather than address only.
+ */
+
+// IDs given so far. Only touched at instrumentation time,
+// when Pin holds its internal lock.
+static std::map<std::pair<ADDRINT, UINT32>, UINT32> BlkIds;
+
+/**
+ * Get the ID of a block, writing its line into the table
+ * when the block is seen for the first time
+ * @param Bparam BBL Object
+ * @return ID of the block, starting from 1
+ */
+UINT32 BlkId(BBL Bparam)
+{
+    const std::pair<ADDRINT, UINT32> key(BBL_Address(Bparam), BBL_NumIns(Bparam));
+    std::map<std::pair<ADDRINT, UINT32>, UINT32>::iterator it = BlkIds.find(key);
+    if (it != BlkIds.end()) { return it->second; }
+
+    const UINT32 id = static_cast<UINT32>(BlkIds.size()) + 1;
+    BlkIds[key] = id;
+    std::string line = hexstr(id);
+    for (INS I__=BBL_InsHead(Bparam); INS_Valid(I__); I__=INS_Next(I__))
+        { line += ","; line += hexstr(INS_Address(I__)); }
+    TrBlk << line << "\n";
+    return id;
+}
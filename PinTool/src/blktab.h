@@ -0,0 +1,8 @@
+#ifndef HEAD_BLKTAB_H
+#define HEAD_BLKTAB_H
+
+#include "pin.H"
+
+UINT32 BlkId(BBL Bparam);
+
+#endif
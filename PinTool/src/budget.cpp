@@ -0,0 +1,88 @@
+#include "budget.h"
+#include "amsg.h"
+#include "cli.h"
+#include "ring.h"
+#include "chunk.h"
+#include "mapout.h"
+#include <iostream>
+
+// Global Variable
+// Set once the budget is exhausted. Analyse routines still
+// running before the detach completes check it and do nothing.
+std::atomic<bool> TrStop(false);
+
+static std::atomic<UINT64> UsedEvents(0);
+static std::atomic<UINT64> UsedBytes(0);
+
+/**
+ * Charge some records to the budget of `-TrMaxEvents` / `-TrMaxBytes`,
+ * and stop tracing once either is reached.
+ * With trace files, it must be called while holding the lock of writing files.
+ * @param tid Pin thread ID
+ * @param events number of records
+ * @param bytes number of bytes those records take
+ */
+VOID BudgetCharge(THREADID tid, UINT64 events, UINT64 bytes)
+{
+    UINT64 ev = UsedEvents.fetch_add(events, std::memory_order_relaxed) + events;
+    UINT64 by = UsedBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if ((TrMaxEvents && ev >= TrMaxEvents) || (TrMaxBytes && by >= TrMaxBytes))
+        { StopTrace(tid); }
+}
+
+/**
+ * Give a forked child a budget of its own
+ */
+VOID BudgetFork()
+{
+    UsedEvents.store(0, std::memory_order_relaxed);
+    UsedBytes.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Finalize the outputs with a truncation marker and detach Pin,
+ * so the target finishes at native speed. Only the first call works.
+ * With trace files, it must be called while holding the lock of writing files.
+ * @param tid Pin thread ID
+ */
+VOID StopTrace(THREADID tid)
+{
+    if (TrStop.exchange(true)) { return; }
+
+    const UINT64 ev = UsedEvents.load(std::memory_order_relaxed);
+    const UINT64 by = UsedBytes.load(std::memory_order_relaxed);
+    if (TO_SHM == TrOut) {
+        RingMark(tid, ev);
+        RingClose();
+    } else if (TO_CHUNK == TrOut) {
+        ChunkFinish(CHK_FLAG_TRUNC);
+    } else if (TO_MAP == TrOut) {
+        const std::string mark = "#TRUNCATED events=" + decstr(ev) + " bytes=" + decstr(by) + "\n";
+        MapWrite(MapDat, mark);
+        MapWrite(MapSym, mark);
+        MapFinish(MapDat, MAP_FLAG_TRUNC);
+        MapFinish(MapSym, MAP_FLAG_TRUNC);
+    } else {
+        const std::string mark = "#TRUNCATED events=" + decstr(ev) + " bytes=" + decstr(by);
+        if (TrDat.is_open()) { TrDat << mark << std::endl; TrDat.close(); }
+        if (TrSym.is_open()) { TrSym << mark << std::endl; TrSym.close(); }
+        for (UINT32 l = 0; l < LY_NUM; ++l) {
+            if (TrLayDat[l].is_open()) { TrLayDat[l] << mark << std::endl; TrLayDat[l].close(); }
+            if (TrLaySym[l].is_open()) { TrLaySym[l] << mark << std::endl; TrLaySym[l].close(); }
+        }
+    }
+    std::cout << "[-] Budget exhausted after " << ev << " records, detaching" << std::endl;
+    PIN_Detach();
+}
+
+/**
+ * Detach callback, since `fini_files` is not called after `PIN_Detach`.
+ * Outputs have been finalized by `StopTrace` already, unless the
+ * detach is asked by `-TrCtlPath` and they are closed here.
+ * @param V from default signature & unused
+ */
+VOID detach_files(VOID *V)
+{
+    if (!TrStop.load(std::memory_order_relaxed)) { close_files(); }
+    std::cout << "[-] Detached. Hope to see you again :-) " << std::endl;
+}
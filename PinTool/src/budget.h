@@ -0,0 +1,18 @@
+#ifndef HEAD_BUDGET_H
+#define HEAD_BUDGET_H
+
+#include "pin.H"
+#include <atomic>
+
+// Records are charged to the budget in batches of this size
+// when they are pushed into shared-memory rings without a lock.
+#define BUDGET_BATCH ((UINT64) 1024)
+
+extern std::atomic<bool> TrStop;
+
+VOID BudgetCharge(THREADID tid, UINT64 events, UINT64 bytes);
+VOID StopTrace(THREADID tid);
+VOID BudgetFork();
+VOID detach_files(VOID *V);
+
+#endif
@@ -0,0 +1,235 @@
+#include "callgraph.h"
+#include "cgraph.h"
+#include "checker.h"
+#include "cli.h"
+#include "ctl.h"
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Call-graph mode for `-TrScaType cg`.
+ * Every call instruction in the main executable leaves its site, target
+ * and routine in the state of its thread. When a routine passing the same
+ * filter as `AnalyseCAL` is entered, the (caller, callee, site) edge
+ * of that thread is counted, with the site only if it called this
+ * routine. A call through a PLT stub targets the stub, so a routine
+ * reached that way (e.g. in a shared library with `-TrRangeFile`)
+ * counts as from nowhere. Nothing is shared between threads on the
+ * hot path, and all maps are merged once in `CgSave`.
+ */
+
+struct CgKey
+{
+    ADDRINT caller;
+    ADDRINT callee;
+    ADDRINT site;
+    bool operator==(const CgKey &o) const
+        { return caller == o.caller && callee == o.callee && site == o.site; }
+};
+
+struct CgKeyHash
+{
+    size_t operator()(const CgKey &k) const {
+        UINT64 h = k.site * 0x9E3779B97F4A7C15ULL;
+        h ^= (h >> 29) + k.callee * 0xBF58476D1CE4E5B9ULL;
+        h ^= (h >> 31) + k.caller;
+        return static_cast<size_t>(h);
+    }
+};
+
+typedef std::unordered_map<CgKey, UINT64, CgKeyHash> CgMap;
+
+// State of a thread, only touched by that thread until `CgSave`.
+// `last` caches the counter of the previous edge, since a loop
+// calling the same routine hits one edge many times in a row.
+struct alignas(64) CgThread
+{
+    CgMap*  edges;
+    ADDRINT site;
+    ADDRINT target;
+    ADDRINT caller;
+    CgKey   key;
+    UINT64* last;
+};
+
+static CgThread CgState[PIN_MAX_THREADS];
+
+// Symbol string of each routine seen at instrumentation time,
+// keyed by its address. Pin holds its internal lock meanwhile.
+static std::map<ADDRINT, std::string> CgNames;
+
+/**
+ * Thread start callback. Pin reuses thread IDs,
+ * so a reused ID keeps adding to the same map.
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param flags from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID CgThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    CgThread &t = CgState[tid];
+    if (!t.edges) { t.edges = new CgMap(); }
+    t.site   = 0;
+    t.target = 0;
+    t.caller = 0;
+    t.last   = 0;
+}
+
+/**
+ * Forget the edges counted by the parent in a forked child.
+ * The thread which forked keeps its caller and call site.
+ */
+VOID CgFork()
+{
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        if (CgState[i].edges) { CgState[i].edges->clear(); }
+        CgState[i].last = 0;
+    }
+}
+
+/**
+ * Analyse Routine before a call instruction
+ * @param tid Pin thread ID
+ * @param site address of the call instruction
+ * @param target address it calls
+ * @param caller address of the routine holding it
+ */
+static VOID PIN_FAST_ANALYSIS_CALL CgCall(THREADID tid, ADDRINT site, ADDRINT target, ADDRINT caller)
+{
+    CgThread &t = CgState[tid];
+    t.site   = site;
+    t.target = target;
+    t.caller = caller;
+}
+
+/**
+ * Analyse Routine at the entry of a routine. The pending call site
+ * is consumed, so an entry without a call counts as from nowhere, and
+ * so does one after a call to another routine (e.g. a blocked one or
+ * one in libc) which left its site pending.
+ * @param tid Pin thread ID
+ * @param callee address of the entered routine
+ */
+static VOID PIN_FAST_ANALYSIS_CALL CgEnter(THREADID tid, ADDRINT callee)
+{
+    CgThread &t = CgState[tid];
+    const BOOL called = (t.target == callee);
+    const CgKey k = {called ? t.caller : 0, callee, called ? t.site : 0};
+    t.site   = 0;
+    t.target = 0;
+    t.caller = 0;
+    if (t.last && t.key == k) { ++*t.last; return; }
+    t.key  = k;
+    t.last = &(*t.edges)[k];
+    ++*t.last;
+}
+
+/**
+ * Instrumentation Routine for the call graph.
+ * Call sites are taken from every routine of the main executable,
+ * while callees are filtered just like `AnalyseCAL`.
+ * With `-TrCtlPath`, edges are only counted while recording is on.
+ * @param Rparam Routine Object
+ * @param Vparam from default signature & unused
+ */
+VOID AnalyseCGR(RTN Rparam, VOID *Vparam)
+{
+    if (!IsInsideMain(Rparam)) { return; }
+    const ADDRINT raddr = RTN_Address(Rparam);
+    const BOOL callee = !IsBlocked(Rparam);
+
+    std::string rname; DumpSymInfo(rname, Rparam);
+    CgNames[raddr] = rname;
+
+    typedef VOID (*INSERTER)(INS, IPOINT, AFUNPTR, ...);
+    INSERTER insert = TrCtl ? INSERTER(INS_InsertThenCall) : INSERTER(INS_InsertCall);
+    RTN_Open(Rparam);
+    INS head = RTN_InsHead(Rparam);
+    if (callee && INS_Valid(head)) {
+        if (TrCtl) { INS_InsertIfCall(head, IPOINT_BEFORE, AFUNPTR(CtlIsOn), IARG_FAST_ANALYSIS_CALL, IARG_END); }
+        insert(head, IPOINT_BEFORE, AFUNPTR(CgEnter),
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID,
+                IARG_ADDRINT, raddr,
+            IARG_END);
+    }
+    for (INS I__=head; INS_Valid(I__); I__=INS_Next(I__)) {
+        if (!INS_IsCall(I__)) { continue; }
+        if (TrCtl) { INS_InsertIfCall(I__, IPOINT_BEFORE, AFUNPTR(CtlIsOn), IARG_FAST_ANALYSIS_CALL, IARG_END); }
+        insert(I__, IPOINT_BEFORE, AFUNPTR(CgCall),
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID,
+                IARG_ADDRINT, INS_Address(I__),
+                IARG_BRANCH_TARGET_ADDR,
+                IARG_ADDRINT, raddr,
+            IARG_END);
+    }
+    RTN_Close(Rparam);
+}
+
+/**
+ * Merge the maps of all threads and write the call-graph file.
+ * Must be called after the application threads have finished.
+ * @param os where the file goes
+ * @return whether it is fully written
+ */
+BOOL CgSave(std::ostream &os)
+{
+    CgMap all;
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        if (!CgState[i].edges) { continue; }
+        for (CgMap::const_iterator it = CgState[i].edges->begin(); it != CgState[i].edges->end(); ++it)
+            { all[it->first] += it->second; }
+        delete CgState[i].edges;
+        CgState[i].edges = 0;
+        CgState[i].last  = 0;
+    }
+
+    // Number routines in the order of address,
+    // and keep the ones never seen at instrumentation too.
+    for (CgMap::const_iterator it = all.begin(); it != all.end(); ++it) {
+        if (it->first.caller) { CgNames.insert(std::make_pair(it->first.caller, std::string())); }
+        CgNames.insert(std::make_pair(it->first.callee, std::string()));
+    }
+    std::unordered_map<ADDRINT, UINT32> index;
+    std::vector<CgRtn> rtns;
+    std::string strs;
+    for (std::map<ADDRINT, std::string>::const_iterator it = CgNames.begin(); it != CgNames.end(); ++it) {
+        CgRtn r;
+        r.addr    = it->first;
+        r.str_off = static_cast<UINT32>(strs.size());
+        r.str_len = static_cast<UINT32>(it->second.size());
+        strs += it->second;
+        index[it->first] = static_cast<UINT32>(rtns.size());
+        rtns.push_back(r);
+    }
+
+    std::vector<CgEdge> edges;
+    edges.reserve(all.size());
+    for (CgMap::const_iterator it = all.begin(); it != all.end(); ++it) {
+        CgEdge e;
+        e.caller = it->first.caller ? index[it->first.caller] : CG_NO_RTN;
+        e.callee = index[it->first.callee];
+        e.site   = it->first.site;
+        e.count  = it->second;
+        edges.push_back(e);
+    }
+
+    CgHead head;
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, CG_MAGIC, sizeof(head.magic));
+    head.version = CG_VERSION;
+    head.n_rtn   = static_cast<UINT32>(rtns.size());
+    head.n_edge  = edges.size();
+    head.str_len = strs.size();
+
+    os.write(reinterpret_cast<const char*>(&head), sizeof(head));
+    if (rtns.size()) { os.write(reinterpret_cast<const char*>(&rtns[0]), rtns.size() * sizeof(CgRtn)); }
+    if (edges.size()) { os.write(reinterpret_cast<const char*>(&edges[0]), edges.size() * sizeof(CgEdge)); }
+    os.write(strs.data(), strs.size());
+    os.flush();
+    return os.good();
+}
@@ -0,0 +1,12 @@
+#ifndef HEAD_CALLGRAPH_H
+#define HEAD_CALLGRAPH_H
+
+#include "pin.H"
+#include <ostream>
+
+VOID AnalyseCGR(RTN Rparam, VOID *Vparam);
+VOID CgThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v);
+VOID CgFork();
+BOOL CgSave(std::ostream &os);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef HEAD_CGRAPH_H
+#define HEAD_CGRAPH_H
+
+// Layout of the call-graph file written by `-TrScaType cg`.
+// This header does not depend on Pin, so readers (see `TraceTools`)
+// include the very same file.
+//
+// | CgHead | CgRtn[n_rtn] | CgEdge[n_edge] | names (str_len bytes) |
+//
+// Routines are numbered by their position in the table. An edge from
+// `CG_NO_RTN` means the callee was entered without a known call site,
+// e.g. by a tail jump or from code outside the main executable.
+
+#include <cstdint>
+
+#define CG_MAGIC   "TRCGRPH"
+#define CG_VERSION ((uint32_t) 1)
+#define CG_NO_RTN  ((uint32_t) -1)
+
+struct CgHead
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t n_rtn;
+    uint64_t n_edge;
+    uint64_t str_len;
+};
+
+struct CgRtn
+{
+    uint64_t addr;
+    uint32_t str_off;   //symbol string in the name area
+    uint32_t str_len;
+};
+
+struct CgEdge
+{
+    uint32_t caller;    //index in the routine table, or `CG_NO_RTN`
+    uint32_t callee;
+    uint64_t site;      //address of the call instruction, 0 if unknown
+    uint64_t count;
+};
+
+#endif
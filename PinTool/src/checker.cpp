@@ -1,10 +1,12 @@
 #include "checker.h"
 #include "cli.h"
+#include "range.h"
+#include "ctl.h"
 
 /**
  * Dump symbol info of the input routine.
- * When macro `DISABLE_DUMP_SECTON_INFO` is 
- * not defined, the info string is in a format like
+ * When `-TrSecInfo` is on, the info string
+ * is in a format like
  * "<section name>+<offset>:<routine name>".
  * Otherwise the string equals to name of
  * the routine. 
@@ -15,23 +17,20 @@
 void DumpSymInfo(std::string &s_recv, RTN &rtni)
 {
     if (!RTN_Valid(rtni)) { s_recv = ""; return; }
-#ifndef DISABLE_DUMP_SECTON_INFO
+    if (!TrSecInfo) { s_recv = RTN_Name(rtni); return; }
     SEC rtn_inside = RTN_Sec(rtni);
     s_recv =  SEC_Name(rtn_inside);
     s_recv += "+";
     s_recv += hexstr(RTN_Address(rtni) - SEC_Address(rtn_inside));
     s_recv += ":";
     s_recv += RTN_Name(rtni);
-#else
-    s_recv = RTN_Name(rtni);
-#endif
 }
 
 /**
  * Dump symbol info of the routine which the 
  * input address belongs to. 
- * When macro `DISABLE_DUMP_SECTON_INFO` is 
- * not defined, the info string is in a format like
+ * When `-TrSecInfo` is on, the info string
+ * is in a format like
  * "<section name>+<offset>:<routine name>".
  * Otherwise the string equals to name of
  * the routine. 
@@ -41,7 +40,7 @@ void DumpSymInfo(std::string &s_recv, RTN &rtni)
  */
 void DumpSymInfo(std::string &s_recv, ADDRINT addr)
 {
-#ifndef DISABLE_DUMP_SECTON_INFO
+    if (!TrSecInfo) { s_recv = RTN_FindNameByAddress(addr); return; }
     PIN_LockClient();
     RTN rtn_found = RTN_FindByAddress(addr);
     if (!RTN_Valid(rtn_found)) { PIN_UnlockClient(); s_recv = ""; return; }
@@ -52,9 +51,34 @@ void DumpSymInfo(std::string &s_recv, ADDRINT addr)
     s_recv += ":";
     s_recv += RTN_Name(rtn_found);
     PIN_UnlockClient();
-#else
-    s_recv = RTN_FindNameByAddress(addr);
-#endif
+}
+
+/**
+ * Quote a name as a CSV field, doubling the quotes inside
+ * @param name routine name or symbol string
+ * @return the field with its quotes
+ */
+std::string CsvQuote(const std::string &name)
+{
+    std::string q = "\"";
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == '"') { q += '"'; }
+        q += name[i];
+    }
+    return q + "\"";
+}
+
+/**
+ * Name of a frame inside a folded stack,
+ * where ';' separates frames and ' ' starts the count
+ * @param name routine name or symbol string
+ * @return the name with both replaced by '_'
+ */
+std::string FoldName(std::string name)
+{
+    for (size_t i = 0; i < name.size(); ++i)
+        { if (name[i] == ';' || name[i] == ' ') { name[i] = '_'; } }
+    return name;
 }
 
 /**
@@ -116,10 +140,15 @@ bool IsBlocked(RTN &rtni)
 
 /**
  * Whether the address is inside the image Pin was applied on in the command line.
+ * With `-TrRangeFile`, whether it is inside those ranges instead,
+ * which may be in any image.
+ * Nothing is while recording is off by `-TrCtlPath`.
  * @param addr memory address
  * @return true or false
  */
 bool IsInsideMain(ADDRINT addr){
+    if (!TrOn.load(std::memory_order_relaxed)) { return false; }
+    if (TrRange) { return RangeHas(addr); }
     IMG imgi = IMG_FindByAddress(addr);
 
     if (!IMG_Valid(imgi)) { return false; }
@@ -128,17 +157,40 @@ bool IsInsideMain(ADDRINT addr){
 
 /**
  * Whether the routine is inside the image Pin was applied on in the command line.
+ * With `-TrRangeFile`, whether its entry is inside those ranges instead.
+ * Unlike traces, routines are not instrumented again when recording
+ * is switched by `-TrCtlPath`, so callers gate on `CtlIsOn` themselves.
  * @param rtni Routine Object
  * @return true or false
  */
 bool IsInsideMain(RTN &rtni){
     if (!RTN_Valid(rtni)) { return false; }
+    if (TrRange) { return RangeHas(RTN_Address(rtni)); }
     IMG imgi = SEC_Img(RTN_Sec(rtni));
 
     if (!IMG_Valid(imgi)) { return false; }
     else { return IMG_IsMainExecutable(imgi); }
 }
 
+/**
+ * Key of an address which stays the same across runs despite ASLR:
+ * its offset in its image, mixed with an FNV-1a hash of the file name
+ * of the image. The directory is left out so copies of a binary share
+ * keys, while equal offsets in different images do not.
+ * @param addr memory address inside any image
+ * @return the key, not spread out yet
+ */
+UINT64 ImgOffsetKey(ADDRINT addr)
+{
+    IMG imgi = IMG_FindByAddress(addr);
+    if (!IMG_Valid(imgi)) { return addr; }
+    UINT64 img = 0xCBF29CE484222325ULL;
+    const std::string name = IMG_Name(imgi);
+    for (size_t i = name.rfind('/') + 1; i < name.size(); ++i)
+        { img = (img ^ (UINT8) name[i]) * 0x100000001B3ULL; }
+    return (addr - IMG_LowAddress(imgi)) ^ img;
+}
+
 /**
  * Interface for operating `PtrVec`
  * @param SymStr A string waiting to be processed
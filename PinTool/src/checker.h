@@ -8,6 +8,9 @@
 void DumpSymInfo(std::string &s_recv, ADDRINT addr);
 void DumpSymInfo(std::string &s_recv, RTN    &rtni);
 
+std::string CsvQuote(const std::string &name);
+std::string FoldName(std::string name);
+
 bool IsBlockedName(const std::string &SN);
 bool IsBlocked(const std::string &name);
 bool IsBlocked(ADDRINT            addr);
@@ -16,6 +19,8 @@ bool IsBlocked(RTN               &rtni);
 bool IsInsideMain(ADDRINT addr);
 bool IsInsideMain(RTN    &rtni);
 
+UINT64 ImgOffsetKey(ADDRINT addr);
+
 // There are only limited types of parameters can be accepted by
 // an analyse routine. We should allocate some memory to place the
 // symbol string and pass the pointer to analyse routine. Also, we should
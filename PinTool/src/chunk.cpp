@@ -0,0 +1,202 @@
+#include "chunk.h"
+#include "amsg.h"
+#include "cli.h"
+#include "budget.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/**
+ * Chunked container for `-TrDatPath chunk:<path>`.
+ * Each thread fills a buffer of its own without any lock. A full
+ * buffer is encoded by its thread as well, so the lock is only taken
+ * to append the encoded chunk to the file. The layout is described
+ * in `trchunk.h`.
+ */
+
+// Records of a thread which are not written yet
+struct ChunkBuf
+{
+    UINT64        rec[CHK_MAX_EVENTS];
+    unsigned char out[CHK_MAX_BYTES];
+    UINT32        n;
+    UINT64        seq; //records of this thread written so far
+};
+
+static ChunkBuf*             Bufs[PIN_MAX_THREADS];
+static PIN_LOCK              ChunkLock; //guards all below
+static UINT64                ChunkOff = 0;
+static std::vector<ChkIndex> ChunkIdx;
+static BOOL                  ChunkDone = FALSE;
+
+/**
+ * Open the container and write its file header
+ * @param path path of the container
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for a failed `open`
+ */
+INT32 ChunkOpen(const std::string &path)
+{
+    TrDat.open(path.c_str(), std::ios::out|std::ios::trunc|std::ios::binary);
+    if (!TrDat.is_open()) { return EVIL_ARG; }
+    ChkFile fh;
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, CHK_MAGIC, sizeof(fh.magic));
+    fh.version = CHK_VERSION;
+    TrDat.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+    ChunkOff = sizeof(fh);
+    return TrDat.good() ? GOOD_ARG : EVIL_ARG;
+}
+
+/**
+ * Encode the buffer of a thread and append it as a chunk
+ * @param tid Pin thread ID
+ * @param b buffer of the thread, emptied afterwards
+ */
+static VOID ChunkFlush(THREADID tid, ChunkBuf &b)
+{
+    if (0 == b.n) { return; }
+    ChkHead ch;
+    memset(&ch, 0, sizeof(ch));
+    ch.magic     = CHK_HEAD_MAGIC;
+    ch.tid       = tid;
+    ch.first_seq = b.seq;
+    ch.count     = b.n;
+    ch.bytes     = ChkEncode(b.rec, b.n, b.out);
+    ch.crc       = ChkCrc(b.out, ch.bytes);
+    b.seq += b.n;
+    b.n = 0;
+
+    PIN_GetLock(&ChunkLock, tid + 1);
+    if (!ChunkDone && !TrStop.load(std::memory_order_relaxed)) {
+        ChkIndex ent;
+        ent.offset    = ChunkOff;
+        ent.first_seq = ch.first_seq;
+        ent.tid       = ch.tid;
+        ent.count     = ch.count;
+        TrDat.write(reinterpret_cast<const char*>(&ch), sizeof(ch));
+        TrDat.write(reinterpret_cast<const char*>(b.out), ch.bytes);
+        ChunkOff += sizeof(ch) + ch.bytes;
+        ChunkIdx.push_back(ent);
+        if (TrBudget) { BudgetCharge(tid, ch.count, sizeof(ch) + ch.bytes); }
+    }
+    PIN_ReleaseLock(&ChunkLock);
+}
+
+/**
+ * Write the index and the footer, then close the container.
+ * Only the first call works. Buffers not flushed yet are lost,
+ * see `ChunkClose` for the normal exit.
+ * Must be called while holding the lock of the container,
+ * or when no other thread is running.
+ * @param flags `CHK_FLAG_*` kept in the footer
+ */
+VOID ChunkFinish(UINT32 flags)
+{
+    if (ChunkDone) { return; }
+    ChunkDone = TRUE;
+    ChkFoot ft;
+    memset(&ft, 0, sizeof(ft));
+    ft.n_chunk   = ChunkIdx.size();
+    ft.off_index = ChunkOff;
+    ft.flags     = flags;
+    memcpy(ft.magic, CHK_FOOT_MAGIC, sizeof(ft.magic));
+    if (ChunkIdx.size())
+        { TrDat.write(reinterpret_cast<const char*>(&ChunkIdx[0]), ChunkIdx.size() * sizeof(ChkIndex)); }
+    TrDat.write(reinterpret_cast<const char*>(&ft), sizeof(ft));
+    TrDat.close();
+}
+
+/**
+ * Flush what every thread has left and finish the container at fini
+ */
+VOID ChunkClose()
+{
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i)
+        { if (Bufs[i]) { ChunkFlush(i, *Bufs[i]); } }
+    PIN_GetLock(&ChunkLock, 1);
+    ChunkFinish(0);
+    PIN_ReleaseLock(&ChunkLock);
+}
+
+/**
+ * Hold or release the lock of the container around a fork,
+ * so the child never inherits a half-written chunk
+ * @param hold `TRUE` before the fork, `FALSE` in the parent after it
+ */
+VOID ChunkHold(BOOL hold)
+{
+    if (hold) { PIN_GetLock(&ChunkLock, 1); TrDat.flush(); }
+    else { PIN_ReleaseLock(&ChunkLock); }
+}
+
+/**
+ * Start a container of its own in a forked child. Records
+ * buffered by the parent are dropped and sequences restart.
+ * @param path path of the new container
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for a failed `open`
+ */
+INT32 ChunkFork(const std::string &path)
+{
+    PIN_InitLock(&ChunkLock);
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i)
+        { if (Bufs[i]) { Bufs[i]->n = 0; Bufs[i]->seq = 0; } }
+    ChunkIdx.clear();
+    ChunkDone = FALSE;
+    TrDat.close();
+    return ChunkOpen(path);
+}
+
+/**
+ * Thread start callback. Pin reuses thread IDs, so the buffer
+ * and the sequence number of an ID are kept.
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param flags from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID ChunkThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    if (tid >= PIN_MAX_THREADS || Bufs[tid]) { return; }
+    ChunkBuf* b = new ChunkBuf;
+    b->n   = 0;
+    b->seq = 0;
+    Bufs[tid] = b;
+}
+
+/**
+ * Thread fini callback, which writes what the thread has left
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param code from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID ChunkThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    if (tid < PIN_MAX_THREADS && Bufs[tid]) { ChunkFlush(tid, *Bufs[tid]); }
+}
+
+/**
+ * Analyse Routine for appending a record to the buffer of current thread
+ * @tparam BUDGET whether `-TrMaxEvents` / `-TrMaxBytes` is set
+ * @param tid Pin thread ID
+ * @param addr memory address
+ */
+template<BOOL BUDGET>
+static VOID PIN_FAST_ANALYSIS_CALL ChunkPush(THREADID tid, ADDRINT addr)
+{
+    if (BUDGET && TrStop.load(std::memory_order_relaxed)) { return; }
+    ChunkBuf* b = (tid < PIN_MAX_THREADS) ? Bufs[tid] : 0;
+    if (!b) { return; }
+    b->rec[b->n] = addr;
+    if (++b->n == CHK_MAX_EVENTS) { ChunkFlush(tid, *b); }
+}
+
+/**
+ * Get the analyse routine for appending a record
+ * @param budget whether `-TrMaxEvents` / `-TrMaxBytes` is set
+ * @return the instance of `ChunkPush` to insert
+ */
+AFUNPTR ChunkPushFn(BOOL budget)
+{
+    return budget ? AFUNPTR(ChunkPush<TRUE>) : AFUNPTR(ChunkPush<FALSE>);
+}
\ No newline at end of file
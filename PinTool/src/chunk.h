@@ -0,0 +1,18 @@
+#ifndef HEAD_CHUNK_H
+#define HEAD_CHUNK_H
+
+#include "pin.H"
+#include "trchunk.h"
+#include <string>
+
+INT32 ChunkOpen(const std::string &path);
+VOID  ChunkFinish(UINT32 flags);
+VOID  ChunkClose();
+VOID  ChunkHold(BOOL hold);
+INT32 ChunkFork(const std::string &path);
+
+VOID ChunkThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v);
+VOID ChunkThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v);
+AFUNPTR ChunkPushFn(BOOL budget);
+
+#endif
\ No newline at end of file
@@ -1,11 +1,26 @@
 #include "cli.h"
 #include "amsg.h"
+#include "ring.h"
+#include "chunk.h"
+#include "mapout.h"
+#include "cov.h"
+#include "callgraph.h"
+#include "prof.h"
+#include "sample.h"
+#include "count.h"
+#include "gram.h"
+#include "range.h"
+#include "ctl.h"
+#include "budget.h"
 #include <iostream>
 #include <sstream>
 
 /**
  * Command line option '-TrDatPath'
- * Must be explicitly specified as a writable file path.
+ * Must be explicitly specified as a writable file path,
+ * or 'shm:<name>' to push records into a shared-memory ring,
+ * or 'chunk:<path>' to write a chunked binary container,
+ * or 'map:<path>' to write a trace file through a shared mapping.
  * WARNNING: 
  * If nothing is specified or contains non-existent folder, 
  * `TracerCore` will exit immediately.
@@ -15,7 +30,11 @@ KNOB<std::string> KNOB_TrDatPath(
     "pintool",
     "TrDatPath",
     "", //set default value
-    "Specify the path of output trace file."
+    "Specify the path of output trace file. "
+    "Use 'shm:<name>' to write into shared memory '/dev/shm/<name>' instead, "
+    "or 'chunk:<path>' to write a chunked binary container for parallel decoding, "
+    "or 'map:<path>' to write the trace file through a shared mapping, "
+    "which keeps every complete record even if the target is killed."
 );
 
 /**
@@ -23,13 +42,82 @@ KNOB<std::string> KNOB_TrDatPath(
  * If not specified, no trace symbol file will be generated.
  * Otherwise a non-writable file path will make
  * `TracerCore` exit immediately.
+ * With a shared-memory '-TrDatPath', any non-empty value
+ * means publishing symbols into the same segment.
  */
 KNOB<std::string> KNOB_TrSymPath(
     KNOB_MODE_WRITEONCE,
     "pintool",
     "TrSymPath",
     "", //set default value
-    "Specify the path of output trace symbol file."
+    "Specify the path of output trace symbol file. "
+    "Any non-empty value publishes symbols into the segment for 'shm:<name>'."
+);
+
+/**
+ * Command line option '-TrSecInfo'
+ * 1 => symbols look like "<section name>+<offset>:<routine name>"
+ * 0 => symbols are names of routines only
+ * Building with macro `DISABLE_DUMP_SECTON_INFO` makes 0 the default.
+ */
+KNOB<BOOL> KNOB_TrSecInfo(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrSecInfo",
+#ifndef DISABLE_DUMP_SECTON_INFO
+    "1", //set default value
+#else
+    "0", //set default value
+#endif
+    "Specify whether symbols carry the section and the offset. "
+    "Otherwise they are names of routines only."
+);
+
+/**
+ * Command line option '-TrShmSlots'
+ * Only works with a shared-memory '-TrDatPath'.
+ * Each thread has a ring with this many records.
+ */
+KNOB<UINT32> KNOB_TrShmSlots(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrShmSlots",
+    "65536", //set default value
+    "Specify the number of records in the ring of each thread. "
+    "Must be a power of 2."
+);
+
+/**
+ * Command line option '-TrShmFull'
+ * Only works with a shared-memory '-TrDatPath'.
+ * 'block' => wait until the consumer frees some slots,
+ *             or drop once it freed nothing for `SHM_BLOCK_MS`
+ * 'drop'  => drop the record and count it
+ */
+KNOB<std::string> KNOB_TrShmFull(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrShmFull",
+    "block", //set default value
+    "Specify what to do when a ring is full. "
+    "Must be 'block' or 'drop'. A blocked ring which is not drained "
+    "for 5 seconds drops records from then on."
+);
+
+/**
+ * Command line option '-TrBlkPath'
+ * Only works with '-TrScaType ixb', and must be a writable
+ * file path then. The static table of blocks goes there.
+ * It does not work with a chunked container.
+ */
+KNOB<std::string> KNOB_TrBlkPath(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrBlkPath",
+    "", //set default value
+    "Specify the path of output block table for '-TrScaType ixb'. "
+    "Each line lists the ID of a block and its instruction addresses. "
+    "Not with 'chunk:' outputs."
 );
 
 /**
@@ -53,6 +141,14 @@ KNOB<std::string> KNOB_TrCutName(
  * 'ins' => instruction   level
  * 'bbl' => basic block   level
  * 'cal' => function call level
+ * 'cg'  => call graph, edges with counts rather than a trace
+ * 'ixb' => instruction level, recorded as blocks and expanded offline
+ * 'prof'=> cycles spent in each routine rather than a trace
+ * 'samp'=> stacks sampled on a timer rather than a trace
+ * 'cnt' => calls, blocks and instructions of each routine rather than a trace
+ * 'gram'=> hashed counts of block n-grams rather than a trace
+ * Several of 'cal', 'bbl' and 'ins' joined by '+' give every view
+ * in one run, at about the cost of the finest one.
  */
 KNOB<std::string> KNOB_TrScaType(
     KNOB_MODE_WRITEONCE,
@@ -60,7 +156,184 @@ KNOB<std::string> KNOB_TrScaType(
     "TrScaType",
     "bbl", //set default value
     "Specify the granularity of trace. "
-    "Must be 'ins' or 'bbl' or 'cal'."
+    "Must be 'ins' or 'bbl' or 'cal', or 'cg' for a call graph file, "
+    "or 'ixb' for instructions recorded as blocks (needs '-TrBlkPath'), "
+    "or 'prof' for folded stacks with cycles (and a CSV summary at '-TrSymPath'), "
+    "or 'samp' for folded stacks sampled on a timer (and a CSV summary at '-TrSymPath'), "
+    "or 'cnt' for a CSV of calls, blocks and instructions of each routine, "
+    "or 'gram' for a vector of hashed block n-gram counts (see '-TrGramN' and '-TrGramDim'), "
+    "or several of 'cal', 'bbl' and 'ins' joined by '+' (like 'cal+bbl+ins') in one run, "
+    "where the finest goes to '-TrDatPath' and each coarser one to '<path>.cal' or '<path>.bbl'."
+);
+
+/**
+ * Command line option '-TrMaxEvents'
+ * 0 means no limit. Once reached, the outputs are finalized
+ * with a truncation marker and Pin detaches from the target.
+ * Only works with traces, not with 'cg', 'prof', 'samp', 'cnt' or 'gram'.
+ */
+KNOB<UINT64> KNOB_TrMaxEvents(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrMaxEvents",
+    "0", //set default value
+    "Specify the max number of records to write. "
+    "Pin detaches when it is reached. 0 means no limit. "
+    "Only works with traces, not with 'cg', 'prof', 'samp', 'cnt' or 'gram'."
+);
+
+/**
+ * Command line option '-TrMaxBytes'
+ * 0 means no limit. Works like '-TrMaxEvents' and
+ * counts bytes of trace file and trace symbol file.
+ */
+KNOB<UINT64> KNOB_TrMaxBytes(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrMaxBytes",
+    "0", //set default value
+    "Specify the max number of bytes to write. "
+    "Pin detaches when it is reached. 0 means no limit."
+);
+
+/**
+ * Command line option '-TrCovPath'
+ * If not specified, every record is written as usual.
+ * Otherwise only blocks never seen in the global coverage
+ * map at this path are recorded, and the map is updated.
+ * Runs sharing a map must use the same '-TrCovType'.
+ */
+KNOB<std::string> KNOB_TrCovPath(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrCovPath",
+    "", //set default value
+    "Specify the path of a global coverage map shared by runs. "
+    "Only records never seen in it are written. It is created if missing."
+);
+
+/**
+ * Command line option '-TrCovType'
+ * Only works with '-TrCovPath'.
+ * 'blk'  => a record is new if its address is new
+ * 'edge' => a record is new if the edge from the last
+ *           record of the same thread to it is new
+ */
+KNOB<std::string> KNOB_TrCovType(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrCovType",
+    "blk", //set default value
+    "Specify what counts as new in the global coverage map. "
+    "Must be 'blk' or 'edge'."
+);
+
+/**
+ * Command line option '-TrSampMs'
+ * Only works with '-TrScaType samp'.
+ */
+KNOB<UINT32> KNOB_TrSampMs(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrSampMs",
+    "10", //set default value
+    "Specify the milliseconds between samples of '-TrScaType samp'. Must be positive."
+);
+
+/**
+ * Command line option '-TrSampDepth'
+ * Only works with '-TrScaType samp'.
+ */
+KNOB<UINT32> KNOB_TrSampDepth(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrSampDepth",
+    "32", //set default value
+    "Specify the max number of frames of a sampled stack, the leaf included. Must be positive."
+);
+
+/**
+ * Command line option '-TrGramN'
+ * Only works with '-TrScaType gram'.
+ */
+KNOB<UINT32> KNOB_TrGramN(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrGramN",
+    "3", //set default value
+    "Specify the number of blocks in a row counted as one n-gram by '-TrScaType gram'. Must be 1 to 16."
+);
+
+/**
+ * Command line option '-TrGramDim'
+ * Only works with '-TrScaType gram'.
+ */
+KNOB<UINT32> KNOB_TrGramDim(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrGramDim",
+    "4096", //set default value
+    "Specify the size of the vector n-grams are hashed into by '-TrScaType gram'. "
+    "Must be a power of 2 from 2 to 1048576."
+);
+
+/**
+ * Command line option '-TrCtlPath'
+ * If specified, commands written into this FIFO (created if
+ * missing) switch recording on or off, flush or rotate the
+ * outputs, or detach Pin, while the target keeps running.
+ * See `ctl.cpp` for the commands. Works with `pin -pid` too.
+ */
+KNOB<std::string> KNOB_TrCtlPath(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrCtlPath",
+    "", //set default value
+    "Specify a FIFO to control tracing at run time, one command per line: "
+    "'on', 'off', 'flush', 'rotate' or 'detach'."
+);
+
+/**
+ * Command line option '-TrCtlOff'
+ * Start with recording off, until "on" comes from '-TrCtlPath'.
+ */
+KNOB<BOOL> KNOB_TrCtlOff(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrCtlOff",
+    "0", //set default value
+    "Start with recording off until 'on' is written into '-TrCtlPath'."
+);
+
+/**
+ * Command line option '-TrRangeFile'
+ * If not specified, the whole main executable is traced.
+ * Otherwise only code inside the ranges listed in this file
+ * is instrumented, in the main executable or any other image.
+ * See `range.cpp` for its format.
+ */
+KNOB<std::string> KNOB_TrRangeFile(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrRangeFile",
+    "", //set default value
+    "Specify a file of ranges to trace, one per line: '0x<lo>-0x<hi>' in link-time "
+    "addresses or a routine name, optionally after '<image>!'. Default is the main executable."
+);
+
+/**
+ * Command line option '-TrProcTag'
+ * Set by TracerCore itself on the Pin command line of an
+ * exec'd process (see `-follow_execv`), so its outputs do not
+ * overwrite those of the image before exec. Users leave it empty.
+ */
+KNOB<std::string> KNOB_TrProcTag(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "TrProcTag",
+    "", //set default value
+    "Suffix appended to every output path as '.<tag>'. "
+    "Set internally for exec'd processes, leave it empty."
 );
 
 /**
@@ -87,16 +360,98 @@ std::string GetUpper(const std::string &stri){
 // TL_INS => instruction   level
 // TL_BBL => basic block   level
 // TL_CAL => function call level
+// TL_CGR => call graph
+// TL_IXB => instruction level via basic blocks
+// TL_PRF => function-level profiler
+// TL_MUL => several of the first three at once
+// TL_SMP => sampling profiler
+// TL_CNT => volume counter of each routine
+// TL_GRM => block n-gram features
 INT32 TrSca = TL_BBL;
+
+// Global Variable
+// Layers traced together by `TL_MUL`, as `LY_BIT` of each.
+UINT32 TrLayers = 0;
+
+// Global Variable
+// The finest layer of `TL_MUL`, which goes to `TrDat` and `TrSym`.
+UINT32 TrFine = LY_INS;
+
+// Global Variable
+// iostreams against trace files and trace symbol files of
+// the coarser layers, by layer. That of `TrFine` is unused.
+std::ofstream TrLayDat[LY_NUM];
+std::ofstream TrLaySym[LY_NUM];
+
+static const char* LayerName[LY_NUM] = {"cal", "bbl", "ins"};
+
+static std::string SegPath(const std::string &path);
+
 /**
- * Initialize the value of `TrSca`
+ * Open the streams of the coarser layers next to the trace file
+ * and the trace symbol file, like "<path>.cal" and "<path>.bbl"
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for any failed `open`
+ */
+static INT32 open_layers(){
+    const std::string tdp = KNOB_TrDatPath.Value();
+    const std::string tsp = KNOB_TrSymPath.Value();
+    for (UINT32 l = 0; l < LY_NUM; ++l) {
+        if (!(TrLayers & LY_BIT(l)) || l == TrFine) { continue; }
+        TrLayDat[l].open(SegPath(tdp + "." + LayerName[l]).c_str(), std::ios::out|std::ios::trunc);
+        if (!TrLayDat[l].is_open()) { return EVIL_ARG; }
+        if (!TrSym.is_open()) { continue; }
+        TrLaySym[l].open(SegPath(tsp + "." + LayerName[l]).c_str(), std::ios::out|std::ios::trunc);
+        if (!TrLaySym[l].is_open()) { return EVIL_ARG; }
+    }
+    return GOOD_ARG;
+}
+
+/**
+ * Parse a list of layers like "cal+bbl+ins" into `TrLayers`
+ * and open their streams. Layers need trace files, and
+ * `-TrCovPath` can not gate records of several layers.
+ * @return `GOOD_ARG` for at least two distinct layers opened
+ */
+static INT32 init_layers(const std::string &sca){
+    if (TO_FILE != TrOut || TrCov) { return EVIL_ARG; }
+    size_t beg = 0, n = 0;
+    while (beg <= sca.size()) {
+        size_t end = sca.find('+', beg);
+        if (std::string::npos == end) { end = sca.size(); }
+        const std::string part = sca.substr(beg, end - beg);
+        UINT32 l = 0;
+        while (l < LY_NUM && 0 != part.compare(LayerName[l])) { ++l; }
+        if (l == LY_NUM || (TrLayers & LY_BIT(l))) { return EVIL_ARG; }
+        TrLayers |= LY_BIT(l);
+        ++n;
+        beg = end + 1;
+    }
+    if (n < 2) { return EVIL_ARG; }
+    TrFine = (TrLayers & LY_BIT(LY_INS)) ? LY_INS : LY_BBL;
+    TrSca = TL_MUL;
+    return open_layers();
+}
+
+/**
+ * Initialize the value of `TrSca`, and `TrSecInfo` for the
+ * symbol strings of every scale.
+ * Must be called after `init_TrDat`, `init_TrSym` and `init_TrCov`,
+ * since a call graph can only be written into a trace file.
  * @return Whether the specified value is applied successfully
  */
 INT32 init_TrSca(){
+    TrSecInfo = KNOB_TrSecInfo.Value();
     const std::string sca = KNOB_TrScaType.Value();
+    if (std::string::npos != sca.find('+')) { return init_layers(sca); }
     if      (0==sca.compare("ins")) { TrSca = TL_INS; }
     else if (0==sca.compare("bbl")) { TrSca = TL_BBL; }
     else if (0==sca.compare("cal")) { TrSca = TL_CAL; }
+    else if (0==sca.compare("cg" ) && TO_FILE == TrOut) { TrSca = TL_CGR; }
+    else if (0==sca.compare("ixb")) { TrSca = TL_IXB; }
+    else if (0==sca.compare("prof") && TO_FILE == TrOut) { TrSca = TL_PRF; }
+    else if (0==sca.compare("samp") && TO_FILE == TrOut) { TrSca = TL_SMP; }
+    else if (0==sca.compare("cnt" ) && TO_FILE == TrOut) { TrSca = TL_CNT; }
+    else if (0==sca.compare("gram") && TO_FILE == TrOut) { TrSca = TL_GRM; }
     else { return EVIL_ARG; }
     return GOOD_ARG;
 }
@@ -121,45 +476,369 @@ INT32 init_TrCut(){
     }
 }
 
+// Global Variable
+// Store the settings of shared-memory rings.
+UINT32 TrShmSlots = 65536;
+UINT32 TrShmFull  = SHM_FULL_BLOCK;
+/**
+ * Initialize the values of `TrShmSlots` and `TrShmFull`
+ * @return Whether the specified values are applied successfully
+ */
+INT32 init_TrShm(){
+    const UINT32 slots = KNOB_TrShmSlots.Value();
+    if (slots < 2 || 0 != (slots & (slots - 1))) { return EVIL_ARG; }
+    TrShmSlots = slots;
+
+    const std::string full = KNOB_TrShmFull.Value();
+    if      (0==full.compare("block")) { TrShmFull = SHM_FULL_BLOCK; }
+    else if (0==full.compare("drop" )) { TrShmFull = SHM_FULL_DROP;  }
+    else { return EVIL_ARG; }
+    return GOOD_ARG;
+}
+
+// Global Variable
+// Store the budget of a run, 0 means no limit.
+// `TrBudget` tells whether any budget is set.
+UINT64 TrMaxEvents = 0;
+UINT64 TrMaxBytes  = 0;
+BOOL   TrBudget    = FALSE;
+/**
+ * Initialize the values of `TrMaxEvents` and `TrMaxBytes`.
+ * Must be called after `init_TrSca`, as only traces are charged:
+ * modes which write at fini (like 'cg') take no budget.
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for a budget with such a mode
+ */
+INT32 init_TrMax(){
+    TrMaxEvents = KNOB_TrMaxEvents.Value();
+    TrMaxBytes  = KNOB_TrMaxBytes.Value();
+    TrBudget    = (0 != TrMaxEvents) || (0 != TrMaxBytes);
+    if (TrBudget && (TL_CGR == TrSca || TL_PRF == TrSca || TL_SMP == TrSca || TL_CNT == TrSca || TL_GRM == TrSca))
+        { return EVIL_ARG; }
+    return GOOD_ARG;
+}
+
+// Global Variable
+// Whether records are filtered by the global coverage map.
+BOOL TrCov = FALSE;
+/**
+ * Initialize the global coverage map for `-TrCovPath`
+ * @return `GOOD_ARG` for no map or a usable map.
+ *         `EVIL_ARG` for a bad type or a failure on the map.
+ */
+INT32 init_TrCov(){
+    const std::string tcp = KNOB_TrCovPath.Value();
+    const std::string tct = KNOB_TrCovType.Value();
+    UINT32 type = COV_BLK;
+    if      (0==tct.compare("blk" )) { type = COV_BLK;  }
+    else if (0==tct.compare("edge")) { type = COV_EDGE; }
+    else { return EVIL_ARG; }
+    if (0 == tcp.size()) { return GOOD_ARG; }
+    if (EVIL_ARG == CovOpen(tcp, type)) { return EVIL_ARG; }
+    TrCov = TRUE;
+    return GOOD_ARG;
+}
+
+// Global Variable
+// Suffix of all outputs of this process, empty for the root process.
+// A forked child uses its PID and an exec'd image gets '.exec' more.
+std::string TrTag;
+/**
+ * Initialize the value of `TrTag`
+ * @return `GOOD_ARG` for a tag usable in paths, or `EVIL_ARG`
+ */
+INT32 init_TrTag(){
+    TrTag = KNOB_TrProcTag.Value();
+    if (std::string::npos != TrTag.find('/')) { return EVIL_ARG; }
+    return GOOD_ARG;
+}
+
+/**
+ * Apply the suffix of this process to an output path
+ * @param path path given on the command line
+ * @return "<path>.<tag>", or `path` for the root process
+ */
+static std::string TagPath(const std::string &path){
+    return TrTag.size() ? path + "." + TrTag : path;
+}
+
+// Global Variable
+// Number of the segment of trace files being written,
+// which goes up by one each time they are rotated.
+UINT32 TrSeg = 0;
+/**
+ * Apply the suffix of this process and the segment to a trace file path
+ * @param path path given on the command line
+ * @return "<path>[.<tag>].seg<N>", or `TagPath(path)` for the first segment
+ */
+static std::string SegPath(const std::string &path){
+    return TrSeg ? TagPath(path) + ".seg" + decstr(TrSeg) : TagPath(path);
+}
+
+// Global Variable
+// Whether only ranges from `-TrRangeFile` are traced.
+BOOL TrRange = FALSE;
+/**
+ * Load the ranges of `-TrRangeFile`
+ * @return `GOOD_ARG` for no file or a usable file, otherwise `EVIL_ARG`
+ */
+INT32 init_TrRange(){
+    const std::string trf = KNOB_TrRangeFile.Value();
+    if (0 == trf.size()) { return GOOD_ARG; }
+    if (EVIL_ARG == RangeLoad(trf)) { return EVIL_ARG; }
+    TrRange = TRUE;
+    return GOOD_ARG;
+}
+
+/**
+ * Set up the sampling profiler with `-TrSampMs` and `-TrSampDepth`.
+ * Must be called after `init_TrSca`.
+ * @return `GOOD_ARG` for positive values or no sampling at all
+ */
+INT32 init_TrSamp(){
+    if (TL_SMP != TrSca) { return GOOD_ARG; }
+    if (0 == KNOB_TrSampMs.Value() || 0 == KNOB_TrSampDepth.Value()) { return EVIL_ARG; }
+    SampInit(KNOB_TrSampMs.Value(), KNOB_TrSampDepth.Value());
+    return GOOD_ARG;
+}
+
+/**
+ * Set up n-gram features with `-TrGramN` and `-TrGramDim`.
+ * Must be called after `init_TrSca`.
+ * @return `GOOD_ARG` for values in range or no n-grams at all
+ */
+INT32 init_TrGram(){
+    if (TL_GRM != TrSca) { return GOOD_ARG; }
+    const UINT32 n   = KNOB_TrGramN.Value();
+    const UINT32 dim = KNOB_TrGramDim.Value();
+    if (n < 1 || n > GRAM_MAX_N) { return EVIL_ARG; }
+    if (dim < 2 || dim > GRAM_MAX_DIM || (dim & (dim - 1))) { return EVIL_ARG; }
+    GramInit(n, dim);
+    return GOOD_ARG;
+}
+
+// Global Variable
+// Whether commands come from `-TrCtlPath`.
+BOOL TrCtl = FALSE;
+/**
+ * Open the FIFO of `-TrCtlPath` and set the first state of recording.
+ * Must be called after `init_TrSca` and `init_TrTag`, and an exec'd
+ * child gets a FIFO of its own, like "<path>.<tag>".
+ * @return `GOOD_ARG` for no FIFO or a usable one. `EVIL_ARG` for a
+ *         failed `open`, or '-TrCtlOff' without a FIFO.
+ */
+INT32 init_TrCtl(){
+    const std::string tcp = KNOB_TrCtlPath.Value();
+    if (0 == tcp.size()) { return KNOB_TrCtlOff.Value() ? EVIL_ARG : GOOD_ARG; }
+    if (EVIL_ARG == CtlOpen(TagPath(tcp))) { return EVIL_ARG; }
+    TrOn.store(!KNOB_TrCtlOff.Value());
+    TrCtl = TRUE;
+    return GOOD_ARG;
+}
+
+// Global Variable
+// Where the records go.
+// TO_FILE  => trace file and trace symbol file
+// TO_SHM   => shared-memory rings
+// TO_CHUNK => chunked container
+// TO_MAP   => mapped trace file and trace symbol file
+INT32 TrOut = TO_FILE;
+
 // Global Variable
 // iostream against trace file
 std::ofstream TrDat;
 /**
- * Initialize the iostream against trace file
+ * Initialize the iostream against trace file,
+ * or the shared-memory rings for 'shm:<name>',
+ * or the chunked container for 'chunk:<path>',
+ * or the mapped trace file for 'map:<path>'.
+ * Must be called after `init_TrShm`.
  * @return `GOOD_ARG` for success or `EVIL_ARG` for failed `open`
  */
 INT32 init_TrDat(){
-    TrDat.open(KNOB_TrDatPath.Value().c_str(), std::ios::out|std::ios::trunc);
+    const std::string tdp = KNOB_TrDatPath.Value();
+    if (0 == tdp.compare(0, 4, "shm:")) {
+        TrOut = TO_SHM;
+        return RingOpen(TagPath(tdp.substr(4)), TrShmSlots, TrShmFull);
+    }
+    if (0 == tdp.compare(0, 6, "chunk:")) {
+        TrOut = TO_CHUNK;
+        return ChunkOpen(TagPath(tdp.substr(6)));
+    }
+    if (0 == tdp.compare(0, 4, "map:")) {
+        TrOut = TO_MAP;
+        return MapOpen(MapDat, TagPath(tdp.substr(4)));
+    }
+    TrDat.open(TagPath(tdp).c_str(), std::ios::out|std::ios::trunc);
     if (TrDat.is_open()) { return GOOD_ARG; }
     else { return EVIL_ARG; }
 }
 
+// Global Variable
+// Whether symbols are published into shared memory.
+BOOL TrSymShm = FALSE;
+
+// Global Variable
+// Whether symbols carry the section and the offset.
+BOOL TrSecInfo = TRUE;
+
 // Global Variable
 // iostream against trace symbol file
 std::ofstream TrSym;
 /**
- * Initialize the iostream against trace symbol file
+ * Initialize the iostream against trace symbol file.
+ * Must be called after `init_TrDat`.
+ * The chunked container has no trace symbol file,
+ * while a mapped trace file gets a mapped one.
  * @return `GOOD_ARG` for no trace symbol file output or successful `open`.
- *         `EVIL_ARG` for a failed `open` call.
+ *         `EVIL_ARG` for a failed `open` call or a chunked container.
  */
 INT32 init_TrSym(){
     const std::string tsp = KNOB_TrSymPath.Value();
     if (0 == tsp.size()) { return GOOD_ARG; }
+    else if (TO_SHM == TrOut) { TrSymShm = TRUE; return GOOD_ARG; }
+    else if (TO_CHUNK == TrOut) { return EVIL_ARG; }
+    else if (TO_MAP == TrOut) { return MapOpen(MapSym, TagPath(tsp)); }
     else {
-        TrSym.open(tsp.c_str(), std::ios::out|std::ios::trunc);
+        TrSym.open(TagPath(tsp).c_str(), std::ios::out|std::ios::trunc);
         if (TrSym.is_open()) { return GOOD_ARG; }
         else { return EVIL_ARG; }
     }
 }
 
+// Global Variable
+// iostream against block table
+std::ofstream TrBlk;
+/**
+ * Initialize the iostream against block table
+ * Must be called after `init_TrDat` and `init_TrSca`.
+ * The chunked container only holds addresses, so it can not
+ * carry the "#EXIT" markers which cut blocks short.
+ * @return `GOOD_ARG` for no block table needed or successful `open`.
+ *         `EVIL_ARG` for a missing path, a chunked container
+ *         or a failed `open` call.
+ */
+INT32 init_TrBlk(){
+    if (TL_IXB != TrSca) { return GOOD_ARG; }
+    if (TO_CHUNK == TrOut) { return EVIL_ARG; }
+    const std::string tbp = KNOB_TrBlkPath.Value();
+    if (0 == tbp.size()) { return EVIL_ARG; }
+    TrBlk.open(TagPath(tbp).c_str(), std::ios::out|std::ios::trunc);
+    if (TrBlk.is_open()) { return GOOD_ARG; }
+    else { return EVIL_ARG; }
+}
+
+/**
+ * Switch the outputs of a forked child to its own paths.
+ * Records of the parent are not carried over, except the block
+ * table, since the child keeps using the IDs given so far.
+ * Streams must have been flushed before the fork.
+ * @param tag the new suffix of this process
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for any failed `open`
+ */
+INT32 reopen_files(const std::string &tag){
+    const std::string tdp = KNOB_TrDatPath.Value();
+    const std::string tsp = KNOB_TrSymPath.Value();
+    const std::string tbp = KNOB_TrBlkPath.Value();
+    const std::string old_blk = TagPath(tbp);
+    TrTag = tag;
+
+    BOOL ok = TRUE;
+    if (TO_SHM == TrOut) { ok = (GOOD_ARG == RingFork(TagPath(tdp.substr(4)))); }
+    else if (TO_CHUNK == TrOut) { ok = (GOOD_ARG == ChunkFork(TagPath(tdp.substr(6)))); }
+    else if (TO_MAP == TrOut) {
+        ok = (GOOD_ARG == MapFork(MapDat, TagPath(tdp.substr(4))));
+        if (MapSym.base) { ok = ok && (GOOD_ARG == MapFork(MapSym, TagPath(tsp))); }
+    }
+    else if (TrDat.is_open()) {
+        TrDat.close();
+        TrDat.open(SegPath(tdp).c_str(), std::ios::out|std::ios::trunc);
+        ok = TrDat.is_open();
+    }
+    if (TrSym.is_open()) {
+        TrSym.close();
+        TrSym.open(SegPath(tsp).c_str(), std::ios::out|std::ios::trunc);
+        ok = ok && TrSym.is_open();
+    }
+    for (UINT32 l = 0; l < LY_NUM; ++l) {
+        if (TrLayDat[l].is_open()) { TrLayDat[l].close(); }
+        if (TrLaySym[l].is_open()) { TrLaySym[l].close(); }
+    }
+    if (TL_MUL == TrSca) { ok = ok && (GOOD_ARG == open_layers()); }
+    if (TrBlk.is_open()) {
+        TrBlk.close();
+        std::ifstream src(old_blk.c_str());
+        TrBlk.open(TagPath(tbp).c_str(), std::ios::out|std::ios::trunc);
+        if (src.is_open() && src.peek() != EOF) { TrBlk << src.rdbuf(); }
+        ok = ok && TrBlk.is_open();
+    }
+    return ok ? GOOD_ARG : EVIL_ARG;
+}
+
+/**
+ * Close the trace files and go on in new ones, "<path>.seg<N>".
+ * The block table is kept, since block IDs go on as they are.
+ * Must be called while holding the lock of writing files.
+ * @return `GOOD_ARG` for success, or `EVIL_ARG` for any failed `open`,
+ *         outputs other than trace files, or a stopped trace
+ */
+INT32 rotate_files(){
+    if (TO_FILE != TrOut || TL_CGR == TrSca || TL_PRF == TrSca || TL_SMP == TrSca || TL_CNT == TrSca || TL_GRM == TrSca) { return EVIL_ARG; }
+    if (TrStop.load(std::memory_order_relaxed) || !TrDat.is_open()) { return EVIL_ARG; }
+    const std::string tdp = KNOB_TrDatPath.Value();
+    const std::string tsp = KNOB_TrSymPath.Value();
+    ++TrSeg;
+
+    BOOL ok = TRUE;
+    TrDat.close();
+    TrDat.open(SegPath(tdp).c_str(), std::ios::out|std::ios::trunc);
+    ok = TrDat.is_open();
+    if (TrSym.is_open()) {
+        TrSym.close();
+        TrSym.open(SegPath(tsp).c_str(), std::ios::out|std::ios::trunc);
+        ok = ok && TrSym.is_open();
+    }
+    for (UINT32 l = 0; l < LY_NUM; ++l) {
+        if (TrLayDat[l].is_open()) { TrLayDat[l].close(); }
+        if (TrLaySym[l].is_open()) { TrLaySym[l].close(); }
+    }
+    if (TL_MUL == TrSca) { ok = ok && (GOOD_ARG == open_layers()); }
+    return ok ? GOOD_ARG : EVIL_ARG;
+}
+
+/**
+ * Write what is kept till the end (like a call graph)
+ * and close all outputs which are not closed yet
+ */
+VOID close_files(){
+    if (TO_SHM == TrOut) { RingClose(); }
+    if (TO_CHUNK == TrOut) { ChunkClose(); }
+    if (TO_MAP == TrOut) { MapFinish(MapDat, 0); MapFinish(MapSym, 0); }
+    if (TL_CGR == TrSca && TrDat.is_open() && !CgSave(TrDat))
+        { std::cout << "[!] Failed to write the call graph" << std::endl; }
+    if (TL_PRF == TrSca && TrDat.is_open() && !ProfSave(TrDat, TrSym.is_open() ? &TrSym : 0))
+        { std::cout << "[!] Failed to write the profile" << std::endl; }
+    if (TL_SMP == TrSca && TrDat.is_open() && !SampSave(TrDat, TrSym.is_open() ? &TrSym : 0))
+        { std::cout << "[!] Failed to write the samples" << std::endl; }
+    if (TL_CNT == TrSca && TrDat.is_open() && !CntSave(TrDat))
+        { std::cout << "[!] Failed to write the counts" << std::endl; }
+    if (TL_GRM == TrSca && TrDat.is_open() && !GramSave(TrDat))
+        { std::cout << "[!] Failed to write the n-grams" << std::endl; }
+    if (TrDat.is_open()) { TrDat.close(); }
+    if (TrSym.is_open()) { TrSym.close(); }
+    if (TrBlk.is_open()) { TrBlk.close(); }
+    for (UINT32 l = 0; l < LY_NUM; ++l) {
+        if (TrLayDat[l].is_open()) { TrLayDat[l].close(); }
+        if (TrLaySym[l].is_open()) { TrLaySym[l].close(); }
+    }
+}
+
 /**
  * Close those file streams if they are not closed
  * @param C from default signature & unused
  * @param V from default signature & unused
  */
 VOID fini_files(INT32 C, VOID *V){
-    if (TrDat.is_open()) { TrDat.close(); }
-    if (TrSym.is_open()) { TrSym.close(); }
+    close_files();
     std::cout << "[-] Hope to see you again :-) " << std::endl;
 }
 
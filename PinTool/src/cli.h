@@ -14,12 +14,39 @@ INT32 init_TrDat();
 INT32 init_TrSym();
 INT32 init_TrCut();
 INT32 init_TrSca();
+INT32 init_TrShm();
+INT32 init_TrMax();
+INT32 init_TrCov();
+INT32 init_TrBlk();
+INT32 init_TrTag();
+INT32 init_TrRange();
+INT32 init_TrCtl();
+INT32 init_TrSamp();
+INT32 init_TrGram();
+INT32 reopen_files(const std::string &tag);
+INT32 rotate_files();
 
+VOID close_files();
 VOID fini_files(INT32 C, VOID *V);
 
 extern std::ofstream            TrDat;
 extern std::ofstream            TrSym;
+extern std::ofstream            TrBlk;
+extern std::ofstream            TrLayDat[];
+extern std::ofstream            TrLaySym[];
+extern std::string              TrTag;
 extern std::vector<std::string> TrCut;
 extern INT32                    TrSca;
+extern UINT32                   TrLayers;
+extern UINT32                   TrFine;
+extern INT32                    TrOut;
+extern BOOL                     TrSymShm;
+extern BOOL                     TrSecInfo;
+extern UINT64                   TrMaxEvents;
+extern UINT64                   TrMaxBytes;
+extern BOOL                     TrBudget;
+extern BOOL                     TrCov;
+extern BOOL                     TrRange;
+extern BOOL                     TrCtl;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "count.h"
+#include "checker.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+
+/**
+ * Volume counter for `-TrScaType cnt`.
+ * Each block executed adds to the counters of its routine: one block,
+ * its instructions, and one call for the entry block. These are the
+ * records 'bbl', 'ins' and 'cal' would write for the routine, at the
+ * cost of a few adds on counters of the thread itself, and nothing is
+ * written until `CntSave` at fini. Routines are filtered like `AnalyseBBL`,
+ * so the counts show what is left to trace under the current `-TrCutName`.
+ */
+
+// Counters of a routine in a thread
+struct CntSlot
+{
+    UINT64 calls;
+    UINT64 blocks;
+    UINT64 ins;
+};
+
+typedef std::vector<CntSlot> CntThread; //indexed by routine ID
+
+static CntThread* CntState[PIN_MAX_THREADS];
+
+// Name of each routine seen at instrumentation time, indexed by
+// routine ID. Blocks out of any routine share the ID of address 0.
+// Names are bare, whatever `-TrSecInfo` is, since `-TrCutName`
+// matches the bare name and the CSV is used to pick keywords.
+// Pin holds its internal lock meanwhile.
+static std::vector<std::string> CntNames;
+static std::map<ADDRINT, UINT32> CntIds;
+
+// The most blocks first, then by name
+struct CntOrder
+{
+    const std::vector<CntSlot> &total;
+    explicit CntOrder(const std::vector<CntSlot> &t) : total(t) {}
+    bool operator()(UINT32 x, UINT32 y) const {
+        if (total[x].blocks != total[y].blocks) { return total[x].blocks > total[y].blocks; }
+        return CntNames[x] < CntNames[y];
+    }
+};
+
+/**
+ * Thread start callback. Pin reuses thread IDs,
+ * so a reused ID keeps adding to the same counters.
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param flags from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID CntThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    if (!CntState[tid]) { CntState[tid] = new CntThread(); }
+}
+
+/**
+ * Analyse Routine before each block.
+ * Routine IDs given after the thread started grow its counters here.
+ * @param tid Pin thread ID
+ * @param rid routine ID
+ * @param n_ins number of instructions of the block
+ * @param entry 1 for the entry block of the routine, 0 otherwise
+ */
+static VOID PIN_FAST_ANALYSIS_CALL CntBbl(THREADID tid, UINT32 rid, UINT32 n_ins, UINT32 entry)
+{
+    CntThread &t = *CntState[tid];
+    if (rid >= t.size()) { t.resize(rid + 1); }
+    CntSlot &s = t[rid];
+    s.calls  += entry;
+    s.blocks += 1;
+    s.ins    += n_ins;
+}
+
+/**
+ * Forget what the parent counted in a forked child
+ */
+VOID CntFork()
+{
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        if (!CntState[i]) { continue; }
+        CntThread &t = *CntState[i];
+        for (size_t r = 0; r < t.size(); ++r) { t[r].calls = 0; t[r].blocks = 0; t[r].ins = 0; }
+    }
+}
+
+/**
+ * Instrumentation Routine for the counter.
+ * Blocks are filtered just like `AnalyseBBL`.
+ * @param Tparam TRACE Object
+ * @param Vparam from default signature & unused
+ */
+VOID AnalyseCNT(TRACE Tparam, VOID *Vparam)
+{
+    for (BBL B__=TRACE_BblHead(Tparam); BBL_Valid(B__); B__=BBL_Next(B__)){
+        const ADDRINT bbl_addr = BBL_Address(B__);
+        if (!IsInsideMain(bbl_addr)) { continue; }
+        if (IsBlocked(bbl_addr)) { continue; }
+
+        PIN_LockClient();
+        RTN rtni = RTN_FindByAddress(bbl_addr);
+        const ADDRINT raddr = RTN_Valid(rtni) ? RTN_Address(rtni) : 0;
+        std::map<ADDRINT, UINT32>::iterator it = CntIds.find(raddr);
+        UINT32 rid;
+        if (it != CntIds.end()) { rid = it->second; }
+        else {
+            rid = static_cast<UINT32>(CntNames.size());
+            CntNames.push_back(RTN_Valid(rtni) ? RTN_Name(rtni) : "");
+            CntIds[raddr] = rid;
+        }
+        PIN_UnlockClient();
+
+        BBL_InsertCall(B__, IPOINT_BEFORE, AFUNPTR(CntBbl),
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID,
+                IARG_UINT32, rid,
+                IARG_UINT32, BBL_NumIns(B__),
+                IARG_UINT32, (raddr && raddr == bbl_addr) ? 1 : 0,
+            IARG_END);
+    }
+}
+
+/**
+ * Merge the counters of all threads and write them.
+ * Must be called after the application threads have finished.
+ * @param summary receives "routine,calls,blocks,instructions" CSV rows,
+ *        the most blocks first. Blocks out of any routine are the row
+ *        with an empty name.
+ * @return whether the output is fully written
+ */
+BOOL CntSave(std::ostream &summary)
+{
+    std::vector<CntSlot> total(CntNames.size());
+    for (size_t r = 0; r < total.size(); ++r) { total[r].calls = 0; total[r].blocks = 0; total[r].ins = 0; }
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        CntThread* t = CntState[i];
+        if (!t) { continue; }
+        for (size_t r = 0; r < t->size() && r < total.size(); ++r) {
+            total[r].calls  += (*t)[r].calls;
+            total[r].blocks += (*t)[r].blocks;
+            total[r].ins    += (*t)[r].ins;
+        }
+        delete t;
+        CntState[i] = 0;
+    }
+
+    std::vector<UINT32> order;
+    for (UINT32 r = 0; r < total.size(); ++r) { if (total[r].blocks) { order.push_back(r); } }
+    std::sort(order.begin(), order.end(), CntOrder(total));
+
+    summary << "routine,calls,blocks,instructions\n";
+    for (size_t k = 0; k < order.size(); ++k) {
+        const UINT32 r = order[k];
+        summary << CsvQuote(CntNames[r]) << "," << total[r].calls << "," << total[r].blocks << "," << total[r].ins << "\n";
+    }
+    summary.flush();
+    return summary.good();
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef HEAD_COUNT_H
+#define HEAD_COUNT_H
+
+#include "pin.H"
+#include <ostream>
+
+VOID AnalyseCNT(TRACE Tparam, VOID *Vparam);
+VOID CntThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v);
+VOID CntFork();
+BOOL CntSave(std::ostream &summary);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "cov.h"
+#include "amsg.h"
+#include "checker.h"
+#include "ctl.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Novelty-only tracing for `-TrCovPath`.
+ * Before a record is written, its slot in the global coverage map
+ * is tested and set atomically, so only blocks (or edges) never seen
+ * by this run or any earlier run sharing the map are recorded.
+ */
+
+// The bitmap right after the header of the mapped file
+static UINT8* CovMap  = 0;
+static UINT32 CovMask = 0;
+static UINT32 CovType = COV_BLK;
+
+// Slot of the last block of each thread for edge coverage,
+// padded so threads do not share cache lines.
+struct alignas(64) CovLast
+{
+    UINT32 slot;
+};
+static CovLast CovPrev[PIN_MAX_THREADS];
+
+/**
+ * Map the global coverage map, and create it if it does not exist.
+ * Several TracerCore may open the same file at the same time,
+ * so the header is checked and written under an exclusive `flock`.
+ * @param path path of the map file
+ * @param type `COV_BLK` or `COV_EDGE`
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for any failure or
+ *         a map made with another type or size
+ */
+INT32 CovOpen(const std::string &path, UINT32 type)
+{
+    const UINT64 total = sizeof(CovHead) + ((UINT64) 1 << COV_BITS) / 8;
+    int fd = open(path.c_str(), O_RDWR|O_CREAT, 0644);
+    if (fd < 0) { return EVIL_ARG; }
+    if (0 != flock(fd, LOCK_EX)) { close(fd); return EVIL_ARG; }
+
+    INT32 ret = GOOD_ARG;
+    CovHead head;
+    ssize_t got = pread(fd, &head, sizeof(head), 0);
+    if (0 == got) {
+        memset(&head, 0, sizeof(head));
+        memcpy(head.magic, COV_MAGIC, sizeof(head.magic));
+        head.version = COV_VERSION;
+        head.bits    = COV_BITS;
+        head.type    = type;
+        if (0 != ftruncate(fd, total) ||
+            (ssize_t) sizeof(head) != pwrite(fd, &head, sizeof(head), 0))
+            { ret = EVIL_ARG; }
+    } else if ((ssize_t) sizeof(head) != got ||
+               0 != memcmp(head.magic, COV_MAGIC, sizeof(head.magic)) ||
+               COV_VERSION != head.version || COV_BITS != head.bits || type != head.type) {
+        ret = EVIL_ARG;
+    }
+
+    VOID* mem = MAP_FAILED;
+    if (GOOD_ARG == ret) { mem = mmap(0, total, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0); }
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (MAP_FAILED == mem) { return EVIL_ARG; }
+
+    CovMap  = static_cast<UINT8*>(mem) + sizeof(CovHead);
+    CovMask = ((UINT32) 1 << COV_BITS) - 1;
+    CovType = type;
+    return GOOD_ARG;
+}
+
+/**
+ * Get the slot of an address in the map.
+ * Its `ImgOffsetKey` is hashed, so nearby blocks spread out.
+ * @param addr memory address inside any image
+ * @return slot index
+ */
+UINT32 CovSlot(ADDRINT addr)
+{
+    return static_cast<UINT32>((ImgOffsetKey(addr) * 0x9E3779B97F4A7C15ULL) >> (64 - COV_BITS)) & CovMask;
+}
+
+/**
+ * Test and set a slot of the map. A plain load goes first,
+ * so slots already seen never dirty the shared cache line.
+ * @param slot slot index
+ * @return non-zero if the slot was never set before
+ */
+static inline ADDRINT CovTestSet(UINT32 slot)
+{
+    UINT8* byte = CovMap + (slot >> 3);
+    const UINT8 bit = (UINT8) 1 << (slot & 7);
+    if (__atomic_load_n(byte, __ATOMIC_RELAXED) & bit) { return 0; }
+    return !(__atomic_fetch_or(byte, bit, __ATOMIC_RELAXED) & bit);
+}
+
+/**
+ * Analyse Routine deciding whether a block is new
+ * @param slot slot of the block
+ * @return non-zero to run the recording routine
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL CovNewBlk(UINT32 slot)
+{
+    return CovTestSet(slot);
+}
+
+/**
+ * Analyse Routine deciding whether the edge from the
+ * last block of the thread to this block is new
+ * @param tid Pin thread ID
+ * @param slot slot of the block
+ * @return non-zero to run the recording routine
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL CovNewEdge(THREADID tid, UINT32 slot)
+{
+    CovLast &last = CovPrev[tid];
+    const UINT32 edge = (last.slot ^ slot) & CovMask;
+    last.slot = slot >> 1;
+    return CovTestSet(edge);
+}
+
+/**
+ * `CovNewBlk` while recording is on, so nothing is marked while it is off
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL CovNewBlkOn(UINT32 slot)
+{
+    return CtlIsOn() && CovTestSet(slot);
+}
+
+/**
+ * `CovNewEdge` while recording is on, so nothing is marked while it is off
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL CovNewEdgeOn(THREADID tid, UINT32 slot)
+{
+    return CtlIsOn() && CovNewEdge(tid, slot);
+}
+
+/**
+ * Insert the novelty check before an instruction.
+ * The recording routine must be inserted with `INS_InsertThenCall`.
+ * @param Iparam Instruction Object
+ * @param addr address being recorded
+ * @param gate whether `TrOn` is checked too, since Pin allows
+ *        only one `INS_InsertIfCall` before the recording routine
+ */
+VOID CovInsertIf(INS Iparam, ADDRINT addr, BOOL gate)
+{
+    if (COV_EDGE == CovType) {
+        INS_InsertIfCall(Iparam, IPOINT_BEFORE, gate ? AFUNPTR(CovNewEdgeOn) : AFUNPTR(CovNewEdge),
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID,
+                IARG_UINT32, CovSlot(addr),
+            IARG_END);
+    } else {
+        INS_InsertIfCall(Iparam, IPOINT_BEFORE, gate ? AFUNPTR(CovNewBlkOn) : AFUNPTR(CovNewBlk),
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_UINT32, CovSlot(addr),
+            IARG_END);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef HEAD_COV_H
+#define HEAD_COV_H
+
+#include "pin.H"
+#include <string>
+
+// Layout of the global coverage map file shared by all runs.
+// A `CovHead` is followed by a bitmap of (1 << `bits`) bits.
+// Each bit stands for a block (or an edge between two blocks)
+// keyed by the file name of its image and its offset in that image,
+// so it survives ASLR, and blocks of `-TrRangeFile` in other images
+// do not take the slots of the main executable.
+#define COV_MAGIC   "TRCOVMP"
+#define COV_VERSION ((UINT32) 2)
+#define COV_BITS    ((UINT32) 22)
+
+#define COV_BLK  ((UINT32) 0)
+#define COV_EDGE ((UINT32) 1)
+
+struct CovHead
+{
+    char   magic[8];
+    UINT32 version;
+    UINT32 bits;
+    UINT32 type;
+    UINT32 pad[11];
+};
+
+INT32  CovOpen(const std::string &path, UINT32 type);
+UINT32 CovSlot(ADDRINT addr);
+VOID   CovInsertIf(INS Iparam, ADDRINT addr, BOOL gate);
+
+#endif
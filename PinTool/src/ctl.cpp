@@ -0,0 +1,155 @@
+#include "ctl.h"
+#include "amsg.h"
+#include "cli.h"
+#include "payload.h"
+#include <iostream>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Control channel of `-TrCtlPath`, for tracing long-running processes
+ * in windows. An internal thread reads commands from a FIFO, one per line:
+ *   "on"      start recording
+ *   "off"     stop recording, and flush the outputs
+ *   "flush"   flush the outputs
+ *   "rotate"  close the trace files and go on in new segments
+ *   "detach"  detach Pin, which writes and closes the outputs
+ * e.g. `echo off > /path/to/fifo`. Switching calls `PIN_RemoveInstrumentation`,
+ * so traces are instrumented again with (or without) analysis calls.
+ * Routines are instrumented only once, when their image is loaded,
+ * so the routine-level modes check `CtlIsOn` at analysis time instead.
+ */
+
+// Global Variable
+// Whether records are made now. Trace-level instrumentation routines
+// check it through `IsInsideMain`, so nothing is instrumented while it is off.
+std::atomic<bool> TrOn(true);
+
+/**
+ * Analyse Routine telling whether recording is on, to be inserted
+ * with `INS_InsertIfCall` or `RTN_InsertIfCall` before the recording
+ * @return non-zero while recording is on
+ */
+ADDRINT PIN_FAST_ANALYSIS_CALL CtlIsOn()
+{
+    return TrOn.load(std::memory_order_relaxed);
+}
+
+static INT32          CtlFd = -1;
+static PIN_THREAD_UID CtlUid;
+static BOOL           CtlRunning = FALSE;
+
+/**
+ * Create the FIFO if needed and open it. It is opened for writing too,
+ * so it never reads EOF after a writer like `echo` closes its end.
+ * @param path path of the FIFO
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for a failed `mkfifo` or `open`
+ */
+INT32 CtlOpen(const std::string &path)
+{
+    if (0 != mkfifo(path.c_str(), 0600) && EEXIST != errno) { return EVIL_ARG; }
+    struct stat st;
+    if (0 != stat(path.c_str(), &st) || !S_ISFIFO(st.st_mode)) { return EVIL_ARG; }
+    CtlFd = open(path.c_str(), O_RDWR | O_NONBLOCK);
+    return (CtlFd < 0) ? EVIL_ARG : GOOD_ARG;
+}
+
+/**
+ * Flush all trace files and trace symbol files.
+ * Must be called while holding the lock of writing files.
+ */
+static VOID CtlFlush()
+{
+    if (TrDat.is_open()) { TrDat.flush(); }
+    if (TrSym.is_open()) { TrSym.flush(); }
+    if (TrBlk.is_open()) { TrBlk.flush(); }
+    for (UINT32 l = 0; l < LY_NUM; ++l) {
+        if (TrLayDat[l].is_open()) { TrLayDat[l].flush(); }
+        if (TrLaySym[l].is_open()) { TrLaySym[l].flush(); }
+    }
+}
+
+/**
+ * Carry out a command
+ * @param cmd the command line without the line break
+ * @return false once Pin is detaching, when no more command is read
+ */
+static BOOL CtlRun(const std::string &cmd)
+{
+    const INT32 owner = PIN_ThreadId() + 1;
+    if ("on" == cmd || "off" == cmd) {
+        const bool on = ("on" == cmd);
+        if (TrOn.exchange(on) != on) { PIN_RemoveInstrumentation(); }
+        if (!on) {
+            PIN_GetLock(&WriteFile, owner);
+            CtlFlush();
+            PIN_ReleaseLock(&WriteFile);
+        }
+        std::cout << "[+] Recording is " << cmd << std::endl;
+    } else if ("flush" == cmd) {
+        PIN_GetLock(&WriteFile, owner);
+        CtlFlush();
+        PIN_ReleaseLock(&WriteFile);
+    } else if ("rotate" == cmd) {
+        PIN_GetLock(&WriteFile, owner);
+        const INT32 rc = rotate_files();
+        PIN_ReleaseLock(&WriteFile);
+        if (GOOD_ARG == rc) { std::cout << "[+] Trace files rotated" << std::endl; }
+        else { std::cout << "[!] Failed to rotate, only trace files of a trace can be" << std::endl; }
+    } else if ("detach" == cmd) {
+        std::cout << "[+] Detaching" << std::endl;
+        PIN_Detach();
+        return FALSE;
+    } else if (cmd.size()) {
+        std::cout << "[!] Unknown control command " << cmd << std::endl;
+    }
+    return TRUE;
+}
+
+/**
+ * The internal thread reading commands, until the process exits
+ * @param arg from default signature & unused
+ */
+static VOID CtlThread(VOID *arg)
+{
+    std::string line;
+    char buf[256];
+    while (!PIN_IsProcessExiting()) {
+        struct pollfd pfd;
+        pfd.fd = CtlFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 100) <= 0) { continue; }
+        const ssize_t n = read(CtlFd, buf, sizeof(buf));
+        for (ssize_t i = 0; i < n; ++i) {
+            if ('\n' != buf[i]) { line += buf[i]; continue; }
+            if (line.size() && '\r' == line[line.size() - 1]) { line.erase(line.size() - 1); }
+            if (!CtlRun(line)) { return; }
+            line.clear();
+        }
+    }
+}
+
+/**
+ * Spawn the internal thread. Must be called before `PIN_StartProgram`.
+ * A forked child has no such thread, while an exec'd one gets its own
+ * FIFO like its other outputs.
+ */
+VOID CtlStart()
+{
+    CtlRunning = (INVALID_THREADID != PIN_SpawnInternalThread(CtlThread, 0, 0, &CtlUid));
+    if (!CtlRunning) { std::cout << "[!] Failed to start the control thread" << std::endl; }
+}
+
+/**
+ * Prepare-for-fini callback, which waits for the internal thread
+ * @param V from default signature & unused
+ */
+VOID CtlPrepareFini(VOID *V)
+{
+    if (CtlRunning) { PIN_WaitForThreadTermination(CtlUid, PIN_INFINITE_TIMEOUT, 0); }
+    if (CtlFd >= 0) { close(CtlFd); CtlFd = -1; }
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef HEAD_CTL_H
+#define HEAD_CTL_H
+
+#include "pin.H"
+#include <atomic>
+#include <string>
+
+extern std::atomic<bool> TrOn;
+
+INT32 CtlOpen(const std::string &path);
+VOID CtlStart();
+ADDRINT PIN_FAST_ANALYSIS_CALL CtlIsOn();
+VOID CtlPrepareFini(VOID *V);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "fork.h"
+#include "amsg.h"
+#include "cli.h"
+#include "payload.h"
+#include "ring.h"
+#include "chunk.h"
+#include "budget.h"
+#include "callgraph.h"
+#include "prof.h"
+#include "sample.h"
+#include "count.h"
+#include "gram.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * Multi-process support.
+ * A forked child inherits the streams, the locks and all per-thread
+ * state of its parent, so it switches to outputs of its own named
+ * "<path>.<pid>" and forgets what the parent has recorded. An exec'd
+ * image followed by Pin (`-follow_execv`) runs TracerCore again from
+ * `main`, so it gets '-TrProcTag' on its Pin command line instead.
+ */
+
+// Pin command line of this process, up to "--"
+static std::vector<std::string> PinArgs;
+
+/**
+ * Keep the Pin command line for exec'd processes
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+VOID ForkInit(int argc, char* argv[])
+{
+    PinArgs.clear();
+    for (int i = 0; i < argc; ++i) {
+        if (0 == std::string(argv[i]).compare("--")) { break; }
+        PinArgs.push_back(argv[i]);
+    }
+}
+
+/**
+ * Fork callback in the parent before the fork.
+ * Writers are held off and streams are flushed, so the child
+ * gets neither a held lock nor bytes of the parent to write.
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID ForkBefore(THREADID tid, const CONTEXT *ctxt, VOID *v)
+{
+    PIN_GetLock(&WriteFile, tid + 1);
+    if (TO_CHUNK == TrOut) { ChunkHold(TRUE); }
+    if (TrDat.is_open()) { TrDat.flush(); }
+    if (TrSym.is_open()) { TrSym.flush(); }
+    if (TrBlk.is_open()) { TrBlk.flush(); }
+    for (UINT32 l = 0; l < LY_NUM; ++l) {
+        if (TrLayDat[l].is_open()) { TrLayDat[l].flush(); }
+        if (TrLaySym[l].is_open()) { TrLaySym[l].flush(); }
+    }
+}
+
+/**
+ * Fork callback in the parent after the fork
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID ForkParent(THREADID tid, const CONTEXT *ctxt, VOID *v)
+{
+    if (TO_CHUNK == TrOut) { ChunkHold(FALSE); }
+    PIN_ReleaseLock(&WriteFile);
+}
+
+/**
+ * Fork callback in the child after the fork.
+ * Only the thread which forked lives on in the child.
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID ForkChild(THREADID tid, const CONTEXT *ctxt, VOID *v)
+{
+    PIN_InitLock(&WriteFile);
+    BudgetFork();
+    if (TL_CGR == TrSca) { CgFork(); }
+    if (TL_PRF == TrSca) { ProfFork(tid); }
+    if (TL_SMP == TrSca) { SampFork(); }
+    if (TL_CNT == TrSca) { CntFork(); }
+    if (TL_GRM == TrSca) { GramFork(); }
+
+    const std::string pid = decstr(PIN_GetPid());
+    if (EVIL_ARG == reopen_files(pid)) {
+        std::cout << "[!] Failed to open outputs of child " << pid << std::endl;
+        return;
+    }
+    if (TO_SHM == TrOut) { RingThreadStart(tid, 0, 0, 0); }
+    std::cout << "[+] Child " << pid << " writes outputs suffixed by '." << pid << "'" << std::endl;
+}
+
+/**
+ * Follow-child callback, right before this process execs.
+ * The new image writes outputs suffixed by the tag of this
+ * process (or its PID) plus '.exec'. The exec may still fail
+ * (e.g. `execvp` tries each directory of `PATH`), and then this
+ * image goes on tracing, so its outputs are only flushed here,
+ * not finalized. A successful exec drops them as they are, i.e.
+ * what is kept till fini (like a call graph) is lost.
+ * @param cp the child process
+ * @param v from default signature & unused
+ * @return Always `TRUE` to run the new image under Pin
+ */
+BOOL FollowChild(CHILD_PROCESS cp, VOID *v)
+{
+    const std::string tag = (TrTag.size() ? TrTag : decstr(PIN_GetPid())) + ".exec";
+    std::vector<const char*> args;
+    for (size_t i = 0; i < PinArgs.size(); ++i) {
+        if (0 == PinArgs[i].compare("-TrProcTag")) { ++i; continue; }
+        args.push_back(PinArgs[i].c_str());
+    }
+    args.push_back("-TrProcTag");
+    args.push_back(tag.c_str());
+    CHILD_PROCESS_SetPinCommandLine(cp, static_cast<INT>(args.size()), &args[0]);
+
+    //flush just as before a fork, with what this thread has buffered
+    const THREADID tid = PIN_ThreadId();
+    if (TO_CHUNK == TrOut) { ChunkThreadFini(tid, 0, 0, 0); }
+    ForkBefore(tid, 0, 0);
+    ForkParent(tid, 0, 0);
+    return TRUE;
+}
\ No newline at end of file
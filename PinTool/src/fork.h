@@ -0,0 +1,12 @@
+#ifndef HEAD_FORK_H
+#define HEAD_FORK_H
+
+#include "pin.H"
+
+VOID ForkInit(int argc, char* argv[]);
+VOID ForkBefore(THREADID tid, const CONTEXT *ctxt, VOID *v);
+VOID ForkParent(THREADID tid, const CONTEXT *ctxt, VOID *v);
+VOID ForkChild(THREADID tid, const CONTEXT *ctxt, VOID *v);
+BOOL FollowChild(CHILD_PROCESS cp, VOID *v);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "gram.h"
+#include "checker.h"
+#include <vector>
+
+/**
+ * Block n-gram features for `-TrScaType gram`.
+ * Each thread keeps its last `-TrGramN` block IDs and a polynomial
+ * hash of them, updated in O(1) per block. The hash of every n-gram
+ * picks a slot of a count vector of `-TrGramDim` entries (feature
+ * hashing) owned by the thread, so there is no lock, and only the
+ * sum of the vectors is written at fini.
+ * A block ID is a hash of its `ImgOffsetKey`, i.e. its image and
+ * offset inside it, so the same input gives the same vector whatever
+ * the load addresses are, and blocks of different images do not meet.
+ */
+
+#define GRAM_PRIME ((UINT64) 0x100000001B3ULL)
+
+struct GramThread
+{
+    UINT64              win[GRAM_MAX_N]; //ring of the last IDs, `pos` is the oldest
+    UINT64              hash;            //sum of win[oldest + k] * GRAM_PRIME^(N-1-k)
+    UINT32              pos;
+    UINT32              fill;
+    UINT64              grams;
+    std::vector<UINT64> count;
+};
+
+static GramThread* GramState[PIN_MAX_THREADS];
+static UINT32      GramN     = 3;
+static UINT32      GramDim   = 4096;
+static UINT32      GramShift = 52;
+static UINT64      GramTop   = GRAM_PRIME * GRAM_PRIME; //GRAM_PRIME^(N-1)
+
+/**
+ * Set the length of n-grams and the size of the vector
+ * @param n length of n-grams, 1 ~ `GRAM_MAX_N`
+ * @param dim entries of the vector, a power of 2 up to `GRAM_MAX_DIM`
+ */
+VOID GramInit(UINT32 n, UINT32 dim)
+{
+    GramN   = n;
+    GramDim = dim;
+    GramShift = 64;
+    for (UINT32 d = dim; d > 1; d >>= 1) { --GramShift; }
+    GramTop = 1;
+    for (UINT32 k = 1; k < n; ++k) { GramTop *= GRAM_PRIME; }
+}
+
+/**
+ * Start a window from nothing
+ */
+static VOID GramClear(GramThread* t)
+{
+    for (UINT32 k = 0; k < GRAM_MAX_N; ++k) { t->win[k] = 0; }
+    t->hash = 0;
+    t->pos  = 0;
+    t->fill = 0;
+}
+
+/**
+ * Thread start callback. Pin reuses thread IDs, so a reused
+ * ID keeps adding to the same vector with a new window.
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param flags from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID GramThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    GramThread* t = GramState[tid];
+    if (!t) {
+        t = new GramThread();
+        t->grams = 0;
+        t->count.assign(GramDim, 0);
+        GramState[tid] = t;
+    }
+    GramClear(t);
+}
+
+/**
+ * Analyse Routine before each block.
+ * The oldest ID leaves the hash and the new one comes in,
+ * and the n-gram counts once the window is full.
+ * @param tid Pin thread ID
+ * @param id block ID
+ */
+static VOID PIN_FAST_ANALYSIS_CALL GramBbl(THREADID tid, UINT32 id)
+{
+    GramThread* t = GramState[tid];
+    t->hash = (t->hash - t->win[t->pos] * GramTop) * GRAM_PRIME + id;
+    t->win[t->pos] = id;
+    if (++t->pos == GramN) { t->pos = 0; }
+    if (t->fill < GramN && ++t->fill < GramN) { return; }
+    //the hash is linear in the IDs, so mix it before taking the top bits
+    UINT64 h = t->hash;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    ++t->count[(h * 0x9E3779B97F4A7C15ULL) >> GramShift];
+    ++t->grams;
+}
+
+/**
+ * Forget the n-grams of the parent in a forked child
+ */
+VOID GramFork()
+{
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        GramThread* t = GramState[i];
+        if (!t) { continue; }
+        for (size_t s = 0; s < t->count.size(); ++s) { t->count[s] = 0; }
+        t->grams = 0;
+        GramClear(t);
+    }
+}
+
+/**
+ * Instrumentation Routine for n-grams.
+ * Blocks are filtered just like `AnalyseBBL`.
+ * @param Tparam TRACE Object
+ * @param Vparam from default signature & unused
+ */
+VOID AnalyseGRM(TRACE Tparam, VOID *Vparam)
+{
+    for (BBL B__=TRACE_BblHead(Tparam); BBL_Valid(B__); B__=BBL_Next(B__)){
+        const ADDRINT bbl_addr = BBL_Address(B__);
+        if (!IsInsideMain(bbl_addr)) { continue; }
+        if (IsBlocked(bbl_addr)) { continue; }
+
+        const UINT32 id = static_cast<UINT32>((ImgOffsetKey(bbl_addr) * 0x9E3779B97F4A7C15ULL) >> 32);
+        BBL_InsertCall(B__, IPOINT_BEFORE, AFUNPTR(GramBbl),
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID,
+                IARG_UINT32, id,
+            IARG_END);
+    }
+}
+
+/**
+ * Sum the vectors of all threads and write the result.
+ * Must be called after the application threads have finished.
+ * @param vec receives a line "#n=<N> dim=<size> grams=<total>" and
+ *        then "<slot> <count>" for each non-zero slot, in order
+ * @return whether the output is fully written
+ */
+BOOL GramSave(std::ostream &vec)
+{
+    std::vector<UINT64> total(GramDim, 0);
+    UINT64 grams = 0;
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        GramThread* t = GramState[i];
+        if (!t) { continue; }
+        for (UINT32 s = 0; s < GramDim; ++s) { total[s] += t->count[s]; }
+        grams += t->grams;
+        delete t;
+        GramState[i] = 0;
+    }
+
+    vec << "#n=" << GramN << " dim=" << GramDim << " grams=" << grams << "\n";
+    for (UINT32 s = 0; s < GramDim; ++s) {
+        if (total[s]) { vec << s << " " << total[s] << "\n"; }
+    }
+    vec.flush();
+    return vec.good();
+}
\ No newline at end of file
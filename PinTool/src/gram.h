@@ -0,0 +1,16 @@
+#ifndef HEAD_GRAM_H
+#define HEAD_GRAM_H
+
+#include "pin.H"
+#include <ostream>
+
+#define GRAM_MAX_N   ((UINT32) 16)
+#define GRAM_MAX_DIM ((UINT32) 1 << 20)
+
+VOID GramInit(UINT32 n, UINT32 dim);
+VOID AnalyseGRM(TRACE Tparam, VOID *Vparam);
+VOID GramThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v);
+VOID GramFork();
+BOOL GramSave(std::ostream &vec);
+
+#endif
\ No newline at end of file
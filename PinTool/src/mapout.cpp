@@ -0,0 +1,121 @@
+#include "mapout.h"
+#include "amsg.h"
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Memory-mapped trace files for `-TrDatPath map:<path>`.
+ * Records are copied into a `MAP_SHARED` mapping of the file, which
+ * grows by `MAP_EXTENT` at a time, so there is no `write` per record.
+ * The pages belong to the kernel, so complete records survive a
+ * `SIGKILL` (e.g. a timeout) of the target. The layout is described
+ * in `trmap.h`. All calls must be made while holding the lock of
+ * writing files, as with trace files.
+ */
+
+MapFile MapDat = { -1, 0, 0, 0 };
+MapFile MapSym = { -1, 0, 0, 0 };
+
+/**
+ * Map a file of a given size. The new extent is reserved with
+ * `posix_fallocate` rather than left sparse, since a write into a
+ * page the disk has no room for raises `SIGBUS` in the target.
+ * @param mf the file, `fd` open
+ * @param cap the new size of the file
+ * @return `FALSE` for a failed `posix_fallocate` or `mmap`
+ */
+static BOOL MapResize(MapFile &mf, UINT64 cap)
+{
+    if (0 != posix_fallocate(mf.fd, mf.cap, cap - mf.cap)) { return FALSE; }
+    if (mf.base) { munmap(mf.base, mf.cap); mf.base = 0; }
+    VOID* mem = mmap(0, cap, PROT_READ|PROT_WRITE, MAP_SHARED, mf.fd, 0);
+    if (MAP_FAILED == mem) { return FALSE; }
+    mf.base = static_cast<char*>(mem);
+    mf.cap  = cap;
+    return TRUE;
+}
+
+/**
+ * Create a mapped trace file with its first extent
+ * @param mf the file, not open
+ * @param path path of the file
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for any failure
+ */
+INT32 MapOpen(MapFile &mf, const std::string &path)
+{
+    mf.fd = open(path.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (mf.fd < 0) { return EVIL_ARG; }
+    if (!MapResize(mf, MAP_EXTENT)) { close(mf.fd); mf.fd = -1; return EVIL_ARG; }
+    mf.used = 0;
+
+    //a fresh file is all zero, so only the known fields are set
+    MapHead* head = reinterpret_cast<MapHead*>(mf.base);
+    memcpy(head->magic, MAP_MAGIC, sizeof(head->magic));
+    head->version = MAP_VERSION;
+    return GOOD_ARG;
+}
+
+/**
+ * Append a record, and commit it once it is complete.
+ * A file which fails to grow is finished as it is with
+ * `MAP_FLAG_FULL`, so what has been committed stays readable
+ * and readers can tell later records are missing.
+ * @param mf the file, may be closed
+ * @param rec the record, with its line break
+ */
+VOID MapWrite(MapFile &mf, const std::string &rec)
+{
+    if (!mf.base) { return; }
+    const UINT64 end = sizeof(MapHead) + mf.used + rec.size();
+    if (end > mf.cap) {
+        const UINT64 cap = (end + MAP_EXTENT - 1) / MAP_EXTENT * MAP_EXTENT;
+        if (!MapResize(mf, cap)) { MapFinish(mf, MAP_FLAG_FULL); return; }
+    }
+    memcpy(mf.base + sizeof(MapHead) + mf.used, rec.data(), rec.size());
+    mf.used += rec.size();
+    MapHead* head = reinterpret_cast<MapHead*>(mf.base);
+    __atomic_store_n(&head->committed, mf.used, __ATOMIC_RELEASE);
+}
+
+/**
+ * Cut the file right after the records and close it.
+ * Only the first call works. A file failing to be cut is closed
+ * all the same, and readers still stop at the committed length.
+ * @param mf the file, may be closed
+ * @param flags `MAP_FLAG_*` kept in the header besides `MAP_FLAG_CLOSED`
+ */
+VOID MapFinish(MapFile &mf, UINT32 flags)
+{
+    if (mf.fd < 0) { return; }
+    if (mf.base) {
+        MapHead* head = reinterpret_cast<MapHead*>(mf.base);
+        head->flags = flags | MAP_FLAG_CLOSED;
+        munmap(mf.base, mf.cap);
+        mf.base = 0;
+    }
+    const BOOL ok = (0 == ftruncate(mf.fd, sizeof(MapHead) + mf.used));
+    close(mf.fd);
+    mf.fd  = -1;
+    mf.cap = 0;
+    if (!ok) { std::cout << "[!] Failed to cut a mapped output after its records" << std::endl; }
+}
+
+/**
+ * Start a file of its own in a forked child. The mapping inherited
+ * is shared with the parent, which goes on writing the file, so it
+ * is dropped untouched.
+ * @param mf the file, open in the parent
+ * @param path path of the new file
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for a failed open
+ */
+INT32 MapFork(MapFile &mf, const std::string &path)
+{
+    if (mf.base) { munmap(mf.base, mf.cap); mf.base = 0; }
+    if (mf.fd >= 0) { close(mf.fd); mf.fd = -1; }
+    mf.cap  = 0;
+    mf.used = 0;
+    return MapOpen(mf, path);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef HEAD_MAPOUT_H
+#define HEAD_MAPOUT_H
+
+#include "pin.H"
+#include "trmap.h"
+#include <string>
+
+// A trace file mapped by `MapOpen`, see `trmap.h`
+struct MapFile
+{
+    INT32    fd;
+    char*    base; //`NULL` when not open
+    UINT64   cap;  //bytes mapped, i.e. size of the file
+    UINT64   used; //bytes of records written so far
+};
+
+extern MapFile MapDat;
+extern MapFile MapSym;
+
+INT32 MapOpen(MapFile &mf, const std::string &path);
+VOID  MapWrite(MapFile &mf, const std::string &rec);
+VOID  MapFinish(MapFile &mf, UINT32 flags);
+INT32 MapFork(MapFile &mf, const std::string &path);
+
+#endif
\ No newline at end of file
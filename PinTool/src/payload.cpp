@@ -1,6 +1,14 @@
 #include "payload.h"
 #include "checker.h"
 #include "cli.h"
+#include "amsg.h"
+#include "ring.h"
+#include "chunk.h"
+#include "mapout.h"
+#include "budget.h"
+#include "cov.h"
+#include "blktab.h"
+#include "ctl.h"
 
 /**
  * Please refer to:
@@ -24,29 +32,195 @@ PIN_LOCK WriteFile; //the lock used in writing files
 
 /**
  * Analyse Routine for saving address
+ * @tparam BUDGET whether `-TrMaxEvents` / `-TrMaxBytes` is set
  * @param addr memory address
  */
-VOID SaveDat(ADDRINT addr)
+template<BOOL BUDGET>
+static VOID PIN_FAST_ANALYSIS_CALL SaveDat(ADDRINT addr)
 {
     PIN_GetLock(&WriteFile, WriteFile._owner);
-    TrDat << hexstr(addr) << std::endl;
+    if (!BUDGET) { TrDat << hexstr(addr) << std::endl; }
+    else if (!TrStop.load(std::memory_order_relaxed)) {
+        const std::string sdat = hexstr(addr);
+        TrDat << sdat << std::endl;
+        BudgetCharge(0, 1, sdat.size() + 1);
+    }
     PIN_ReleaseLock(&WriteFile);
 }
 
 /**
  * Analyse Routine for saving address, thread-ID and symbol string
+ * @tparam BUDGET whether `-TrMaxEvents` / `-TrMaxBytes` is set
  * @param addr memory address
  * @param tidv thread ID
  * @param psym pointer of a symbol string
  */
-VOID SaveDatSym(ADDRINT addr, PIN_THREAD_UID tidv, std::string *psym)
+template<BOOL BUDGET>
+static VOID PIN_FAST_ANALYSIS_CALL SaveDatSym(ADDRINT addr, PIN_THREAD_UID tidv, std::string *psym)
 {
     PIN_GetLock(&WriteFile, WriteFile._owner);
-    TrDat << hexstr(addr) << std::endl;
-    TrSym << hexstr(tidv) << "," << *psym << std::endl;
+    if (!BUDGET) {
+        TrDat << hexstr(addr) << std::endl;
+        TrSym << hexstr(tidv) << "," << *psym << std::endl;
+    } else if (!TrStop.load(std::memory_order_relaxed)) {
+        const std::string sdat = hexstr(addr);
+        const std::string stid = hexstr(tidv);
+        TrDat << sdat << std::endl;
+        TrSym << stid << "," << *psym << std::endl;
+        BudgetCharge(0, 1, sdat.size() + stid.size() + psym->size() + 3);
+    }
     PIN_ReleaseLock(&WriteFile);
 }
 
+/**
+ * Analyse Routine for saving records of several layers at once,
+ * from the coarsest, so their order in each stream is kept
+ * @tparam BUDGET whether `-TrMaxEvents` / `-TrMaxBytes` is set
+ * @param layers `LY_BIT` of the layers the address is recorded in
+ * @param addr memory address
+ * @param tidv thread ID
+ * @param psym pointer of a symbol string, `NULL` without symbols
+ */
+template<BOOL BUDGET>
+static VOID PIN_FAST_ANALYSIS_CALL SaveLayers(UINT32 layers, ADDRINT addr, PIN_THREAD_UID tidv, std::string *psym)
+{
+    PIN_GetLock(&WriteFile, WriteFile._owner);
+    if (!BUDGET || !TrStop.load(std::memory_order_relaxed)) {
+        const std::string sdat = hexstr(addr);
+        const std::string stid = psym ? hexstr(tidv) : "";
+        UINT64 events = 0;
+        for (UINT32 l = 0; l < LY_NUM; ++l) {
+            if (!(layers & LY_BIT(l))) { continue; }
+            (l == TrFine ? TrDat : TrLayDat[l]) << sdat << std::endl;
+            if (psym) { (l == TrFine ? TrSym : TrLaySym[l]) << stid << "," << *psym << std::endl; }
+            ++events;
+        }
+        if (BUDGET) { BudgetCharge(0, events, events * (sdat.size() + 1 + (psym ? stid.size() + psym->size() + 2 : 0))); }
+    }
+    PIN_ReleaseLock(&WriteFile);
+}
+
+/**
+ * Analyse Routine for saving address into a mapped trace file
+ * @tparam BUDGET whether `-TrMaxEvents` / `-TrMaxBytes` is set
+ * @param addr memory address
+ */
+template<BOOL BUDGET>
+static VOID PIN_FAST_ANALYSIS_CALL SaveMap(ADDRINT addr)
+{
+    PIN_GetLock(&WriteFile, WriteFile._owner);
+    if (!BUDGET || !TrStop.load(std::memory_order_relaxed)) {
+        const std::string sdat = hexstr(addr) + "\n";
+        MapWrite(MapDat, sdat);
+        if (BUDGET) { BudgetCharge(0, 1, sdat.size()); }
+    }
+    PIN_ReleaseLock(&WriteFile);
+}
+
+/**
+ * Analyse Routine for saving address, thread-ID and symbol string
+ * into mapped trace files
+ * @tparam BUDGET whether `-TrMaxEvents` / `-TrMaxBytes` is set
+ * @param addr memory address
+ * @param tidv thread ID
+ * @param psym pointer of a symbol string
+ */
+template<BOOL BUDGET>
+static VOID PIN_FAST_ANALYSIS_CALL SaveMapSym(ADDRINT addr, PIN_THREAD_UID tidv, std::string *psym)
+{
+    PIN_GetLock(&WriteFile, WriteFile._owner);
+    if (!BUDGET || !TrStop.load(std::memory_order_relaxed)) {
+        const std::string sdat = hexstr(addr) + "\n";
+        const std::string ssym = hexstr(tidv) + "," + *psym + "\n";
+        MapWrite(MapDat, sdat);
+        MapWrite(MapSym, ssym);
+        if (BUDGET) { BudgetCharge(0, 1, sdat.size() + ssym.size()); }
+    }
+    PIN_ReleaseLock(&WriteFile);
+}
+
+// Global Variable
+// The recording routine of this run, one instance of the
+// templates above (or of those for rings and chunks).
+static AFUNPTR RecFn = 0;
+
+/**
+ * Choose the recording routine once the knobs are known, so
+ * no check on them is left in the routine running per record.
+ * Must be called after all `init_*` and before `PIN_StartProgram`.
+ */
+VOID SelectRecord()
+{
+    if (TL_MUL == TrSca) { RecFn = TrBudget ? AFUNPTR(SaveLayers<TRUE>) : AFUNPTR(SaveLayers<FALSE>); }
+    else if (TO_SHM == TrOut) { RecFn = RingPushFn(TrBudget); }
+    else if (TO_CHUNK == TrOut) { RecFn = ChunkPushFn(TrBudget); }
+    else if (TO_MAP == TrOut && MapSym.base) { RecFn = TrBudget ? AFUNPTR(SaveMapSym<TRUE>) : AFUNPTR(SaveMapSym<FALSE>); }
+    else if (TO_MAP == TrOut) { RecFn = TrBudget ? AFUNPTR(SaveMap<TRUE>) : AFUNPTR(SaveMap<FALSE>); }
+    else if (TrSym.is_open()) { RecFn = TrBudget ? AFUNPTR(SaveDatSym<TRUE>) : AFUNPTR(SaveDatSym<FALSE>); }
+    else { RecFn = TrBudget ? AFUNPTR(SaveDat<TRUE>) : AFUNPTR(SaveDat<FALSE>); }
+}
+
+/**
+ * Whether the symbol string of each record is needed
+ */
+static inline BOOL NeedSym()
+{
+    if (TO_SHM == TrOut) { return TrSymShm; }
+    if (TO_MAP == TrOut) { return MapSym.base != 0; }
+    return TrSym.is_open();
+}
+
+/**
+ * Insert the recording routine for an address before an instruction.
+ * With `-TrCovPath`, it only runs when the address is new to the
+ * global coverage map.
+ * @param Iparam Instruction Object where the record is made
+ * @param addr address where the record is made
+ * @param sym symbol string of the address, unused without symbols
+ * @param rec what to record, usually equals to `addr`
+ * @param gate whether it only runs while recording is on, for code
+ *        which is not instrumented again when `-TrCtlPath` switches
+ */
+static VOID InsertRecord(INS Iparam, ADDRINT addr, const std::string &sym, ADDRINT rec, BOOL gate)
+{
+    typedef VOID (*INSERTER)(INS, IPOINT, AFUNPTR, ...);
+    gate = gate && TrCtl;
+    INSERTER insert = (TrCov || gate) ? INSERTER(INS_InsertThenCall) : INSERTER(INS_InsertCall);
+    if (TrCov) { CovInsertIf(Iparam, addr, gate); }
+    else if (gate) {
+        INS_InsertIfCall(Iparam, IPOINT_BEFORE, AFUNPTR(CtlIsOn),
+                IARG_FAST_ANALYSIS_CALL,
+            IARG_END);
+    }
+    if (TO_SHM == TrOut) {
+        UINT32 sid = TrSymShm ? RingSymId(sym) : 0;
+        insert(Iparam, IPOINT_BEFORE, RecFn,
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID,
+                IARG_ADDRINT, rec,
+                IARG_UINT32,  sid,
+            IARG_END);
+    } else if (TO_CHUNK == TrOut) {
+        insert(Iparam, IPOINT_BEFORE, RecFn,
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_THREAD_ID,
+                IARG_ADDRINT, rec,
+            IARG_END);
+    } else if (!NeedSym()) {
+        insert(Iparam, IPOINT_BEFORE, RecFn,
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_ADDRINT, rec,
+            IARG_END);
+    } else {
+        insert(Iparam, IPOINT_BEFORE, RecFn,
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_ADDRINT, rec,
+                IARG_UINT64,  PIN_ThreadUid(),
+                IARG_PTR,     SymPtrLst.GetSymPtr(sym),
+            IARG_END);
+    }
+}
+
 /**
  * Instrumentation Routine at instruction-level
  * @param Iparam Instruction Object
@@ -59,24 +233,17 @@ VOID AnalyseINS(INS Iparam, VOID *Vparam)
     else {
         if (IsBlocked(ins_addr)) { return; }
         else {
-            if (!TrSym.is_open()) {
-                INS_InsertCall(Iparam, IPOINT_BEFORE, AFUNPTR(SaveDat), 
-                        IARG_ADDRINT, ins_addr,
-                    IARG_END);
-            } else {
-                std::string ins_name; DumpSymInfo(ins_name, ins_addr);
-                INS_InsertCall(Iparam, IPOINT_BEFORE, AFUNPTR(SaveDatSym),
-                        IARG_ADDRINT, ins_addr,
-                        IARG_UINT64,  PIN_ThreadUid(),
-                        IARG_PTR,     SymPtrLst.GetSymPtr(ins_name),
-                    IARG_END);
-            }
+            std::string ins_name;
+            if (NeedSym()) { DumpSymInfo(ins_name, ins_addr); }
+            InsertRecord(Iparam, ins_addr, ins_name, ins_addr, FALSE);
         }
     }
 }
 
 /**
- * Instrumentation Routine at basic-block-level
+ * Instrumentation Routine at basic-block-level.
+ * A call before the head instruction of a block is
+ * the same as a call before the block.
  * @param Tparam TRACE Object
  * @param Vparam from default signature & unused
  */
@@ -88,25 +255,17 @@ VOID AnalyseBBL(TRACE Tparam, VOID *Vparam)
         else {
             if (IsBlocked(bbl_addr)) { continue; }
             else {
-                if (!TrSym.is_open()) {
-                    BBL_InsertCall(B__, IPOINT_BEFORE, AFUNPTR(SaveDat),
-                        IARG_ADDRINT, bbl_addr,
-                    IARG_END);
-                } else {
-                    std::string bbl_name; DumpSymInfo(bbl_name, bbl_addr);
-                    BBL_InsertCall(B__, IPOINT_BEFORE, AFUNPTR(SaveDatSym),
-                        IARG_ADDRINT, bbl_addr,
-                        IARG_UINT64,  PIN_ThreadUid(),
-                        IARG_PTR,     SymPtrLst.GetSymPtr(bbl_name),
-                    IARG_END);
-                }
+                std::string bbl_name;
+                if (NeedSym()) { DumpSymInfo(bbl_name, bbl_addr); }
+                InsertRecord(BBL_InsHead(B__), bbl_addr, bbl_name, bbl_addr, FALSE);
             }
         }
     }
 }
 
 /**
- * Instrumentation Routine at function-call-level
+ * Instrumentation Routine at function-call-level.
+ * The record is made before the head instruction of the routine.
  * @param Rparam Routine Object
  * @param Vparam from default signature & unused
  */
@@ -116,20 +275,110 @@ VOID AnalyseCAL(RTN Rparam, VOID *Vparam)
     else {
         if (IsBlocked(Rparam)) { return; }
         else {
-            if (!TrSym.is_open()) {
-                RTN_InsertCall(Rparam, IPOINT_BEFORE, AFUNPTR(SaveDat),
-                        IARG_ADDRINT, RTN_Address(Rparam), 
-                    IARG_END);
-            } else {
-                std::string rname; DumpSymInfo(rname, Rparam);
-                RTN_Open(Rparam);
-                RTN_InsertCall(Rparam, IPOINT_BEFORE, AFUNPTR(SaveDatSym),
-                        IARG_ADDRINT, RTN_Address(Rparam),
-                        IARG_UINT64,  PIN_ThreadUid(),
-                        IARG_PTR,     SymPtrLst.GetSymPtr(rname),
-                    IARG_END);
-                RTN_Close(Rparam);
+            std::string rname;
+            if (NeedSym()) { DumpSymInfo(rname, Rparam); }
+            RTN_Open(Rparam);
+            INS head = RTN_InsHead(Rparam);
+            if (INS_Valid(head)) { InsertRecord(head, RTN_Address(Rparam), rname, RTN_Address(Rparam), TRUE); }
+            RTN_Close(Rparam);
+        }
+    }
+}
+
+/**
+ * Instrumentation Routine at instruction-level, via basic blocks.
+ * Only the ID of each block entered is recorded, while instructions
+ * of the block are written into the block table once. `TraceExpand`
+ * regenerates the instruction-level trace from both offline.
+ * @param Tparam TRACE Object
+ * @param Vparam from default signature & unused
+ */
+VOID AnalyseIXB(TRACE Tparam, VOID *Vparam)
+{
+    for (BBL B__=TRACE_BblHead(Tparam); BBL_Valid(B__); B__=BBL_Next(B__)){
+        ADDRINT bbl_addr = BBL_Address(B__);
+        if (!IsInsideMain(bbl_addr)) { continue; }
+        else {
+            if (IsBlocked(bbl_addr)) { continue; }
+            else {
+                std::string bbl_name;
+                if (NeedSym()) { DumpSymInfo(bbl_name, bbl_addr); }
+                InsertRecord(BBL_InsHead(B__), bbl_addr, bbl_name, BlkId(B__), FALSE);
+            }
+        }
+    }
+}
+
+/**
+ * Context change callback for `-TrScaType ixb`.
+ * A signal or an exception may leave a block before its last
+ * instruction, so a marker "#EXIT <thread ID> <address>" tells that
+ * the block recorded lastly by this thread stopped right before the
+ * address. The thread ID is the one of the trace symbol file.
+ * The chunked container can not hold it, and `init_TrBlk` refuses it.
+ * @param tid Pin thread ID
+ * @param reason from default signature & unused
+ * @param from context interrupted, `NULL` if unknown
+ * @param to from default signature & unused
+ * @param info from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID MarkEarlyExit(THREADID tid, CONTEXT_CHANGE_REASON reason,
+                   const CONTEXT *from, CONTEXT *to, INT32 info, VOID *v)
+{
+    if (!from) { return; }
+    const ADDRINT ip = PIN_GetContextReg(from, REG_INST_PTR);
+    if (!IsInsideMain(ip)) { return; }
+    if (TO_SHM == TrOut) { RingPush(tid, ip, SHM_SYM_EXIT); return; }
+
+    PIN_GetLock(&WriteFile, WriteFile._owner);
+    if (!TrStop.load(std::memory_order_relaxed)) {
+        const std::string mark = "#EXIT " + hexstr(PIN_ThreadUid()) + " " + hexstr(ip);
+        if (TO_MAP == TrOut) {
+            MapWrite(MapDat, mark + "\n");
+            MapWrite(MapSym, mark + "\n");
+        } else {
+            TrDat << mark << std::endl;
+            if (TrSym.is_open()) { TrSym << mark << std::endl; }
+        }
+    }
+    PIN_ReleaseLock(&WriteFile);
+}
+
+/**
+ * Instrumentation Routine for several layers in one run.
+ * Each instruction gets one call at most, recording it in every
+ * layer it belongs to: 'ins' for itself, 'bbl' as the head of a
+ * block and 'cal' as the head of a routine. All layers share one
+ * symbol string per address, just as the layers of a single run.
+ * @param Tparam TRACE Object
+ * @param Vparam from default signature & unused
+ */
+VOID AnalyseMUL(TRACE Tparam, VOID *Vparam)
+{
+    for (BBL B__=TRACE_BblHead(Tparam); BBL_Valid(B__); B__=BBL_Next(B__)){
+        BOOL head = TRUE;
+        for (INS I__=BBL_InsHead(B__); INS_Valid(I__); I__=INS_Next(I__), head=FALSE){
+            ADDRINT ins_addr = INS_Address(I__);
+            if (!IsInsideMain(ins_addr)) { continue; }
+            if (IsBlocked(ins_addr)) { continue; }
+            UINT32 layers = TrLayers & LY_BIT(LY_INS);
+            if (head) { layers |= TrLayers & LY_BIT(LY_BBL); }
+            if (TrLayers & LY_BIT(LY_CAL)) {
+                RTN rtni = INS_Rtn(I__);
+                if (RTN_Valid(rtni) && RTN_Address(rtni) == ins_addr && IsInsideMain(rtni) && !IsBlocked(rtni))
+                    { layers |= LY_BIT(LY_CAL); }
             }
+            if (!layers) { continue; }
+            std::string ins_name;
+            if (TrSym.is_open()) { DumpSymInfo(ins_name, ins_addr); }
+            INS_InsertCall(I__, IPOINT_BEFORE, RecFn,
+                    IARG_FAST_ANALYSIS_CALL,
+                    IARG_UINT32,  layers,
+                    IARG_ADDRINT, ins_addr,
+                    IARG_UINT64,  PIN_ThreadUid(),
+                    IARG_PTR,     TrSym.is_open() ? SymPtrLst.GetSymPtr(ins_name) : 0,
+                IARG_END);
         }
     }
 }
\ No newline at end of file
@@ -3,8 +3,17 @@
 
 #include "pin.H"
 
+extern PIN_LOCK WriteFile;
+
+VOID SelectRecord();
+
 VOID AnalyseINS(INS   Iparam, VOID *Vparam);
 VOID AnalyseBBL(TRACE Tparam, VOID *Vparam);
 VOID AnalyseCAL(RTN   Rparam, VOID *Vparam);
+VOID AnalyseIXB(TRACE Tparam, VOID *Vparam);
+VOID AnalyseMUL(TRACE Tparam, VOID *Vparam);
+
+VOID MarkEarlyExit(THREADID tid, CONTEXT_CHANGE_REASON reason,
+                   const CONTEXT *from, CONTEXT *to, INT32 info, VOID *v);
 
 #endif
\ No newline at end of file
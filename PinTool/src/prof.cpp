@@ -0,0 +1,303 @@
+#include "prof.h"
+#include "checker.h"
+#include "cli.h"
+#include "ctl.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <x86intrin.h>
+
+/**
+ * Function-level profiler for `-TrScaType prof`.
+ * Each thread keeps a shadow stack of the routines it is in and a
+ * calling context tree (CCT) of the paths it has been through. Entry
+ * and exit read the TSC and only touch the state of their own thread,
+ * so there is no lock and no I/O until `ProfSave` at fini.
+ */
+
+#define PROF_MAX_DEPTH ((UINT32) 4096)
+#define PROF_NO_RTN    ((UINT32) -1)
+
+// A node of the CCT, i.e. a routine reached through a certain path
+struct ProfNode
+{
+    UINT32 parent;
+    UINT32 rtn;
+    UINT64 calls;
+    UINT64 incl;   //cycles inside the routine and its callees
+    UINT64 excl;   //cycles inside the routine itself
+};
+
+// A routine being executed. `last_*` caches the child node
+// entered lastly, since loops enter the same callee again and again.
+// A frame entered while recording is off by `-TrCtlPath` keeps the
+// node of its caller and counts nothing, but it is still on the stack
+// so its return can not end a frame of the same routine below it.
+struct ProfFrame
+{
+    UINT32 node;
+    UINT32 rtn;
+    BOOL   off;
+    UINT32 last_rtn;
+    UINT32 last_node;
+    UINT64 start;
+    UINT64 child; //cycles spent in callees
+};
+
+struct ProfThread
+{
+    std::vector<ProfNode>               nodes; //node 0 is the root
+    std::unordered_map<UINT64, UINT32>  child; //(parent << 32 | rtn) => node
+    ProfFrame                           stack[PROF_MAX_DEPTH + 1];
+    UINT32                              depth; //stack[0] is the root frame
+    UINT32                              over;  //frames not pushed for the depth limit
+};
+
+static ProfThread* ProfState[PIN_MAX_THREADS];
+
+// Name of each routine seen at instrumentation time, indexed by
+// routine ID. Pin holds its internal lock meanwhile.
+static std::vector<std::string> ProfNames;
+static std::map<ADDRINT, UINT32> ProfIds;
+
+/**
+ * Thread start callback. Pin reuses thread IDs,
+ * so a reused ID keeps adding to the same tree.
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param flags from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID ProfThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    ProfThread* t = ProfState[tid];
+    if (!t) {
+        t = new ProfThread();
+        ProfNode root = {0, PROF_NO_RTN, 0, 0, 0};
+        t->nodes.push_back(root);
+        ProfState[tid] = t;
+    }
+    ProfFrame &f = t->stack[0];
+    f.node = 0; f.rtn = PROF_NO_RTN; f.off = FALSE;
+    f.last_rtn = PROF_NO_RTN; f.last_node = 0;
+    f.start = __rdtsc(); f.child = 0;
+    t->depth = 0;
+    t->over  = 0;
+}
+
+/**
+ * Get the CCT node of a routine called from a frame
+ */
+static inline UINT32 ProfChild(ProfThread* t, ProfFrame &f, UINT32 rtn)
+{
+    if (f.last_rtn == rtn) { return f.last_node; }
+    const UINT64 key = ((UINT64) f.node << 32) | rtn;
+    std::unordered_map<UINT64, UINT32>::iterator it = t->child.find(key);
+    UINT32 node;
+    if (it != t->child.end()) { node = it->second; }
+    else {
+        node = static_cast<UINT32>(t->nodes.size());
+        ProfNode n = {f.node, rtn, 0, 0, 0};
+        t->nodes.push_back(n);
+        t->child[key] = node;
+    }
+    f.last_rtn  = rtn;
+    f.last_node = node;
+    return node;
+}
+
+/**
+ * Pop the top frame and account its cycles
+ */
+static inline VOID ProfPop(ProfThread* t, UINT64 now)
+{
+    ProfFrame &f = t->stack[t->depth--];
+    const UINT64 dur = now - f.start;
+    t->stack[t->depth].child += dur;
+    if (f.off) { return; }
+    ProfNode &n = t->nodes[f.node];
+    ++n.calls;
+    n.incl += dur;
+    n.excl += dur - f.child;
+}
+
+/**
+ * Analyse Routine at the entry of a routine
+ * @param tid Pin thread ID
+ * @param rtn routine ID
+ */
+static VOID PIN_FAST_ANALYSIS_CALL ProfEnter(THREADID tid, UINT32 rtn)
+{
+    ProfThread* t = ProfState[tid];
+    if (t->depth >= PROF_MAX_DEPTH) { ++t->over; return; }
+    const UINT32 node = ProfChild(t, t->stack[t->depth], rtn);
+    ProfFrame &f = t->stack[++t->depth];
+    f.node = node; f.rtn = rtn; f.off = FALSE;
+    f.last_rtn = PROF_NO_RTN;
+    f.child = 0;
+    f.start = __rdtsc();
+}
+
+/**
+ * Analyse Routine at the entry of a routine with `-TrCtlPath`.
+ * While recording is off, a frame counting nothing is pushed.
+ * @param tid Pin thread ID
+ * @param rtn routine ID
+ */
+static VOID PIN_FAST_ANALYSIS_CALL ProfEnterCtl(THREADID tid, UINT32 rtn)
+{
+    if (CtlIsOn()) { ProfEnter(tid, rtn); return; }
+    ProfThread* t = ProfState[tid];
+    if (t->depth >= PROF_MAX_DEPTH) { ++t->over; return; }
+    const UINT32 node = t->stack[t->depth].node;
+    ProfFrame &f = t->stack[++t->depth];
+    f.node = node; f.rtn = rtn; f.off = TRUE;
+    f.last_rtn = PROF_NO_RTN;
+    f.child = 0;
+    f.start = __rdtsc();
+}
+
+/**
+ * Analyse Routine at each return of a routine. Frames above the
+ * matching one were left without a return (e.g. by `longjmp`),
+ * and they end here too. A return without a matching frame is ignored.
+ * @param tid Pin thread ID
+ * @param rtn routine ID
+ */
+static VOID PIN_FAST_ANALYSIS_CALL ProfLeave(THREADID tid, UINT32 rtn)
+{
+    const UINT64 now = __rdtsc();
+    ProfThread* t = ProfState[tid];
+    if (t->over) { --t->over; return; }
+    UINT32 d = t->depth;
+    while (d && t->stack[d].rtn != rtn) { --d; }
+    if (!d) { return; }
+    while (t->depth >= d) { ProfPop(t, now); }
+}
+
+/**
+ * Thread fini callback, which ends frames never returned
+ * @param tid Pin thread ID
+ * @param ctxt from default signature & unused
+ * @param code from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID ProfThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    ProfThread* t = ProfState[tid];
+    if (!t) { return; }
+    const UINT64 now = __rdtsc();
+    while (t->depth) { ProfPop(t, now); }
+    t->over = 0;
+}
+
+/**
+ * Forget the cycles counted by the parent in a forked child.
+ * Only the thread which forked lives on, and its frames
+ * restart from now, so the tree keeps its shape.
+ * @param tid Pin thread ID of the thread which forked
+ */
+VOID ProfFork(THREADID tid)
+{
+    const UINT64 now = __rdtsc();
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        ProfThread* t = ProfState[i];
+        if (!t) { continue; }
+        for (size_t n = 0; n < t->nodes.size(); ++n)
+            { t->nodes[n].calls = 0; t->nodes[n].incl = 0; t->nodes[n].excl = 0; }
+        if (i != tid) { t->depth = 0; t->over = 0; continue; }
+        for (UINT32 d = 0; d <= t->depth; ++d)
+            { t->stack[d].start = now; t->stack[d].child = 0; }
+    }
+}
+
+/**
+ * Instrumentation Routine for the profiler.
+ * Routines are filtered just like `AnalyseCAL`.
+ * With `-TrCtlPath`, entries while recording is off push frames
+ * counting nothing, so the stack still matches the returns.
+ * @param Rparam Routine Object
+ * @param Vparam from default signature & unused
+ */
+VOID AnalysePRF(RTN Rparam, VOID *Vparam)
+{
+    if (!IsInsideMain(Rparam)) { return; }
+    if (IsBlocked(Rparam)) { return; }
+
+    const ADDRINT raddr = RTN_Address(Rparam);
+    std::map<ADDRINT, UINT32>::iterator it = ProfIds.find(raddr);
+    UINT32 rid;
+    if (it != ProfIds.end()) { rid = it->second; }
+    else {
+        rid = static_cast<UINT32>(ProfNames.size());
+        std::string rname; DumpSymInfo(rname, Rparam);
+        ProfNames.push_back(rname);
+        ProfIds[raddr] = rid;
+    }
+
+    RTN_Open(Rparam);
+    RTN_InsertCall(Rparam, IPOINT_BEFORE, TrCtl ? AFUNPTR(ProfEnterCtl) : AFUNPTR(ProfEnter),
+            IARG_FAST_ANALYSIS_CALL,
+            IARG_THREAD_ID,
+            IARG_UINT32, rid,
+        IARG_END);
+    RTN_InsertCall(Rparam, IPOINT_AFTER, AFUNPTR(ProfLeave),
+            IARG_FAST_ANALYSIS_CALL,
+            IARG_THREAD_ID,
+            IARG_UINT32, rid,
+        IARG_END);
+    RTN_Close(Rparam);
+}
+
+/**
+ * Merge the trees of all threads and write the results.
+ * Must be called after the application threads have finished.
+ * @param folded receives one line per calling path, like
+ *        "main;foo;bar <exclusive cycles>", which flame graph tools take
+ * @param summary receives "routine,calls,inclusive,exclusive" CSV rows,
+ *        or `NULL` to skip. Recursive calls count once in inclusive cycles.
+ * @return whether the outputs are fully written
+ */
+BOOL ProfSave(std::ostream &folded, std::ostream *summary)
+{
+    std::map<std::string, UINT64> paths;
+    std::vector<UINT64> calls(ProfNames.size(), 0), incl(ProfNames.size(), 0), excl(ProfNames.size(), 0);
+
+    for (UINT32 i = 0; i < PIN_MAX_THREADS; ++i) {
+        ProfThread* t = ProfState[i];
+        if (!t) { continue; }
+        const UINT64 now = __rdtsc();
+        while (t->depth) { ProfPop(t, now); }
+
+        //a parent is always created before its children
+        std::vector<std::string> path(t->nodes.size());
+        for (UINT32 n = 1; n < t->nodes.size(); ++n) {
+            const ProfNode &pn = t->nodes[n];
+            const std::string name = FoldName(ProfNames[pn.rtn]);
+            path[n] = pn.parent ? path[pn.parent] + ";" + name : name;
+            if (pn.excl) { paths[path[n]] += pn.excl; }
+
+            calls[pn.rtn] += pn.calls;
+            excl[pn.rtn]  += pn.excl;
+            BOOL nested = FALSE;
+            for (UINT32 a = pn.parent; a && !nested; a = t->nodes[a].parent)
+                { nested = (t->nodes[a].rtn == pn.rtn); }
+            if (!nested) { incl[pn.rtn] += pn.incl; }
+        }
+        delete t;
+        ProfState[i] = 0;
+    }
+
+    for (std::map<std::string, UINT64>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+        { folded << it->first << " " << it->second << "\n"; }
+    folded.flush();
+    if (!summary) { return folded.good(); }
+
+    *summary << "routine,calls,inclusive,exclusive\n";
+    for (UINT32 r = 0; r < ProfNames.size(); ++r) {
+        if (!calls[r]) { continue; }
+        *summary << CsvQuote(ProfNames[r]) << "," << calls[r] << "," << incl[r] << "," << excl[r] << "\n";
+    }
+    summary->flush();
+    return folded.good() && summary->good();
+}
@@ -0,0 +1,13 @@
+#ifndef HEAD_PROF_H
+#define HEAD_PROF_H
+
+#include "pin.H"
+#include <ostream>
+
+VOID AnalysePRF(RTN Rparam, VOID *Vparam);
+VOID ProfThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v);
+VOID ProfThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v);
+VOID ProfFork(THREADID tid);
+BOOL ProfSave(std::ostream &folded, std::ostream *summary);
+
+#endif
@@ -0,0 +1,152 @@
+#include "range.h"
+#include "amsg.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <vector>
+
+/**
+ * Address allowlist for `-TrRangeFile`.
+ * Each line of the file is one of
+ *   "<lo>-<hi>"            link-time addresses [lo, hi), like what
+ *                          `nm` or `readelf` shows, in hex
+ *   "<routine>"            the whole routine of that name
+ * optionally after "<image>!" to pick an image other than the main
+ * executable, e.g. "libc.so.6!memcpy". The image is matched by its
+ * path or its file name. Empty lines and lines from '#' are skipped.
+ * Ranges of an image are resolved when it is met for the first time,
+ * by adding its load offset, and kept as sorted disjoint intervals.
+ */
+
+// A line of the range file
+struct RangeSpec
+{
+    std::string img;  //"" for the main executable
+    std::string rtn;  //"" for an address range
+    ADDRINT     lo;
+    ADDRINT     hi;
+};
+
+typedef std::vector<std::pair<ADDRINT, ADDRINT> > RangeList;
+
+// Guarded by the client lock of Pin.
+static std::vector<RangeSpec>   RangeSpecs;
+static std::map<UINT32, RangeList> RangeByImg; //by image ID, resolved lazily
+
+/**
+ * Read a hex number like "0x401a2b"
+ */
+static BOOL ParseHex(const std::string &s, ADDRINT &v)
+{
+    if (s.size() < 3 || s[0] != '0' || (s[1] != 'x' && s[1] != 'X')) { return FALSE; }
+    v = 0;
+    for (size_t i = 2; i < s.size(); ++i) {
+        const char c = s[i];
+        if      (c >= '0' && c <= '9') { v = (v << 4) | (ADDRINT)(c - '0'); }
+        else if (c >= 'a' && c <= 'f') { v = (v << 4) | (ADDRINT)(c - 'a' + 10); }
+        else if (c >= 'A' && c <= 'F') { v = (v << 4) | (ADDRINT)(c - 'A' + 10); }
+        else { return FALSE; }
+    }
+    return TRUE;
+}
+
+/**
+ * Load the range file
+ * @param path path of the file
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for a failed `open`,
+ *         a malformed line or no range at all
+ */
+INT32 RangeLoad(const std::string &path)
+{
+    std::ifstream ifs(path.c_str());
+    if (!ifs.is_open()) { return EVIL_ARG; }
+    std::string line;
+    while (std::getline(ifs, line)) {
+        const size_t b = line.find_first_not_of(" \t\r");
+        if (std::string::npos == b || '#' == line[b]) { continue; }
+        line = line.substr(b, line.find_last_not_of(" \t\r") + 1 - b);
+
+        RangeSpec rs;
+        rs.lo = rs.hi = 0;
+        const size_t bang = line.rfind('!');
+        if (std::string::npos != bang) { rs.img = line.substr(0, bang); line = line.substr(bang + 1); }
+        const size_t dash = line.find('-');
+        if (0 == line.compare(0, 2, "0x") && std::string::npos != dash) {
+            if (!ParseHex(line.substr(0, dash), rs.lo) || !ParseHex(line.substr(dash + 1), rs.hi) ||
+                    rs.lo >= rs.hi)
+                { return EVIL_ARG; }
+        } else if (line.size()) { rs.rtn = line; }
+        else { return EVIL_ARG; }
+        RangeSpecs.push_back(rs);
+    }
+    return RangeSpecs.size() ? GOOD_ARG : EVIL_ARG;
+}
+
+/**
+ * Whether a range of the file names this image
+ */
+static BOOL ImgMatch(const std::string &want, IMG Iparam)
+{
+    if (0 == want.size()) { return IMG_IsMainExecutable(Iparam); }
+    const std::string name = IMG_Name(Iparam);
+    if (name == want) { return TRUE; }
+    const size_t slash = name.rfind('/');
+    return (std::string::npos != slash) && (0 == name.compare(slash + 1, std::string::npos, want));
+}
+
+/**
+ * Resolve the ranges of an image into sorted disjoint intervals
+ */
+static VOID RangeResolve(IMG Iparam, RangeList &lst)
+{
+    const ADDRINT bias = IMG_LoadOffset(Iparam);
+    for (size_t i = 0; i < RangeSpecs.size(); ++i) {
+        const RangeSpec &rs = RangeSpecs[i];
+        if (!ImgMatch(rs.img, Iparam)) { continue; }
+        if (0 == rs.rtn.size()) { lst.push_back(std::make_pair(rs.lo + bias, rs.hi + bias)); continue; }
+        RTN rtni = RTN_FindByName(Iparam, rs.rtn.c_str());
+        if (RTN_Valid(rtni) && RTN_Size(rtni))
+            { lst.push_back(std::make_pair(RTN_Address(rtni), RTN_Address(rtni) + RTN_Size(rtni))); }
+    }
+    std::sort(lst.begin(), lst.end());
+    size_t n = 0;
+    for (size_t i = 0; i < lst.size(); ++i) {
+        if (n && lst[i].first <= lst[n - 1].second) { lst[n - 1].second = std::max(lst[n - 1].second, lst[i].second); }
+        else { lst[n++] = lst[i]; }
+    }
+    lst.resize(n);
+}
+
+/**
+ * Whether an address is inside the ranges
+ * @param addr memory address
+ * @return true or false
+ */
+BOOL RangeHas(ADDRINT addr)
+{
+    PIN_LockClient(); //also called from callbacks like `MarkEarlyExit`
+    IMG imgi = IMG_FindByAddress(addr);
+    if (!IMG_Valid(imgi)) { PIN_UnlockClient(); return FALSE; }
+    std::map<UINT32, RangeList>::iterator it = RangeByImg.find(IMG_Id(imgi));
+    if (it == RangeByImg.end()) {
+        it = RangeByImg.insert(std::make_pair(IMG_Id(imgi), RangeList())).first;
+        RangeResolve(imgi, it->second);
+    }
+    const RangeList &lst = it->second;
+    RangeList::const_iterator pos = std::upper_bound(lst.begin(), lst.end(),
+        std::make_pair(addr, (ADDRINT) -1));
+    const BOOL inside = pos != lst.begin() && addr < (pos - 1)->second;
+    PIN_UnlockClient();
+    return inside;
+}
+
+/**
+ * Image unload callback. An image loaded again later
+ * may get another ID and another load offset.
+ * @param Iparam Image Object
+ * @param Vparam from default signature & unused
+ */
+VOID RangeImgUnload(IMG Iparam, VOID *Vparam)
+{
+    RangeByImg.erase(IMG_Id(Iparam));
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef HEAD_RANGE_H
+#define HEAD_RANGE_H
+
+#include "pin.H"
+#include <string>
+
+INT32 RangeLoad(const std::string &path);
+BOOL  RangeHas(ADDRINT addr);
+VOID  RangeImgUnload(IMG Iparam, VOID *Vparam);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include "ring.h"
+#include "amsg.h"
+#include "cli.h"
+#include "budget.h"
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Shared-memory transport for `-TrDatPath shm:<name>`.
+ * The segment lives in `SHM_DIR` (i.e. what `shm_open` uses on Linux)
+ * and its layout is described in `shmring.h`.
+ */
+
+// Private state of the producer of a ring.
+// `head` and `tail` are local copies, so the shared `tail`
+// is only read again when the ring looks full.
+struct alignas(64) RingProd
+{
+    RingCtl* ctl;
+    RingRec* slot;
+    UINT64   head;
+    UINT64   tail;
+};
+
+static RingHead* RingBase = 0;
+static UINT64    RingSize = 0;
+static RingProd  Prod[SHM_MAX_RING];
+static UINT64    RingMask = 0;
+static UINT32    RingFull = SHM_FULL_BLOCK;
+
+// Set once a blocked producer gave up on the consumer,
+// so full rings drop records from then on.
+static std::atomic<bool> RingStalled(false);
+
+// Yields on a full ring before sleeping 1ms at a time
+#define RING_SPIN ((UINT32) 1000)
+
+// Symbol IDs given so far. Only touched at instrumentation
+// time, when Pin holds its internal lock.
+static std::unordered_map<std::string, UINT32> SymIds;
+
+/**
+ * Create the shared-memory segment and map it
+ * @param name name of the segment, without '/'
+ * @param n_slot records per ring, must be a power of 2
+ * @param policy `SHM_FULL_BLOCK` or `SHM_FULL_DROP`
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for any failure
+ */
+INT32 RingOpen(const std::string &name, UINT32 n_slot, UINT32 policy)
+{
+    if (0 == name.size() || std::string::npos != name.find('/')) { return EVIL_ARG; }
+
+    UINT64 off_ctl = sizeof(RingHead);
+    off_ctl = (off_ctl + 63) & ~((UINT64) 63);
+    UINT64 off_sym = off_ctl + SHM_MAX_RING * sizeof(RingCtl);
+    UINT64 off_rec = off_sym + SHM_SYM_CAP;
+    UINT64 total   = off_rec + (UINT64) SHM_MAX_RING * n_slot * sizeof(RingRec);
+
+    //a segment left by an earlier run may be mapped by a consumer,
+    //so it is replaced by a new file rather than truncated under it
+    std::string path = std::string(SHM_DIR) + name;
+    unlink(path.c_str());
+    int fd = open(path.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0600);
+    if (fd < 0) { return EVIL_ARG; }
+    if (0 != ftruncate(fd, total)) { close(fd); return EVIL_ARG; }
+    VOID* mem = mmap(0, total, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mem) { return EVIL_ARG; }
+    RingSize = total;
+
+    //a fresh file is all zero, so atomics need no construction
+    RingBase = static_cast<RingHead*>(mem);
+    RingBase->version = SHM_VERSION;
+    RingBase->n_ring  = SHM_MAX_RING;
+    RingBase->n_slot  = n_slot;
+    RingBase->policy  = policy;
+    RingBase->pid     = static_cast<uint32_t>(PIN_GetPid());
+    RingBase->sym_cap = SHM_SYM_CAP;
+    RingBase->off_ctl = off_ctl;
+    RingBase->off_sym = off_sym;
+    RingBase->off_rec = off_rec;
+
+    RingCtl* ctl = reinterpret_cast<RingCtl*>(static_cast<char*>(mem) + off_ctl);
+    RingRec* rec = reinterpret_cast<RingRec*>(static_cast<char*>(mem) + off_rec);
+    for (UINT32 i = 0; i < SHM_MAX_RING; ++i) {
+        Prod[i].ctl  = ctl + i;
+        Prod[i].slot = rec + (UINT64) i * n_slot;
+        Prod[i].head = 0;
+        Prod[i].tail = 0;
+    }
+    RingMask = n_slot - 1;
+    RingFull = policy;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(RingBase->magic, SHM_MAGIC, sizeof(RingBase->magic));
+    return GOOD_ARG;
+}
+
+/**
+ * Append a symbol string to the arena and publish it to consumers.
+ * The caller has checked that it fits.
+ * @param id ID of the symbol
+ * @param sym the symbol string
+ * @param used bytes of the arena used so far
+ * @param need bytes the entry takes
+ */
+static VOID RingSymPut(UINT32 id, const std::string &sym, UINT64 used, UINT64 need)
+{
+    char* arena = reinterpret_cast<char*>(RingBase) + RingBase->off_sym;
+    RingSym* ent = reinterpret_cast<RingSym*>(arena + used);
+    ent->id  = id;
+    ent->len = static_cast<UINT32>(sym.size());
+    memcpy(ent + 1, sym.data(), sym.size());
+    RingBase->sym_len.store(used + need, std::memory_order_release);
+}
+
+/**
+ * Get the ID of a symbol string. A new string is appended
+ * to the arena and published to consumers immediately.
+ * @param sym the symbol string
+ * @return ID of the symbol, or 0 if the arena is full
+ */
+UINT32 RingSymId(const std::string &sym)
+{
+    std::unordered_map<std::string, UINT32>::iterator it = SymIds.find(sym);
+    if (it != SymIds.end()) { return it->second; }
+
+    UINT64 used = RingBase->sym_len.load(std::memory_order_relaxed);
+    UINT64 need = SHM_SYM_ALIGN(sizeof(RingSym) + sym.size());
+    if (used + need > RingBase->sym_cap) { SymIds[sym] = 0; return 0; }
+
+    UINT32 id = static_cast<UINT32>(SymIds.size()) + 1;
+    RingSymPut(id, sym, used, need);
+    SymIds[sym] = id;
+    return id;
+}
+
+/**
+ * Mark the segment closed, so consumers stop after draining
+ */
+VOID RingClose()
+{
+    if (RingBase) { RingBase->closed.store(1, std::memory_order_release); }
+}
+
+/**
+ * Start a segment of its own in a forked child, with the same
+ * settings. Symbol IDs are already baked into the instrumented
+ * code, so every symbol is published again under its old ID.
+ * @param name name of the new segment, without '/'
+ * @return `GOOD_ARG` for success or `EVIL_ARG` for any failure
+ */
+INT32 RingFork(const std::string &name)
+{
+    const UINT32 n_slot = RingBase->n_slot;
+    const UINT32 policy = RingBase->policy;
+    munmap(RingBase, RingSize);
+    RingBase = 0;
+    if (EVIL_ARG == RingOpen(name, n_slot, policy)) { return EVIL_ARG; }
+
+    std::vector<const std::string*> byid(SymIds.size() + 1, 0);
+    for (std::unordered_map<std::string, UINT32>::iterator it = SymIds.begin(); it != SymIds.end(); ++it)
+        { if (it->second) { byid[it->second] = &it->first; } }
+    for (UINT32 id = 1; id < byid.size(); ++id) {
+        if (!byid[id]) { continue; }
+        const UINT64 used = RingBase->sym_len.load(std::memory_order_relaxed);
+        RingSymPut(id, *byid[id], used, SHM_SYM_ALIGN(sizeof(RingSym) + byid[id]->size()));
+    }
+    return GOOD_ARG;
+}
+
+/**
+ * Thread start callback. Pin reuses thread IDs, so the producer
+ * state is picked up from what the ring already holds.
+ * @param tid Pin thread ID, also the index of the ring
+ * @param ctxt from default signature & unused
+ * @param flags from default signature & unused
+ * @param v from default signature & unused
+ */
+VOID RingThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    if (tid >= SHM_MAX_RING) {
+        std::cout << "[!] No ring left for thread " << tid << std::endl;
+        return;
+    }
+    RingProd &p = Prod[tid];
+    p.ctl->tid  = tid;
+    p.head = p.ctl->head.load(std::memory_order_relaxed);
+    p.tail = p.ctl->tail.load(std::memory_order_acquire);
+    p.ctl->used.store(1, std::memory_order_release);
+}
+
+/**
+ * Give up waiting for the consumer, which freed no slot for `SHM_BLOCK_MS`
+ * @param tid Pin thread ID
+ */
+static VOID RingStall(THREADID tid)
+{
+    if (RingStalled.exchange(true)) { return; }
+    std::cout << "[!] Ring " << tid << " was not drained for " << SHM_BLOCK_MS
+              << "ms, dropping records of full rings from now on" << std::endl;
+}
+
+/**
+ * Analyse Routine for pushing a record into the ring of current thread.
+ * When the ring is full, it either waits for the consumer or drops
+ * the record according to `-TrShmFull`. A wait without any progress
+ * of the consumer ends after `SHM_BLOCK_MS`, see `RingStall`.
+ * @tparam BUDGET whether `-TrMaxEvents` / `-TrMaxBytes` is set
+ * @tparam DROP whether `-TrShmFull` is 'drop'
+ * @param tid Pin thread ID
+ * @param addr memory address
+ * @param sym ID of the symbol string, 0 for none
+ */
+template<BOOL BUDGET, BOOL DROP>
+static VOID PIN_FAST_ANALYSIS_CALL RingPushAt(THREADID tid, ADDRINT addr, UINT32 sym)
+{
+    if (BUDGET && TrStop.load(std::memory_order_relaxed)) { return; }
+    if (tid >= SHM_MAX_RING) {
+        RingBase->lost.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    RingProd &p = Prod[tid];
+    if (p.head - p.tail > RingMask) {
+        p.tail = p.ctl->tail.load(std::memory_order_acquire);
+        for (UINT32 spin = 0; p.head - p.tail > RingMask; ++spin) {
+            if (DROP || RingStalled.load(std::memory_order_relaxed)) {
+                p.ctl->drops.store(p.ctl->drops.load(std::memory_order_relaxed) + 1,
+                                   std::memory_order_relaxed);
+                return;
+            }
+            if (spin < RING_SPIN) { PIN_Yield(); }
+            else if (spin < RING_SPIN + SHM_BLOCK_MS) { PIN_Sleep(1); }
+            else { RingStall(tid); continue; }
+            const UINT64 seen = p.tail;
+            p.tail = p.ctl->tail.load(std::memory_order_acquire);
+            if (p.tail != seen) { spin = 0; }
+        }
+    }
+    RingRec &r = p.slot[p.head & RingMask];
+    r.addr = addr;
+    r.tid  = tid;
+    r.sym  = sym;
+    p.ctl->head.store(++p.head, std::memory_order_release);
+    if (BUDGET && 0 == (p.head & (BUDGET_BATCH - 1)))
+        { BudgetCharge(tid, BUDGET_BATCH, BUDGET_BATCH * sizeof(RingRec)); }
+}
+
+/**
+ * Get the analyse routine for pushing a record.
+ * Must be called after `RingOpen`.
+ * @param budget whether `-TrMaxEvents` / `-TrMaxBytes` is set
+ * @return the instance of `RingPushAt` to insert
+ */
+AFUNPTR RingPushFn(BOOL budget)
+{
+    if (SHM_FULL_DROP == RingFull)
+        { return budget ? AFUNPTR((RingPushAt<TRUE, TRUE>)) : AFUNPTR((RingPushAt<FALSE, TRUE>)); }
+    return budget ? AFUNPTR((RingPushAt<TRUE, FALSE>)) : AFUNPTR((RingPushAt<FALSE, FALSE>));
+}
+
+/**
+ * Push a record from outside the hot path, like a marker
+ * @param tid Pin thread ID
+ * @param addr memory address
+ * @param sym ID of the symbol string, or a `SHM_SYM_*` marker
+ */
+VOID RingPush(THREADID tid, ADDRINT addr, UINT32 sym)
+{
+    if (SHM_FULL_DROP == RingFull) {
+        if (TrBudget) { RingPushAt<TRUE, TRUE>(tid, addr, sym); }
+        else { RingPushAt<FALSE, TRUE>(tid, addr, sym); }
+    } else {
+        if (TrBudget) { RingPushAt<TRUE, FALSE>(tid, addr, sym); }
+        else { RingPushAt<FALSE, FALSE>(tid, addr, sym); }
+    }
+}
+
+/**
+ * Push a truncation marker into the ring of current thread.
+ * The marker is a record whose symbol ID is `SHM_SYM_TRUNC`
+ * and whose address is the number of records so far.
+ * It never drops, but gives up if the consumer is not there.
+ * @param tid Pin thread ID
+ * @param events number of records so far
+ */
+VOID RingMark(THREADID tid, UINT64 events)
+{
+    if (tid >= SHM_MAX_RING) { return; }
+    RingProd &p = Prod[tid];
+    for (UINT32 i = 0; p.head - p.ctl->tail.load(std::memory_order_acquire) > RingMask; ++i) {
+        if (i >= 1000) { return; }
+        PIN_Sleep(1);
+    }
+    RingRec &r = p.slot[p.head & RingMask];
+    r.addr = events;
+    r.tid  = tid;
+    r.sym  = SHM_SYM_TRUNC;
+    p.ctl->head.store(++p.head, std::memory_order_release);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef HEAD_RING_H
+#define HEAD_RING_H
+
+#include "pin.H"
+#include "shmring.h"
+#include <string>
+
+INT32  RingOpen(const std::string &name, UINT32 n_slot, UINT32 policy);
+UINT32 RingSymId(const std::string &sym);
+VOID   RingClose();
+INT32  RingFork(const std::string &name);
+VOID   RingMark(THREADID tid, UINT64 events);
+
+VOID RingThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v);
+VOID RingPush(THREADID tid, ADDRINT addr, UINT32 sym);
+AFUNPTR RingPushFn(BOOL budget);
+
+#endif
\ No newline at end of file
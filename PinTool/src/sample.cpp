@@ -0,0 +1,189 @@
+#include "sample.h"
+#include "checker.h"
+#include "ctl.h"
+#include <iostream>
+#include <map>
+#include <vector>
+
+/**
+ * Statistical profiler for `-TrScaType samp`.
+ * Nothing is instrumented. An internal thread wakes up every
+ * `-TrSampMs`, stops all application threads, and takes the IP of
+ * each plus the return addresses found by walking the frame pointer
+ * chain. Stacks are counted as raw addresses and only symbolized by
+ * `SampSave` at fini, so a sample costs a stop and a few reads.
+ * Frames of code built without frame pointers are missed, so
+ * stacks may be shallower than they are.
+ */
+
+typedef std::vector<ADDRINT> SampStack; //from the leaf
+
+static std::map<SampStack, UINT64> SampCount;
+static PIN_LOCK       SampLock; //guards `SampCount` and `SampQuit`
+static BOOL           SampQuit = FALSE;
+static UINT32         SampMs = 10;
+static UINT32         SampDepth = 32;
+static PIN_THREAD_UID SampUid;
+static BOOL           SampRunning = FALSE;
+
+/**
+ * Set the period and the depth of stacks
+ * @param period_ms milliseconds between samples
+ * @param depth max number of frames per stack, the leaf included
+ */
+VOID SampInit(UINT32 period_ms, UINT32 depth)
+{
+    PIN_InitLock(&SampLock);
+    SampMs = period_ms;
+    SampDepth = depth;
+}
+
+/**
+ * Walk the stack of a stopped thread by its frame pointers.
+ * A frame is "<saved frame pointer>, <return address>", and the
+ * saved one must be above the current one, or the walk stops.
+ */
+static VOID SampWalk(const CONTEXT *ctxt, SampStack &st)
+{
+    st.clear();
+    st.push_back(PIN_GetContextReg(ctxt, REG_INST_PTR));
+    ADDRINT fp = PIN_GetContextReg(ctxt, REG_GBP);
+    while (fp && st.size() < SampDepth) {
+        ADDRINT frame[2];
+        if (sizeof(frame) != PIN_SafeCopy(frame, reinterpret_cast<VOID*>(fp), sizeof(frame))) { break; }
+        if (!frame[1]) { break; }
+        st.push_back(frame[1] - 1); //inside the call, not after it
+        if (frame[0] <= fp) { break; }
+        fp = frame[0];
+    }
+}
+
+/**
+ * The internal thread taking samples, until the process exits
+ * @param arg from default signature & unused
+ */
+static VOID SampThread(VOID *arg)
+{
+    const THREADID self = PIN_ThreadId();
+    SampStack st;
+    while (!PIN_IsProcessExiting()) {
+        PIN_Sleep(SampMs);
+        if (!TrOn.load(std::memory_order_relaxed)) { continue; }
+        if (!PIN_StopApplicationThreads(self)) { continue; }
+        PIN_GetLock(&SampLock, self + 1);
+        const BOOL quit = SampQuit;
+        for (UINT32 i = 0; i < PIN_GetStoppedThreadCount() && !quit; ++i) {
+            const CONTEXT *ctxt = PIN_GetStoppedThreadContext(PIN_GetStoppedThreadId(i));
+            if (!ctxt) { continue; }
+            SampWalk(ctxt, st);
+            ++SampCount[st];
+        }
+        PIN_ReleaseLock(&SampLock);
+        PIN_ResumeApplicationThreads(self);
+        if (quit) { return; }
+    }
+}
+
+/**
+ * Spawn the sampling thread. Must be called before `PIN_StartProgram`.
+ */
+VOID SampStart()
+{
+    SampRunning = (INVALID_THREADID != PIN_SpawnInternalThread(SampThread, 0, 0, &SampUid));
+    if (!SampRunning) { std::cout << "[!] Failed to start the sampling thread" << std::endl; }
+}
+
+/**
+ * Prepare-for-fini callback, which waits for the sampling thread
+ * @param V from default signature & unused
+ */
+VOID SampPrepareFini(VOID *V)
+{
+    if (SampRunning) { PIN_WaitForThreadTermination(SampUid, PIN_INFINITE_TIMEOUT, 0); }
+    SampRunning = FALSE;
+}
+
+/**
+ * Forget the samples of the parent in a forked child.
+ * The sampling thread does not live on in the child, so a
+ * forked child writes an empty profile.
+ */
+VOID SampFork()
+{
+    PIN_InitLock(&SampLock);
+    SampCount.clear();
+    SampRunning = FALSE;
+}
+
+/**
+ * Name of the routine holding an address, as `DumpSymInfo` gives
+ * for routines, or "[<image>]" for code without a routine.
+ * Characters meaning something in folded stacks are replaced.
+ */
+static std::string SampName(ADDRINT addr)
+{
+    std::string s;
+    PIN_LockClient();
+    RTN rtni = RTN_FindByAddress(addr);
+    if (RTN_Valid(rtni)) { DumpSymInfo(s, rtni); }
+    else {
+        IMG imgi = IMG_FindByAddress(addr);
+        if (IMG_Valid(imgi)) {
+            const std::string name = IMG_Name(imgi);
+            s = "[" + name.substr(name.rfind('/') + 1) + "]";
+        }
+    }
+    PIN_UnlockClient();
+    if (s.empty()) { s = "[unknown]"; }
+    return FoldName(s);
+}
+
+/**
+ * Symbolize the stacks and write the results. No more samples are
+ * taken after it, so it also serves a detach with the thread alive.
+ * @param folded receives one line per stack, like
+ *        "main;foo;bar <samples>", which flame graph tools take
+ * @param summary receives "routine,self,total" CSV rows of samples,
+ *        or `NULL` to skip. Recursive frames count once in total.
+ * @return whether the outputs are fully written
+ */
+BOOL SampSave(std::ostream &folded, std::ostream *summary)
+{
+    PIN_GetLock(&SampLock, PIN_ThreadId() + 1);
+    SampQuit = TRUE;
+    std::map<ADDRINT, std::string> names;
+    std::map<std::string, UINT64> paths, self, total;
+    for (std::map<SampStack, UINT64>::const_iterator it = SampCount.begin(); it != SampCount.end(); ++it) {
+        const SampStack &st = it->first;
+        std::vector<const std::string*> frames;
+        for (size_t i = 0; i < st.size(); ++i) {
+            std::map<ADDRINT, std::string>::iterator nt = names.find(st[i]);
+            if (nt == names.end()) { nt = names.insert(std::make_pair(st[i], SampName(st[i]))).first; }
+            frames.push_back(&nt->second);
+        }
+        std::string path;
+        for (size_t i = frames.size(); i-- > 0; ) {
+            if (path.size()) { path += ";"; }
+            path += *frames[i];
+            BOOL seen = FALSE;
+            for (size_t j = i + 1; j < frames.size() && !seen; ++j) { seen = (*frames[j] == *frames[i]); }
+            if (!seen) { total[*frames[i]] += it->second; }
+        }
+        paths[path] += it->second;
+        self[*frames[0]] += it->second;
+    }
+    SampCount.clear();
+    PIN_ReleaseLock(&SampLock);
+
+    for (std::map<std::string, UINT64>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+        { folded << it->first << " " << it->second << "\n"; }
+    folded.flush();
+    if (!summary) { return folded.good(); }
+
+    *summary << "routine,self,total\n";
+    for (std::map<std::string, UINT64>::const_iterator it = total.begin(); it != total.end(); ++it) {
+        *summary << CsvQuote(it->first) << "," << self[it->first] << "," << it->second << "\n";
+    }
+    summary->flush();
+    return folded.good() && summary->good();
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef HEAD_SAMPLE_H
+#define HEAD_SAMPLE_H
+
+#include "pin.H"
+#include <ostream>
+
+VOID SampInit(UINT32 period_ms, UINT32 depth);
+VOID SampStart();
+VOID SampPrepareFini(VOID *V);
+VOID SampFork();
+BOOL SampSave(std::ostream &folded, std::ostream *summary);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef HEAD_SHMRING_H
+#define HEAD_SHMRING_H
+
+// Layout of the shared-memory ring used by `-TrDatPath shm:<name>`.
+// This header does not depend on Pin, so consumers (see `TraceTools`)
+// include the very same file.
+//
+// | RingHead | RingCtl[n_ring] | symbol arena (sym_cap bytes) | RingRec[n_ring][n_slot] |
+//
+// Each application thread owns one ring and is its only producer.
+// A ring is a classic SPSC queue: `head` and `tail` count records
+// ever written and read, the producer publishes `head` with a release
+// store and the consumer publishes `tail` the same way.
+//
+// Symbol strings are appended to the arena at instrumentation time as
+// `RingSym` entries (8-byte aligned), and `sym_len` is published after
+// each of them. A record refers to a symbol by its ID, 0 means none.
+//
+// `closed` is only set at fini, so a consumer also stops once the
+// process `pid` is gone (e.g. killed on a timeout). For the same
+// reason a consumer waits for a new producer rather than attach to
+// a segment of a process which is gone, and a producer replaces such
+// a segment with a new file. A producer blocked
+// on a full ring gives up after `SHM_BLOCK_MS` without any progress of
+// the consumer, and drops records from then on.
+
+#include <atomic>
+#include <cstdint>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared rings need lock-free 64-bit atomics");
+
+#define SHM_MAGIC    "TRSHMRG"
+#define SHM_VERSION  ((uint32_t) 2)
+#define SHM_DIR      "/dev/shm/"
+#define SHM_MAX_RING ((uint32_t) 128)
+#define SHM_SYM_CAP  ((uint64_t) 16 << 20)
+
+#define SHM_FULL_BLOCK ((uint32_t) 0) //producer waits for free slots
+#define SHM_FULL_DROP  ((uint32_t) 1) //producer drops and counts records
+#define SHM_BLOCK_MS   ((uint32_t) 5000) //a blocked producer waits this long at most
+
+struct RingHead
+{
+    char     magic[8];   //written at last, so a valid magic means ready
+    uint32_t version;
+    uint32_t n_ring;
+    uint32_t n_slot;     //records per ring, a power of 2
+    uint32_t policy;     //`SHM_FULL_BLOCK` or `SHM_FULL_DROP`
+    uint32_t pid;        //of the producer process
+    uint32_t reserved;
+    uint64_t sym_cap;
+    uint64_t off_ctl;
+    uint64_t off_sym;
+    uint64_t off_rec;
+    std::atomic<uint64_t> sym_len;
+    std::atomic<uint32_t> closed; //set by the producer at fini
+    std::atomic<uint64_t> lost;   //records from threads beyond `n_ring`
+};
+
+struct alignas(64) RingCtl
+{
+    alignas(64) std::atomic<uint64_t> head;  //only written by the producer
+    alignas(64) std::atomic<uint64_t> tail;  //only written by the consumer
+    alignas(64) std::atomic<uint64_t> drops; //only written by the producer
+    std::atomic<uint32_t> used;              //the ring has a producer thread
+    uint32_t              tid;
+};
+
+struct RingRec
+{
+    uint64_t addr;
+    uint32_t tid;
+    uint32_t sym;
+};
+
+// A record with this symbol ID marks that TracerCore stopped
+// early on its budget. Its `addr` is the number of records.
+#define SHM_SYM_TRUNC ((uint32_t) -1)
+
+// A record with this symbol ID marks that the last block of its thread
+// was left early, right before the instruction at its `addr`.
+#define SHM_SYM_EXIT ((uint32_t) -2)
+
+struct RingSym
+{
+    uint32_t id;
+    uint32_t len; //followed by `len` chars without '\0'
+};
+
+#define SHM_SYM_ALIGN(n) (((n) + 7) & ~((uint64_t) 7))
+
+#endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+#ifndef HEAD_TRCHUNK_H
+#define HEAD_TRCHUNK_H
+
+// Layout of the chunked trace container written by `-TrDatPath chunk:<path>`.
+// This header does not depend on Pin, so readers (see `TraceTools`)
+// include the very same file.
+//
+// | ChkFile | ChkHead + payload | ChkHead + payload | ... | ChkIndex[n_chunk] | ChkFoot |
+//
+// Each chunk holds records of one thread only and decodes on its own:
+// the payload is the LEB128 of zigzag deltas between addresses, the
+// first one from 0. `first_seq` counts records of the same thread
+// before this chunk, so a record is located by (thread, sequence).
+// The index and the footer are written at last. Without them (e.g. the
+// target was killed) chunks can still be found by scanning from the
+// start, where the CRC of each payload tells intact chunks.
+
+#include <cstddef>
+#include <cstdint>
+
+#define CHK_MAGIC      "TRCHUNK"
+#define CHK_HEAD_MAGIC ((uint32_t) 0x4b434854) //"THCK"
+#define CHK_FOOT_MAGIC "TRCKIDX"
+#define CHK_VERSION    ((uint32_t) 1)
+
+#define CHK_MAX_EVENTS ((uint32_t) 65536) //records per chunk at most
+#define CHK_MAX_BYTES  ((uint32_t) CHK_MAX_EVENTS * 10)
+
+#define CHK_FLAG_TRUNC ((uint32_t) 1) //stopped early on the budget
+
+struct ChkFile
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct ChkHead
+{
+    uint32_t magic;
+    uint32_t tid;
+    uint64_t first_seq;
+    uint32_t count;     //number of records
+    uint32_t bytes;     //size of payload
+    uint32_t crc;       //CRC-32 of payload
+    uint32_t reserved;
+};
+
+struct ChkIndex
+{
+    uint64_t offset;    //where the `ChkHead` is
+    uint64_t first_seq;
+    uint32_t tid;
+    uint32_t count;
+};
+
+struct ChkFoot
+{
+    uint64_t n_chunk;
+    uint64_t off_index;
+    uint32_t flags;
+    uint32_t reserved;
+    char     magic[8];  //at the very end of the file
+};
+
+// Lookup table of CRC-32 (IEEE), built once
+struct ChkCrcTable
+{
+    uint32_t t[256];
+    ChkCrcTable(){
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) { c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+            t[i] = c;
+        }
+    }
+};
+
+/**
+ * CRC-32 (IEEE) of a buffer
+ * @param p the buffer
+ * @param n size of the buffer
+ * @return the checksum
+ */
+static inline uint32_t ChkCrc(const unsigned char* p, size_t n)
+{
+    static const ChkCrcTable tab;
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; ++i) { c = tab.t[(c ^ p[i]) & 0xFF] ^ (c >> 8); }
+    return c ^ 0xFFFFFFFFu;
+}
+
+/**
+ * Encode records into a payload
+ * @param addrs records
+ * @param n number of records, no more than `CHK_MAX_EVENTS`
+ * @param out receives the payload, at least `CHK_MAX_BYTES` bytes
+ * @return size of the payload
+ */
+static inline uint32_t ChkEncode(const uint64_t* addrs, uint32_t n, unsigned char* out)
+{
+    unsigned char* p = out;
+    uint64_t prev = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const int64_t d = static_cast<int64_t>(addrs[i] - prev);
+        uint64_t z = (static_cast<uint64_t>(d) << 1) ^ static_cast<uint64_t>(d >> 63);
+        prev = addrs[i];
+        while (z >= 0x80) { *p++ = static_cast<unsigned char>(z | 0x80); z >>= 7; }
+        *p++ = static_cast<unsigned char>(z);
+    }
+    return static_cast<uint32_t>(p - out);
+}
+
+/**
+ * Decode a payload
+ * @param p payload
+ * @param bytes size of payload
+ * @param n number of records expected
+ * @param addrs receives `n` records
+ * @return false for a malformed payload
+ */
+static inline bool ChkDecode(const unsigned char* p, uint32_t bytes, uint32_t n, uint64_t* addrs)
+{
+    const unsigned char* end = p + bytes;
+    uint64_t prev = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t z = 0;
+        for (int shift = 0; ; shift += 7) {
+            if (p >= end || shift > 63) { return false; }
+            const unsigned char b = *p++;
+            z |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) { break; }
+        }
+        prev += (z >> 1) ^ (~(z & 1) + 1);
+        addrs[i] = prev;
+    }
+    return p == end;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef HEAD_TRMAP_H
+#define HEAD_TRMAP_H
+
+// Layout of a trace file written by `-TrDatPath map:<path>`.
+// This header does not depend on Pin, so readers (see `TraceTools`)
+// include the very same file.
+//
+// | MapHead | records, the same text as a plain TrDat | zeros up to the extent |
+//
+// The file is mapped `MAP_SHARED` and grown by `MAP_EXTENT` at a time,
+// so records are copied into memory without a syscall. `committed` is
+// stored with release order after each record is complete, and the
+// kernel keeps the pages of a process killed by any signal, so records
+// before `committed` are intact however the target ends. On a clean
+// close the file is cut right after them and `MAP_FLAG_CLOSED` is set.
+// Each extent is reserved on disk before it is mapped, so a full disk
+// stops the trace with `MAP_FLAG_FULL` instead of a `SIGBUS`.
+
+#include <cstddef>
+#include <cstdint>
+
+#define MAP_MAGIC   "TRMAPPD"
+#define MAP_VERSION ((uint32_t) 1)
+#define MAP_EXTENT  ((uint64_t) 64 << 20) //bytes the file grows by at a time
+
+#define MAP_FLAG_CLOSED ((uint32_t) 1) //closed cleanly
+#define MAP_FLAG_TRUNC  ((uint32_t) 2) //stopped early on the budget
+#define MAP_FLAG_FULL   ((uint32_t) 4) //stopped early, failed to grow (e.g. a full disk)
+
+struct MapHead
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t committed; //bytes of records right after the header
+    uint64_t reserved[5];
+};
+
+/**
+ * Bytes of complete records in a mapped trace
+ * @param head header of the file, mapped
+ * @param fsize size of the whole file
+ */
+inline uint64_t MapCommitted(const MapHead* head, uint64_t fsize){
+    const uint64_t n = __atomic_load_n(&head->committed, __ATOMIC_ACQUIRE);
+    const uint64_t room = fsize - sizeof(MapHead);
+    return n < room ? n : room;
+}
+
+#endif
\ No newline at end of file
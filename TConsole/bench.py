@@ -0,0 +1,219 @@
+""" End-to-end throughput benchmark of TConsole
+
+Runs the whole pipeline (`CoreLauncher` -> `TracerCoreRunner` ->
+`ParallelWorker` -> pin -> trace files) over a synthetic corpus of
+examples/microBug, for each pair of granularity and worker count:
+
+    python3 -m TConsole.bench --sca cal,bbl --workers 1,2,4 --out bench.jsonl
+
+Results are JSON lines with sorted keys. The first line (`"kind": "meta"`)
+describes the machine and the corpus. Each following line (`"kind": "run"`)
+is one run with inputs/sec, p50/p99 job latency, bytes written and CPU
+utilization, so two files can be compared line by line.
+"""
+import os
+import sys
+import json
+import time
+import random
+import shutil
+import socket
+import typing
+import argparse
+import platform
+import resource
+import tempfile
+
+from .tracer.entrance import CoreLauncher
+from .utility.log import GIVE_MY_LOGGER
+from .utility.checker import check_where_this_script_is
+
+BENCH_SCHEMA = 1
+SCA_NAMES = ["cal", "bbl", "ins", "cg", "prof", "samp", "cnt", "gram"] #index is `target_sca`
+
+DEFAULT_TARGET = os.path.join(check_where_this_script_is(__file__),
+    "..", "examples", "microBug", "build", "bug-san0-dbg0-64")
+
+def MakeCorpus(dir_src :str, num :int, seed :int, mix :typing.List[int]) -> None:
+    """ Write `num` inputs for microBug into `dir_src`
+
+    Each input is a wLength read from stdin, drawn from 3 classes
+    by the weights in `mix`: 'flat' returns at once, 'loop' runs
+    99~127 rounds of calls (longer traces, still in bounds), and
+    'wiki' walks into `hit_wiki` but misses all its bugs.
+    """
+    rng = random.Random(seed)
+    def flat():
+        return rng.choice([rng.randint(1, 65), rng.randint(667, 9999)])
+    def loop():
+        return rng.randint(99, 127)
+    def wiki():
+        while True:
+            v = rng.randint(10000, 90000)
+            if not ((v // 10000 == v // 1000 % 10) and (200 <= v % 1000 <= 800)):
+                return v
+    gens = [flat, loop, wiki]
+    os.makedirs(dir_src, exist_ok=True)
+    width = len(str(num))
+    for i in range(num):
+        v = rng.choices(gens, weights=mix)[0]()
+        with open(os.path.join(dir_src, "in%s"%str(i).zfill(width)),
+                mode="w", encoding="utf-8") as f:
+            f.write("%d\n"%v)
+
+def DirBytes(dpath :typing.Optional[str]) -> int:
+    """ Total size of the files under a directory, 0 for `None`
+    """
+    if (dpath is None):
+        return 0
+    total = 0
+    for root, dirs, files in os.walk(dpath):
+        for name in files:
+            total += os.path.getsize(os.path.join(root, name))
+    return total
+
+def Percentile(vals :typing.List[float], pct :float) -> typing.Optional[float]:
+    """ Nearest-rank percentile, `None` for no values
+    """
+    if (0 == len(vals)):
+        return None
+    s = sorted(vals)
+    rank = max(1, -(-len(s) * pct // 100))
+    return round(s[int(rank) - 1], 6)
+
+def ChildCpu() -> float:
+    """ CPU seconds used by all waited children so far
+    """
+    ru = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return ru.ru_utime + ru.ru_stime
+
+def RunOnce(dir_src :str, dir_run :str, sca :int, workers :int,
+    target :str, save_sym :bool, timeout :typing.Optional[int]
+) -> typing.Dict[str,typing.Any]:
+    """ Trace the corpus once and measure it
+    """
+    dir_dat = os.path.join(dir_run, "dat")
+    dir_sym = os.path.join(dir_run, "sym") if save_sym else None
+    os.makedirs(dir_dat)
+    if (dir_sym is not None):
+        os.makedirs(dir_sym)
+
+    launcher = CoreLauncher(dir_src, dir_dat, dir_sym,
+        target_sca = sca, target_bin = target, target_arg = "0",
+        read_stdin = True, worker_num = workers, worker_chk = 1,
+        worker_tim = timeout, worker_ljf = False)
+    cpu0 = ChildCpu()
+    t0 = time.monotonic()
+    launcher.launch()
+    launcher.landing()
+    wall = time.monotonic() - t0
+    cpu = ChildCpu() - cpu0
+
+    lat = [t for t in launcher.runner.elapse() if (t is not None)]
+    failed = sum(1 for ret in launcher.runner.access() if (ret[0] != 0))
+    n_input = len(launcher.fsrc)
+    del launcher
+    n_cpu = len(os.sched_getaffinity(0))
+    return {
+        "kind"           : "run",
+        "sca"            : SCA_NAMES[sca],
+        "workers"        : workers,
+        "inputs"         : n_input,
+        "failed"         : failed,
+        "wall_sec"       : round(wall, 6),
+        "inputs_per_sec" : round(n_input / wall, 6) if (wall > 0) else None,
+        "p50_sec"        : Percentile(lat, 50),
+        "p99_sec"        : Percentile(lat, 99),
+        "bytes_dat"      : DirBytes(dir_dat),
+        "bytes_sym"      : DirBytes(dir_sym),
+        "cpu_sec"        : round(cpu, 6),
+        "cpu_util"       : round(cpu / (wall * n_cpu), 6) if (wall > 0) else None
+    }
+
+def main(argv :typing.Optional[typing.List[str]] =None) -> int:
+    parser = argparse.ArgumentParser(prog="python3 -m TConsole.bench",
+        description="Measure the throughput of TConsole over a synthetic corpus")
+    parser.add_argument("--target", default=DEFAULT_TARGET,
+        help="microBug binary to trace (see examples/microBug/makefile)")
+    parser.add_argument("--inputs", type=int, default=200,
+        help="number of inputs in the corpus")
+    parser.add_argument("--seed", type=int, default=1,
+        help="seed of the corpus, the same seed gives the same corpus")
+    parser.add_argument("--mix", default="5,3,2",
+        help="weights of 'flat', 'loop' and 'wiki' inputs")
+    parser.add_argument("--sca", default="cal,bbl,ins",
+        help="granularities to sweep, among %s"%(",".join(SCA_NAMES)))
+    parser.add_argument("--workers", default="1,2,4",
+        help="worker counts to sweep")
+    parser.add_argument("--repeat", type=int, default=1,
+        help="runs of each pair of granularity and worker count")
+    parser.add_argument("--timeout", type=int, default=None,
+        help="timeout of each job in seconds")
+    parser.add_argument("--no-sym", action="store_true",
+        help="do not save trace-symbol files")
+    parser.add_argument("--work", default=None,
+        help="where the corpus and traces go, a temporary directory by default")
+    parser.add_argument("--keep", action="store_true",
+        help="keep the corpus and traces after the benchmark")
+    parser.add_argument("--out", default=None,
+        help="where the JSON lines go, stdout by default")
+    args = parser.parse_args(argv)
+
+    blog = GIVE_MY_LOGGER()
+    try:
+        mix = [int(w) for w in args.mix.split(",")]
+        scas = [SCA_NAMES.index(s.strip()) for s in args.sca.split(",")]
+        workers = [int(w) for w in args.workers.split(",")]
+        if (len(mix) != 3) or (min(mix) < 0) or (sum(mix) == 0) or \
+                (min(workers) < 1) or (args.inputs < 1) or (args.repeat < 1):
+            raise ValueError(args)
+    except ValueError:
+        parser.print_usage(sys.stderr)
+        blog.error("Bad --mix, --sca, --workers, --inputs or --repeat")
+        return 2
+
+    work = args.work if (args.work is not None) else tempfile.mkdtemp(prefix="TConsole-bench-")
+    dir_src = os.path.join(work, "src")
+    out = open(args.out, mode="w", encoding="utf-8") if (args.out is not None) else sys.stdout
+    try:
+        MakeCorpus(dir_src, args.inputs, args.seed, mix)
+        meta = {
+            "kind"    : "meta",
+            "schema"  : BENCH_SCHEMA,
+            "time"    : time.strftime("%Y-%m-%dT%H:%M:%S%z", time.localtime()),
+            "host"    : socket.gethostname(),
+            "platform": platform.platform(),
+            "python"  : platform.python_version(),
+            "cpus"    : len(os.sched_getaffinity(0)),
+            "target"  : os.path.abspath(args.target),
+            "inputs"  : args.inputs,
+            "seed"    : args.seed,
+            "mix"     : mix,
+            "sym"     : not args.no_sym
+        }
+        out.write(json.dumps(meta, sort_keys=True) + "\n")
+        out.flush()
+        for sca in scas:
+            for n in workers:
+                for rep in range(args.repeat):
+                    dir_run = os.path.join(work, "run-%s-%d-%d"%(SCA_NAMES[sca], n, rep))
+                    res = RunOnce(dir_src, dir_run, sca, n,
+                                  args.target, not args.no_sym, args.timeout)
+                    res["repeat"] = rep
+                    out.write(json.dumps(res, sort_keys=True) + "\n")
+                    out.flush()
+                    blog.info("Bench %s x%d #%d: %s inputs/sec", SCA_NAMES[sca],
+                              n, rep, res["inputs_per_sec"])
+                    if not args.keep:
+                        shutil.rmtree(dir_run, ignore_errors=True)
+    finally:
+        if (out is not sys.stdout):
+            out.close()
+        if not args.keep:
+            shutil.rmtree(dir_src, ignore_errors=True)
+            if (args.work is None):
+                shutil.rmtree(work, ignore_errors=True)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
\ No newline at end of file
@@ -0,0 +1,297 @@
+""" Discover noise routines and suggest a filter for TracerCore
+
+Runs TracerCore in its counting mode ('cnt') over a sample of inputs,
+ranks the routines by their share of the trace volume left after the
+current `KEYWORD_BLOCKED`, and writes a filter file in the layout of
+`config/filter.yaml` with the top routines appended:
+
+    python3 -m TConsole.noise --src corpus --target ./a.out --arg "_@_FILE_@_" \\
+        --crash asan.txt --out filter.yaml --rank rank.csv
+
+Routines on the path to a crash site must stay in the traces, so no
+keyword is suggested if it would block any routine named by `--crash`
+(sanitizer or gdb backtraces, or bare names) or `--keep`. Keywords match
+as case-insensitive substrings, just like `-TrCutName`.
+"""
+import os
+import re
+import sys
+import csv
+import time
+import random
+import shutil
+import typing
+import argparse
+import tempfile
+
+import yaml
+
+from .tracer.entrance import CoreLauncher, CMD_FILE_PLACEHOLDER
+from .utility.log import GIVE_MY_LOGGER
+from .utility.checker import check_all_file_from_dir
+from .config import CONFIG_FILTER
+
+SCA_CNT = 6 #`target_sca` of 'cnt'
+METRICS = ["calls", "blocks", "instructions"] #columns of 'cnt', for 'cal', 'bbl' and 'ins'
+ALWAYS_KEEP = ["main"]
+
+# "#3 0x4c5e1f in foo /src/a.c:45:9" of sanitizers, or "#1  0x... in foo (...) at a.c:45"
+# and "#0  foo (...) at a.c:45" of gdb
+RE_FRAME = re.compile(r"^\s*#\d+\s+(?:0x[0-9a-fA-F]+\s+in\s+)?([^\s(]+)")
+RE_BARE = re.compile(r"^[\w.$@:<>~]+$")
+
+def ReadCounts(fpath :str) -> typing.Dict[str,typing.List[int]]:
+    """ Read a trace file of 'cnt' into {routine: [calls, blocks, instructions]}
+    """
+    res = {}
+    with open(fpath, mode="r", encoding="utf-8", newline="") as f:
+        rows = csv.reader(f)
+        head = next(rows, None)
+        if (head is None):
+            return res
+        if (head != ["routine"] + METRICS):
+            raise ValueError("Not a trace of 'cnt': %s"%(fpath))
+        for row in rows:
+            if (len(row) != 4):
+                continue
+            res[row[0]] = [int(v) for v in row[1:]]
+    return res
+
+def CrashNames(fpath :str) -> typing.Set[str]:
+    """ Names of the frames in a crash report
+
+    Frames of sanitizer reports and gdb backtraces are taken, and
+    so is any line made of a bare name. Other lines are ignored.
+    """
+    names = set()
+    with open(fpath, mode="r", encoding="utf-8", errors="replace") as f:
+        for L in f:
+            m = RE_FRAME.match(L)
+            name = m.group(1) if m else L.strip()
+            if (m is None) and (RE_BARE.match(name) is None):
+                continue
+            if (len(name) > 0) and (name not in ["??", "<null>"]):
+                names.add(name)
+    return names
+
+def Blocks(keyword :str, names :typing.Iterable[str]) -> typing.List[str]:
+    """ Names which `keyword` would block as a `-TrCutName`
+    """
+    ku = keyword.upper()
+    return sorted(n for n in names if (ku in n.upper()))
+
+def Blocked(name :str, keywords :typing.Iterable[str]) -> bool:
+    """ Whether any of `keywords` blocks `name` as a `-TrCutName`
+    """
+    return any(len(Blocks(k, [name])) > 0 for k in keywords)
+
+def Rank(counts :typing.List[typing.Dict[str,typing.List[int]]], by :str,
+    protect :typing.Set[str], min_share :float, min_inputs :float, min_len :int, max_new :int
+) -> typing.Tuple[typing.List[typing.Dict[str,typing.Any]], int]:
+    """ Rank routines by their share of `by` over all inputs and pick the noise
+
+    A routine is suggested ("new") if it takes at least `min_share` of the
+    volume, shows up in at least `min_inputs` of the inputs (input-specific
+    routines are what traces are for), has a name of at least `min_len`
+    characters, and blocks no name in `protect`. Others get the reason why not.
+    Returns the rows, the most volume first, and the total volume.
+    """
+    col = METRICS.index(by)
+    total = {}
+    seen = {}
+    for one in counts:
+        for name, vals in one.items():
+            acc = total.setdefault(name, [0, 0, 0])
+            for i in range(3):
+                acc[i] += vals[i]
+            if (vals[col] > 0):
+                seen[name] = seen.get(name, 0) + 1
+    volume = sum(v[col] for v in total.values())
+
+    rows = []
+    n_new = 0
+    for name, vals in sorted(total.items(), key=lambda kv: (-kv[1][col], kv[0])):
+        share = vals[col] / volume if (volume > 0) else 0.0
+        spread = seen.get(name, 0) / len(counts) if (len(counts) > 0) else 0.0
+        if (0 == len(name)):
+            status = "unnamed"
+        elif (len(Blocks(name, protect)) > 0):
+            status = "crash"
+        elif (len(name) < min_len):
+            status = "short"
+        elif (share < min_share):
+            status = "small"
+        elif (spread < min_inputs):
+            status = "rare"
+        elif (n_new >= max_new):
+            status = "limit"
+        else:
+            status = "new"
+            n_new += 1
+        rows.append({
+            "routine"      : name,
+            "calls"        : vals[0],
+            "blocks"       : vals[1],
+            "instructions" : vals[2],
+            "share"        : round(share, 6),
+            "inputs"       : seen.get(name, 0),
+            "status"       : status
+        })
+    return rows, volume
+
+def Quote(s :str) -> str:
+    """ Single-quoted YAML scalar, as `config/filter.yaml` writes them
+    """
+    return "'%s'"%(s.replace("'", "''"))
+
+def WriteFilter(fpath :str, old :typing.List[str], rows :typing.List[typing.Dict[str,typing.Any]],
+    by :str, n_input :int, target :str
+) -> int:
+    """ Write a filter file with the kept old keywords and the new ones
+
+    Returns the number of new keywords. Those already covered by an
+    old keyword or an earlier new one are skipped.
+    """
+    new = []
+    for r in rows:
+        if (r["status"] != "new"):
+            continue
+        if Blocked(r["routine"], old + [n for n, _ in new]):
+            continue
+        new.append((r["routine"], r["share"]))
+
+    lines = [
+        "HEAD_TRUNC_NAME: %s"%(Quote(CONFIG_FILTER["HEAD_TRUNC_NAME"])),
+        "TAIL_TRUNC_NAME: %s"%(Quote(CONFIG_FILTER["TAIL_TRUNC_NAME"])),
+        "",
+        "#Suggested by `python3 -m TConsole.noise` at %s"%(time.strftime("%Y-%m-%dT%H:%M:%S%z", time.localtime())),
+        "#from %d inputs of %s."%(n_input, target),
+        "#New keywords come last, each with its share of %s left by the old ones."%(by),
+        "#It is better to sort by frequency to optimize the search",
+        "KEYWORD_BLOCKED:" if (len(old) + len(new) > 0) else "KEYWORD_BLOCKED: []"
+    ]
+    lines += ["    - %s"%(Quote(k)) for k in old]
+    lines += ["    - %s #%.2f%%"%(Quote(k), s * 100) for k, s in new]
+    text = "\n".join(lines) + "\n"
+    if (yaml.safe_load(text)["KEYWORD_BLOCKED"] != old + [k for k, _ in new]):
+        raise RuntimeError("Filter does not read back the same")
+    with open(fpath, mode="w", encoding="utf-8") as f:
+        f.write(text)
+    return len(new)
+
+def main(argv :typing.Optional[typing.List[str]] =None) -> int:
+    parser = argparse.ArgumentParser(prog="python3 -m TConsole.noise",
+        description="Find the routines which fill the traces and suggest a filter without them")
+    parser.add_argument("--src", required=True,
+        help="directory of inputs, as `dir_src` of CoreLauncher")
+    parser.add_argument("--target", required=True,
+        help="target binary")
+    parser.add_argument("--arg", default=CMD_FILE_PLACEHOLDER,
+        help="args of the target, where %s is the input"%(CMD_FILE_PLACEHOLDER))
+    parser.add_argument("--stdin", action="store_true",
+        help="send the input to stdin of the target")
+    parser.add_argument("--ia32", action="store_true",
+        help="load TracerCore of IA-32")
+    parser.add_argument("--sample", type=int, default=50,
+        help="inputs to run, picked at random, 0 for all")
+    parser.add_argument("--seed", type=int, default=1,
+        help="seed of picking the inputs")
+    parser.add_argument("--by", default="blocks", choices=METRICS,
+        help="volume to rank by, as 'cal', 'bbl' or 'ins' would record")
+    parser.add_argument("--crash", action="append", default=[],
+        help="crash report whose frames must not be blocked, may repeat")
+    parser.add_argument("--keep", action="append", default=[],
+        help="routine which must not be blocked, may repeat")
+    parser.add_argument("--min-share", type=float, default=0.01,
+        help="least share of the volume to suggest a routine")
+    parser.add_argument("--min-inputs", type=float, default=0.5,
+        help="least share of the inputs a suggested routine shows up in")
+    parser.add_argument("--min-len", type=int, default=4,
+        help="shortest name to suggest, as a short keyword blocks too much")
+    parser.add_argument("--max-new", type=int, default=32,
+        help="most new keywords to suggest")
+    parser.add_argument("--replace", action="store_true",
+        help="leave out the keywords of the current filter")
+    parser.add_argument("--workers", type=int, default=2,
+        help="number of workers")
+    parser.add_argument("--timeout", type=int, default=None,
+        help="timeout of each job in seconds")
+    parser.add_argument("--work", default=None,
+        help="where the counts go, a temporary directory by default")
+    parser.add_argument("--out", required=True,
+        help="where the suggested filter goes")
+    parser.add_argument("--rank", default=None,
+        help="where the CSV of all routines ranked goes")
+    args = parser.parse_args(argv)
+
+    nlog = GIVE_MY_LOGGER()
+    if (args.sample < 0) or (args.min_len < 1) or (args.max_new < 0) or (args.workers < 1) or \
+            not (0 <= args.min_share <= 1) or not (0 <= args.min_inputs <= 1):
+        parser.print_usage(sys.stderr)
+        nlog.error("Bad --sample, --min-*, --max-new or --workers")
+        return 2
+
+    protect = set(ALWAYS_KEEP) | set(args.keep)
+    for fp in args.crash:
+        try:
+            protect |= CrashNames(fp)
+        except OSError as oe:
+            nlog.error("Bad crash report %s: %s", fp, repr(oe))
+            return 2
+    nlog.info("Keep %d routines on crash paths", len(protect))
+
+    dir_src = os.path.abspath(args.src)
+    fsrc = [os.path.relpath(fp, dir_src) for fp in check_all_file_from_dir(dir_src)]
+    if (0 < args.sample < len(fsrc)):
+        fsrc = sorted(random.Random(args.seed).sample(fsrc, args.sample))
+
+    work = args.work if (args.work is not None) else tempfile.mkdtemp(prefix="TConsole-noise-")
+    dir_dat = os.path.join(work, "dat")
+    slist = os.path.join(work, "inputs.txt")
+    try:
+        os.makedirs(dir_dat, exist_ok=True)
+        with open(slist, mode="w", encoding="utf-8") as f:
+            f.write("".join("%s\n"%(fp) for fp in fsrc))
+        launcher = CoreLauncher(dir_src, dir_dat, None,
+            target_sca = SCA_CNT, target_bin = args.target, target_arg = args.arg,
+            read_stdin = args.stdin, force_ia32 = args.ia32, worker_num = args.workers,
+            worker_tim = args.timeout, src_list = slist)
+        launcher.launch()
+        launcher.landing()
+        fdat = [launcher.fdat_get(fp) for fp in launcher.fsrc]
+        del launcher
+
+        counts = []
+        for fp in fdat:
+            try:
+                counts.append(ReadCounts(fp))
+            except (OSError, ValueError) as e:
+                nlog.warning("Skip counts of %s: %s", fp, repr(e))
+        if (0 == len(counts)):
+            nlog.error("No counts from any input")
+            return 1
+
+        rows, volume = Rank(counts, args.by, protect, args.min_share,
+                            args.min_inputs, args.min_len, args.max_new)
+        if (args.rank is not None):
+            with open(args.rank, mode="w", encoding="utf-8", newline="") as f:
+                w = csv.DictWriter(f, fieldnames=["routine"] + METRICS + ["share", "inputs", "status"])
+                w.writeheader()
+                w.writerows(rows)
+
+        old = [] if args.replace else [F for F in CONFIG_FILTER["KEYWORD_BLOCKED"]
+                                       if isinstance(F, str) and (len(F) > 0)]
+        n_new = WriteFilter(args.out, old, rows, args.by, len(counts), os.path.abspath(args.target))
+        cut = sum(r["share"] for r in rows if (r["status"] == "new"))
+        nlog.info("Suggest %d new keywords in %s, cutting about %.1f%% of %d %s",
+                  n_new, args.out, cut * 100, volume, args.by)
+        for r in rows:
+            if (r["status"] == "crash") and (r["share"] >= args.min_share):
+                nlog.info("Keep %s (%.1f%%) on a crash path", r["routine"], r["share"] * 100)
+    finally:
+        if (args.work is None):
+            shutil.rmtree(work, ignore_errors=True)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
\ No newline at end of file
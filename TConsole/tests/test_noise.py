@@ -0,0 +1,74 @@
+""" Tests of the filter suggested by `TConsole.noise`
+
+    python3 -m unittest discover -s TConsole/tests -t .
+"""
+import os
+import shutil
+import tempfile
+import unittest
+
+import yaml
+
+from .. import noise
+
+def CutName(keywords, name :str) -> bool:
+    """ `IsBlockedName` of TracerCore for the keywords of '-TrCutName'
+    """
+    up = name.upper()
+    return (len(name) > 0) and any(k.upper() in up for k in keywords)
+
+class TestNoise(unittest.TestCase):
+    def setUp(self) -> None:
+        self.work = tempfile.mkdtemp(prefix="TConsole-test-")
+
+    def tearDown(self) -> None:
+        shutil.rmtree(self.work, ignore_errors=True)
+
+    def Write(self, name :str, text :str) -> str:
+        fpath = os.path.join(self.work, name)
+        with open(fpath, mode="w", encoding="utf-8") as f:
+            f.write(text)
+        return fpath
+
+    def Suggest(self, csvs, crash :str ="", old =()):
+        counts = [noise.ReadCounts(self.Write("cnt%d"%i, text)) for i, text in enumerate(csvs)]
+        protect = set(noise.ALWAYS_KEEP)
+        if crash:
+            protect |= noise.CrashNames(self.Write("crash", crash))
+        rows, _ = noise.Rank(counts, "blocks", protect, 0.2, 0.5, 4, 10)
+        fpath = os.path.join(self.work, "filter.yaml")
+        noise.WriteFilter(fpath, list(old), rows, "blocks", len(counts), "a.out")
+        with open(fpath, mode="r", encoding="utf-8") as f:
+            return yaml.safe_load(f)["KEYWORD_BLOCKED"], rows
+
+    def test_keyword_cuts_the_routine(self):
+        cnt = ("routine,calls,blocks,instructions\n"
+               "\"crc32_update\",10,900,9000\n"
+               "\"parse_header\",1,50,500\n"
+               "\"main\",1,50,500\n")
+        keys, _ = self.Suggest([cnt, cnt])
+        self.assertEqual(keys, ["crc32_update"])
+        self.assertTrue(CutName(keys, "crc32_update"))
+        self.assertFalse(CutName(keys, "parse_header"))
+        self.assertFalse(CutName(keys, "main"))
+
+    def test_crash_frame_is_protected(self):
+        cnt = ("routine,calls,blocks,instructions\n"
+               "\"crc32_update\",10,900,9000\n"
+               "\"parse_header\",1,100,500\n")
+        crash = "    #0 0x4c5e1f in crc32_update /src/crc.c:45:9\n    #1 0x4c1000 in main /src/a.c:9:1\n"
+        keys, rows = self.Suggest([cnt], crash)
+        self.assertEqual([r["status"] for r in rows if r["routine"] == "crc32_update"], ["crash"])
+        self.assertFalse(CutName(keys, "crc32_update"))
+
+    def test_covered_routine_is_skipped(self):
+        cnt = ("routine,calls,blocks,instructions\n"
+               "\"memcpy\",10,500,9000\n"
+               "\"memcpy_avx\",10,400,9000\n"
+               "\"parse_header\",1,100,500\n")
+        keys, _ = self.Suggest([cnt], old=["strlen"])
+        self.assertEqual(keys, ["strlen", "memcpy"])
+        self.assertTrue(CutName(keys, "memcpy_avx"))
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,105 @@
+""" Tests of `TraceReader` over `libtrread.so`, which `make libtrread` builds
+
+    python3 -m unittest discover -s TConsole/tests -t .
+"""
+import os
+import struct
+import shutil
+import tempfile
+import unittest
+import zlib
+
+from ..tracer.reader import TraceReader
+
+LIB_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        "..", "..", "TraceTools", "build", "libtrread.so")
+
+def Write(fpath :str, data :bytes) -> None:
+    with open(fpath, mode="wb") as f:
+        f.write(data)
+
+def Payload(addrs) -> bytes:
+    """ LEB128 of zigzag deltas, as `ChkEncode` in `trchunk.h`
+    """
+    out = bytearray()
+    prev = 0
+    for a in addrs:
+        d = (a - prev + (1 << 63)) % (1 << 64) - (1 << 63)
+        z = ((d << 1) ^ (d >> 63)) & ((1 << 64) - 1)
+        prev = a
+        while z >= 0x80:
+            out.append((z & 0x7F) | 0x80)
+            z >>= 7
+        out.append(z)
+    return bytes(out)
+
+def Container(chunks) -> bytes:
+    """ A chunked container of `(tid, first_seq, addrs)` with its index
+    """
+    data = bytearray(struct.pack("<8sII", b"TRCHUNK", 1, 0))
+    index = bytearray()
+    for tid, seq, addrs in chunks:
+        body = Payload(addrs)
+        index += struct.pack("<QQII", len(data), seq, tid, len(addrs))
+        data += struct.pack("<IIQIIII", 0x4b434854, tid, seq, len(addrs),
+                            len(body), zlib.crc32(body), 0)
+        data += body
+    off_index = len(data)
+    data += index
+    data += struct.pack("<QQII8s", len(chunks), off_index, 0, 0, b"TRCKIDX")
+    return bytes(data)
+
+@unittest.skipUnless(os.path.isfile(LIB_PATH), "libtrread.so is not built")
+class TestTraceReader(unittest.TestCase):
+    def setUp(self) -> None:
+        self.work = tempfile.mkdtemp(prefix="TConsole-test-")
+
+    def tearDown(self) -> None:
+        shutil.rmtree(self.work, ignore_errors=True)
+
+    def Path(self, name :str, data :bytes) -> str:
+        fpath = os.path.join(self.work, name)
+        Write(fpath, data)
+        return fpath
+
+    def test_text_records_and_symbols(self):
+        dat = self.Path("dat", b"0x401000\n0x401010\n0x402000\n")
+        sym = self.Path("sym", b"0x1,.text+0x0:main\n0x1,.text+0x10:main\n0x2,.text+0x1000:work\n")
+        with TraceReader(dat, sym, LIB_PATH) as rd:
+            self.assertFalse(rd.chunked())
+            recs = list(rd)
+            self.assertEqual([(a, t) for a, t, _ in recs],
+                             [(0x401000, 1), (0x401010, 1), (0x402000, 2)])
+            self.assertEqual([rd.sym_name(s) for _, _, s in recs],
+                             [".text+0x0:main", ".text+0x10:main", ".text+0x1000:work"])
+            self.assertEqual(rd.sym_count(), 3)
+            self.assertFalse(rd.truncated())
+
+    def test_chunk_records(self):
+        dat = self.Path("chk", Container([
+            (1, 0, [0x401000, 0x400ff0, 0x402000]),
+            (2, 0, [0x500000]),
+            (1, 3, [0x401000]),
+        ]))
+        with TraceReader(dat, None, LIB_PATH) as rd:
+            self.assertTrue(rd.chunked())
+            recs = list(rd)
+            self.assertEqual(sorted((t, a) for a, t, _ in recs),
+                             sorted([(1, 0x401000), (1, 0x400ff0), (1, 0x402000),
+                                     (2, 0x500000), (1, 0x401000)]))
+            self.assertEqual([a for a, t, _ in recs if 1 == t],
+                             [0x401000, 0x400ff0, 0x402000, 0x401000])
+            self.assertTrue(all(0 == s for _, _, s in recs))
+
+    def test_closed_reader_raises(self):
+        dat = self.Path("dat", b"0x401000\n")
+        rd = TraceReader(dat, None, LIB_PATH)
+        with rd:
+            self.assertEqual([a for a, _, _ in rd], [0x401000])
+        for call in (rd.rewind, rd.sym_count, rd.truncated, rd.chunked,
+                     lambda: rd.sym_name(1), lambda: next(rd.batches())):
+            with self.assertRaises(ValueError):
+                call()
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,91 @@
+""" Tests of `TraceStore` and how `CoreLauncher` uses it
+
+    python3 -m unittest discover -s TConsole/tests -t .
+"""
+import os
+import stat
+import shutil
+import tempfile
+import unittest
+
+from ..tracer.store import TraceStore
+from ..tracer.entrance import CoreLauncher
+from ..utility.log import GIVE_MY_LOGGER
+
+def Write(fpath :str, text :str) -> None:
+    with open(fpath, mode="w", encoding="utf-8") as f:
+        f.write(text)
+
+def Read(fpath :str) -> str:
+    with open(fpath, mode="r", encoding="utf-8") as f:
+        return f.read()
+
+class TestTraceStore(unittest.TestCase):
+    def setUp(self) -> None:
+        self.work = tempfile.mkdtemp(prefix="TConsole-test-")
+        self.src = os.path.join(self.work, "src")
+        self.dat = os.path.join(self.work, "dat")
+        os.makedirs(self.src)
+        os.makedirs(self.dat)
+        self.store = TraceStore(os.path.join(self.work, "store"), "salt")
+
+    def tearDown(self) -> None:
+        shutil.rmtree(self.work, ignore_errors=True)
+
+    def Launcher(self, names):
+        """ A launcher with just what `__clear_outputs` needs, no Pin
+        """
+        lc = CoreLauncher.__new__(CoreLauncher)
+        lc.clog = GIVE_MY_LOGGER()
+        lc.dsrc, lc.ddat, lc.dsym = self.src, self.dat, None
+        lc.fsrc = [os.path.join(self.src, n) for n in names]
+        lc.fdat_get = lambda p: p.replace(self.src, self.dat, 1)
+        lc.fjob = list(range(len(names)))
+        return lc
+
+    def test_kept_files_are_read_only(self):
+        fsrc, fdat = os.path.join(self.src, "a"), os.path.join(self.dat, "a")
+        Write(fsrc, "aaaa")
+        Write(fdat, "0x4\n")
+        key = self.store.key(fsrc)
+        self.assertTrue(self.store.keep(key, fdat, None, 0))
+        self.assertFalse(os.stat(fdat).st_mode & (stat.S_IWUSR | stat.S_IWGRP | stat.S_IWOTH))
+
+    def test_new_run_keeps_old_entry(self):
+        fsrc, fdat = os.path.join(self.src, "a"), os.path.join(self.dat, "a")
+        Write(fsrc, "aaaa")
+        Write(fdat, "0x4\n")
+        Write(fdat + ".123", "0x5\n")
+        old = self.store.key(fsrc)
+        self.store.keep(old, fdat, None, 0)
+
+        # the input changes, so it runs again on the same paths
+        Write(fsrc, "bbbbbbbb")
+        self.Launcher(["a"])._CoreLauncher__clear_outputs()
+        self.assertFalse(os.path.lexists(fdat))
+        self.assertFalse(os.path.lexists(fdat + ".123"))
+        Write(fdat, "0x8\n")
+
+        out = os.path.join(self.work, "out")
+        self.assertEqual(self.store.fetch(old, out, None), 0)
+        self.assertEqual(Read(out), "0x4\n")
+        self.assertEqual(Read(out + ".123"), "0x5\n")
+
+    def test_exec_outputs_are_kept(self):
+        fsrc, fdat = os.path.join(self.src, "a"), os.path.join(self.dat, "a")
+        Write(fsrc, "aaaa")
+        Write(fdat, "0x4\n")
+        Write(fdat + ".123.exec", "0x6\n")
+        Write(fdat + ".123.exec.456.exec", "0x7\n")
+        Write(fdat + ".execs", "junk\n")
+        key = self.store.key(fsrc)
+        self.assertTrue(self.store.keep(key, fdat, None, 0))
+
+        out = os.path.join(self.work, "out")
+        self.assertEqual(self.store.fetch(key, out, None), 0)
+        self.assertEqual(Read(out + ".123.exec"), "0x6\n")
+        self.assertEqual(Read(out + ".123.exec.456.exec"), "0x7\n")
+        self.assertFalse(os.path.lexists(out + ".execs"))
+
+if __name__ == "__main__":
+    unittest.main()
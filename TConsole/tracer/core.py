@@ -2,6 +2,7 @@ import os
 import typing
 import time
 import inspect
+import threading
 
 from .worker import ParallelWorker
 from ..utility.log import GIVE_MY_LOGGER
@@ -32,6 +33,8 @@ class TracerCoreRunner:
     |  2110x | Tool TrCutName |
     |  2121x | Tool TrDatPath |
     |  2131x | Tool TrSymPath |
+    |  2140x | Tool TrCovPath |
+    |  2150x | Tool TrCovType |
     |  30000 | Double dash "--" |
     |  40000 | Target bin path  |
     |  5xx0x | Target fix args before |
@@ -49,7 +52,10 @@ class TracerCoreRunner:
         target_args_fix0 :typing.Optional[str],
         target_args_fix1 :typing.Optional[str],
 
-        num_workers :int =2
+        num_workers :int =2,
+        pin_cpu     :bool =False,
+        tool_CovPath :typing.Optional[str] =None,
+        tool_CovEdge :bool =False
     ) -> None:
         """ Constructor which receives fix args
 
@@ -62,6 +68,16 @@ class TracerCoreRunner:
         ----------
         num_workers:
             Number of workers in the pool. Default is 2.
+        pin_cpu:
+            Bind each worker (and the Pin processes it starts)
+            to its own CPU. Default is `False`.
+        tool_CovPath:
+            Argument category 21401. Path of the global coverage map
+            shared by all jobs, so each job only records what no job
+            has recorded before. Pass `None` to record everything.
+        tool_CovEdge:
+            Argument category 21501. Count edges between records
+            rather than records as coverage. Only works with `tool_CovPath`.
         bin_pin:
             Argument category 10000
         bin_tool:
@@ -70,7 +86,12 @@ class TracerCoreRunner:
             Argument category 40000
         tool_ScaType:
             Argument category 21001. 0 means 'cal'. 1 means 'bbl'.
-            2 means 'ins'. Otherwise 'bbl' as fallback.
+            2 means 'ins'. 3 means 'cg', i.e. a call graph file rather
+            than a trace. 4 means 'prof', i.e. folded stacks with cycles.
+            5 means 'samp', i.e. folded stacks sampled on a timer.
+            6 means 'cnt', i.e. a CSV of calls, blocks and instructions
+            of each routine. 7 means 'gram', i.e. hashed counts of
+            block n-grams. Otherwise 'bbl' as fallback.
         tool_CutName:
             Argument category 21101. Pass `[]` or `[""]`
             means shutting off the corresponding feature.
@@ -113,6 +134,16 @@ class TracerCoreRunner:
             self.FixArgs[21001] = "bbl"
         elif (2 == tool_ScaType):
             self.FixArgs[21001] = "ins"
+        elif (3 == tool_ScaType):
+            self.FixArgs[21001] = "cg"
+        elif (4 == tool_ScaType):
+            self.FixArgs[21001] = "prof"
+        elif (5 == tool_ScaType):
+            self.FixArgs[21001] = "samp"
+        elif (6 == tool_ScaType):
+            self.FixArgs[21001] = "cnt"
+        elif (7 == tool_ScaType):
+            self.FixArgs[21001] = "gram"
         else:
             self.FixArgs[21001] = "bbl"
 
@@ -121,15 +152,25 @@ class TracerCoreRunner:
             self.FixArgs[21100] = "-TrCutName"
             self.FixArgs[21101] = "%s;"%tcutn
 
+        if (tool_CovPath is not None):
+            self.FixArgs[21400] = "-TrCovPath"
+            self.FixArgs[21401] = tool_CovPath
+            self.FixArgs[21500] = "-TrCovType"
+            self.FixArgs[21501] = "edge" if tool_CovEdge else "blk"
+
         self._n_workers = num_workers
-        self.wPool = ParallelWorker(self.FixArgs, num_workers)
+        self.wPool = ParallelWorker(self.FixArgs, num_workers, pin_cpu)
         self.rList = []
+        self.rTime = []
+        self.rCond = threading.Condition()
+        self.rDone = 0
         self.wDone = False
 
     def apply(self, GenVarArgs :typing.Generator[None,None,tuple],
         stdin  :bool,
         output :bool =False,
-        timeout :typing.Optional[int] =None
+        timeout :typing.Optional[int] =None,
+        cost   :typing.Optional[typing.List[float]] =None
     ) -> None:
         """ Apply jobs to workers in the pool
 
@@ -153,7 +194,15 @@ class TracerCoreRunner:
         timeout:
             If the process which executes the job funtion does not terminate
             after timeout seconds, it will be killed. `None` shuts off this feature.
+        cost:
+            Expected cost of each job, in the same order as `GenVarArgs`
+            yields. Jobs are submitted from the most expensive one, so huge
+            inputs do not start last and leave a long tail. `None` keeps
+            the order of `GenVarArgs`. Either way `self.access` gives
+            results in the order of `GenVarArgs`.
         """
+        base = len(self.rList)
+        jobs = []
         for va in GenVarArgs:
             VarArgs = va[0]
             if (stdin is False):
@@ -165,42 +214,80 @@ class TracerCoreRunner:
                 keep_output = output,
                 timeout_sec = timeout
             )
-            self.rList.append(
-                self.wPool.apply_async(job_func))
+            jobs.append(job_func)
+            self.rList.append(None)
+            self.rTime.append(None)
+
+        order = list(range(len(jobs)))
+        if (cost is not None):
+            if (len(cost) != len(jobs)):
+                err_s = "Unmatched length: " \
+                    "%d jobs but %d costs"%(len(jobs), len(cost))
+                self.rlog.error(err_s)
+                raise IndexError(err_s)
+            order.sort(key=lambda i: cost[i], reverse=True)
+
+        for i in order:
+            self.rList[base+i] = self.wPool.apply_async(
+                self.__timed(jobs[i], base+i),
+                callback       = self.__on_done,
+                error_callback = self.__on_done)
             self.rlog.debug("Apply => %s", str(
-                inspect.getclosurevars(job_func).nonlocals["arg_lst"]))
-    
+                inspect.getclosurevars(jobs[i]).nonlocals["arg_lst"]))
+
+    def __timed(self, job_func :typing.Callable[[],tuple],
+        index :int
+    ) -> typing.Callable[[],tuple]:
+        """ Wrap a job function to record its wall time into `self.rTime`
+        """
+        def timed_function():
+            t_start = time.monotonic()
+            try:
+                return job_func()
+            finally:
+                self.rTime[index] = time.monotonic() - t_start
+        return timed_function
+
+    def __on_done(self, _ :typing.Any) -> None:
+        """ Callback from the pool when a job completes or fails
+        """
+        with self.rCond:
+            self.rDone += 1
+            self.rCond.notify_all()
+
     def wait(self, refresh_sec :int =5) -> None:
         """ Wait for all jobs to complete
 
-        `refresh_sec` is the time interval (in seconds)
-        for polling the progress. Default is 5.
+        Progress is reported as soon as jobs complete, driven by
+        callbacks from the pool rather than polling. `refresh_sec`
+        is the longest time (in seconds) to stay silent when no job
+        completes meanwhile. Default is 5.
         """
         self.wPool.close()
         self.wDone = False
 
         job_num = len(self.rList)
-        job_done = []
-        job_wait = list(range(job_num))
-
-        while (len(job_wait) > 0):
-            job_wait_new = []
-            for i in job_wait:
-                if (self.rList[i].ready() is True):
-                    job_done.append(i)
-                else:
-                    job_wait_new.append(i)
-            job_wait = job_wait_new
-
-            self.rlog.info("Running: %d, Progress: %d/%d", 
-                len(job_wait), len(job_done), job_num)
-            if (0 != len(job_wait)):
-                time.sleep(refresh_sec)
+        with self.rCond:
+            while True:
+                job_done = self.rDone
+                self.rlog.info("Running: %d, Progress: %d/%d", 
+                    job_num - job_done, job_done, job_num)
+                if (job_done >= job_num):
+                    break
+                self.rCond.wait_for(lambda: self.rDone != job_done,
+                    timeout=refresh_sec)
 
         self.wPool.join()
         self.wDone = True
         self.rlog.info("%d jobs have been done", job_num)
 
+    def elapse(self) -> typing.List[typing.Optional[float]]:
+        """ Wall time (in seconds) of each job, in the order of `self.access`
+
+        `None` for the jobs which have not completed.
+        """
+        return list(self.rTime)
+
     def access(self) -> typing.Optional[typing.Generator[None,None,tuple]]:
         """ Access returned things from job functions
 
@@ -1,9 +1,11 @@
 import os
 import sys
+import json
 import typing
 
 from .worker import TIMEOUT_KILL_CODE
 from .core import TracerCoreRunner
+from .store import TraceStore, SideFiles, Place
 from ..utility.log import GIVE_MY_LOGGER
 from ..utility.checker import check_all_file_from_dir
 from ..utility.checker import check_all_file_hierarchy
@@ -53,7 +55,15 @@ class CoreLauncher:
         worker_num :int =FALLBACK_WORKER_NUM,
         worker_chk :int =FALLBACK_WORKER_CHK,
         worker_dmp :bool =False,
-        worker_tim :typing.Optional[int] =None
+        worker_tim :typing.Optional[int] =None,
+        worker_ljf :bool =True,
+        worker_his :typing.Optional[str] =None,
+        worker_cpu :bool =False,
+        trace_cov  :typing.Optional[str] =None,
+        trace_edge :bool =False,
+        src_list   :typing.Optional[str] =None,
+        trace_store :typing.Optional[str] =None,
+        trace_mmap :bool =False
     ) -> None:
         """ Centralized parameter passing and checking
 
@@ -78,7 +88,18 @@ class CoreLauncher:
             Hierarchy copying and file saving acts same as `dir_dat`.
         target_sca
             Indicates `TrScaType` for TracerCore. 0 means 'cal'.
-            1 means 'bbl'. 2 means 'ins'. Otherwise 0 will be used
+            1 means 'bbl'. 2 means 'ins'. 3 means 'cg', which saves
+            a call graph (see `TraceGraph`) as the trace file of each
+            input. 4 means 'prof', which saves folded stacks with
+            cycles as the trace file and a per-routine CSV summary as
+            the trace-symbol file. 5 means 'samp', which saves the
+            same two files from stacks sampled on a timer, at a small
+            fraction of the cost. 6 means 'cnt', which saves the
+            calls, blocks and instructions of each routine as a
+            CSV trace file, i.e. how much 'cal', 'bbl' and 'ins'
+            would record for it. 7 means 'gram', which saves counts
+            of block n-grams hashed into a fixed-size vector, a few
+            kilobytes ready for clustering. Otherwise 0 will be used
             as fallback and the error will be logged.
         target_bin
             Path of target executable binary.
@@ -107,11 +128,10 @@ class CoreLauncher:
             will be considered as different job and then 
             submitted to the pool for allocation to the workers.
         worker_chk
-            How many seconds between each start poll. After all jobs
-            are submitted, the pool will close and will not accept 
-            new submissions. Then a polling process will start, 
-            and every few seconds, completion status of the submitted
-            jobs will be queried until all done.
+            Longest silent seconds when waiting. After all jobs are
+            submitted, the pool will close and will not accept new
+            submissions. Progress is then reported as soon as jobs
+            complete, or every few seconds if none completes.
         worker_dmp
             Tell the workers whether to dump the stdin and stdout of
             each job. If `True`, they will be logged at `logging.DEBUG`
@@ -120,6 +140,47 @@ class CoreLauncher:
             Timeout for each job. If the timeout occurs, the job will
             not continue to execute by the worker. `TIMEOUT_KILL_CODE`
             will be used as the so-called `returncode` of these jobs.
+        worker_ljf
+            Submit the longest expected jobs first, so a few huge
+            inputs do not run last and leave the other workers idle.
+            Expected cost is the past runtime from `worker_his`, or
+            the input file size scaled by known runtimes otherwise.
+        worker_his
+            Path of a JSON file keeping the runtime (in seconds) of
+            each input in previous runs. It is read before `launch`
+            and updated at `landing`. Pass `None` to disable it.
+        worker_cpu
+            Bind each worker to its own CPU, so Pin and its JIT threads
+            do not migrate between cores. Better not to use more workers
+            than CPUs when it is enabled.
+        trace_cov
+            Path of a global coverage map shared by all jobs and
+            later runs. Each job then records only the blocks never
+            seen before, and traces adding nothing are removed at
+            `landing`. Pass `None` to record full traces.
+        trace_edge
+            Count edges between blocks rather than blocks as coverage.
+            Only works with `trace_cov`. One map must not mix both.
+        src_list
+            Path of a file listing the inputs to run, one path
+            relative to `dir_src` a line, like the output of
+            `TraceMin`. Other files in `dir_src` are skipped.
+            Pass `None` to run every file in `dir_src`.
+        trace_store
+            Directory of a content-addressed store of traces (see
+            `TraceStore`). An input whose bytes were traced before by
+            the same target, TracerCore and knobs is not run again,
+            and its kept outputs are hard-linked to its paths. So are
+            identical inputs in one run. New outputs are kept at
+            `landing`, except those of jobs timed out. Does not work
+            with `trace_cov`, as those traces depend on earlier jobs.
+            Pass `None` to trace every input.
+        trace_mmap
+            Write trace files through a shared mapping ('map:<path>'
+            of '-TrDatPath'), so a job killed on timeout still leaves
+            every record made before the kill. Readers of TraceTools
+            (and `TraceReader`) skip the header of such files. Only
+            works with ScaType 0, 1 and 2 and without `trace_cov`.
         """
         self.clog = GIVE_MY_LOGGER()
         self.OpenFileList = []
@@ -150,6 +211,22 @@ class CoreLauncher:
         else:
             self.worker_tim = None
         
+        self.worker_ljf = (worker_ljf is True)
+        self.worker_cpu = (worker_cpu is True)
+        self.worker_his = None
+        self.history = {}
+        if isinstance(worker_his, str):
+            self.worker_his = worker_his
+            self.history = self.__load_history(worker_his)
+            self.clog.info("Get runtime of %d inputs from %s",
+                           len(self.history), worker_his)
+
+        self.trace_cov = None
+        self.trace_edge = (trace_edge is True)
+        if isinstance(trace_cov, str) and (len(trace_cov) > 0):
+            self.trace_cov = os.path.abspath(trace_cov)
+            self.clog.info("Only record new coverage against %s", self.trace_cov)
+
         if (read_stdin is True):
             self.read_stdin = True
         else:
@@ -182,7 +259,7 @@ class CoreLauncher:
                     self.clog.error("Ignore filter rule %s", repr(F))
         
         self.pintool_sca = 0
-        if isinstance(target_sca, int) and (target_sca in [0,1,2]):
+        if isinstance(target_sca, int) and (target_sca in [0,1,2,3,4,5,6,7]):
             self.pintool_sca = target_sca
         else:
             self.clog.error("Use default ScaType 0 "
@@ -218,12 +295,95 @@ class CoreLauncher:
             "This is very rare, make sure it is correct: %s", target_arg)
             self.target_arg_v = lambda S: target_arg.replace(CMD_FILE_PLACEHOLDER, S)
 
-        self.__init_resource(dir_src, dir_dat, dir_sym)
+        self.__init_resource(dir_src, dir_dat, dir_sym, src_list)
         self.runner = TracerCoreRunner(self.pin, self.pintool, self.target_bin,
             self.pintool_sca, self.pintool_cut, self.target_arg_l, self.target_arg_r,
-            self.worker_num)
+            self.worker_num, self.worker_cpu, self.trace_cov, self.trace_edge)
+
+        self.trace_mmap = False
+        if (trace_mmap is True):
+            if (self.trace_cov is not None) or (self.pintool_sca not in [0,1,2]):
+                self.clog.warning("Ignore trace_mmap since ScaType %d "
+                    "or coverage-guided traces need plain files", self.pintool_sca)
+            else:
+                self.trace_mmap = True
+                self.clog.info("Write trace files through shared mappings")
+
+        self.store = None
+        if isinstance(trace_store, str) and (len(trace_store) > 0):
+            if (self.trace_cov is not None):
+                self.clog.warning("Ignore trace store %s since traces "
+                                  "only record new coverage", trace_store)
+            else:
+                knobs = {str(k): v for k, v in self.runner.FixArgs.items()
+                         if k not in [10000, 20001, 40000]} #paths of binaries are hashed instead
+                knobs["arg"] = target_arg
+                knobs["stdin"] = self.read_stdin
+                knobs["mmap"] = self.trace_mmap
+                self.store = TraceStore(trace_store,
+                    TraceStore.MakeSalt([self.pintool, self.target_bin], knobs))
+                self.clog.info("Reuse traces kept in %s", self.store.root)
+        self.fjob = list(range(len(self.fsrc))) #inputs to run, others come from the store
+        self.fhit = {} #input => return code kept in the store
+        self.fdup = {} #input => the same input run in this launch
+        self.fkey = []
+
+    def __load_history(self, fpath :str) -> typing.Dict[str,float]:
+        """ Read runtime history of inputs. Missing or bad file means no history.
+        """
+        if not os.path.isfile(fpath):
+            return {}
+        try:
+            with open(fpath, mode="r", encoding="utf-8") as f:
+                his = json.load(f)
+            return {k: float(v) for k, v in his.items()}
+        except BaseException as be:
+            self.clog.warning("Ignore bad runtime history %s: %s", fpath, repr(be))
+            return {}
 
-    def __init_resource(self, dsrc, ddat, dsym) -> None:
+    def __expect_cost(self) -> typing.List[float]:
+        """ Expected runtime of each input in `self.fsrc`
+
+        Past runtime is used if known. Otherwise the file size is
+        converted into seconds by the median speed of known inputs,
+        or just used as it is when nothing is known.
+        """
+        sizes = [os.path.getsize(fp) for fp in self.fsrc]
+        speed = []
+        for fp, sz in zip(self.fsrc, sizes):
+            if (fp in self.history) and (sz > 0):
+                speed.append(self.history[fp] / sz)
+        if (0 == len(speed)):
+            return [float(sz) for sz in sizes]
+        speed.sort()
+        spb = speed[len(speed)//2]
+        return [self.history[fp] if (fp in self.history) else spb*sz
+                for fp, sz in zip(self.fsrc, sizes)]
+
+    def __drop_stale(self, done :typing.List[int]) -> None:
+        """ Remove traces of finished jobs which add no new coverage
+
+        With `trace_cov`, an empty trace file means the job ran
+        nothing new, so it and its trace-symbol file are not kept.
+        """
+        n_drop = 0
+        for idx in done:
+            fdat = self.fdat_get(self.fsrc[idx])
+            try:
+                if (0 != os.path.getsize(fdat)):
+                    continue
+                os.remove(fdat)
+                if (self.dsym is not None):
+                    fsym = self.fsym_get(self.fsrc[idx])
+                    if os.path.isfile(fsym):
+                        os.remove(fsym)
+                n_drop += 1
+            except OSError as oe:
+                self.clog.warning("CANNOT drop trace %s: %s", fdat, repr(oe))
+        self.clog.info("Drop %d traces with no new coverage, keep %d",
+                       n_drop, len(done) - n_drop)
+
+    def __init_resource(self, dsrc, ddat, dsym, slist) -> None:
         """ Sub-init about IO resources
         """
         # about logs from pin & pintool
@@ -244,6 +404,21 @@ class CoreLauncher:
             err_s = "Bad src directory path: %s"%(repr(dsrc))
             self.clog.error(err_s)
             raise IOError(err_s)
+        if (slist is not None):
+            try:
+                with open(slist, mode="r", encoding="utf-8") as f:
+                    keep = set(L.rstrip("\r\n") for L in f if len(L.strip()) > 0)
+            except OSError as oe:
+                err_s = "Bad src list: %s"%(repr(slist))
+                self.clog.error(err_s)
+                raise IOError(err_s) from oe
+            self.fsrc = [fp for fp in self.fsrc
+                         if os.path.relpath(fp, dsrc) in keep]
+            if (0 == len(self.fsrc)):
+                err_s = "No file in %s is listed by %s"%(repr(dsrc), repr(slist))
+                self.clog.error(err_s)
+                raise RuntimeError(err_s)
+            self.clog.info("Keep %d inputs listed in %s", len(self.fsrc), slist)
 
         # about DatPath
         if check_dir_access(ddat):
@@ -274,8 +449,84 @@ class CoreLauncher:
         except BaseException as be:
             raise RuntimeError("CANNOT init hierarchy") from be
 
+    def __fetch_stored(self) -> None:
+        """ Place outputs kept in the store and leave the rest to run
+        """
+        self.fkey = [self.store.key(fp) for fp in self.fsrc]
+        self.fjob = []
+        first = {}
+        for idx, fp in enumerate(self.fsrc):
+            k = self.fkey[idx]
+            if (k in first):
+                self.fdup[idx] = first[k]
+                continue
+            rc = self.store.fetch(k, self.fdat_get(fp),
+                self.fsym_get(fp) if (self.dsym is not None) else None)
+            if (rc is None):
+                first[k] = idx
+                self.fjob.append(idx)
+            else:
+                self.fhit[idx] = rc
+        self.clog.info("Get %d traces from the store and %d duplicate inputs, "
+                       "run %d", len(self.fhit), len(self.fdup), len(self.fjob))
+
+    def __keep_stored(self, results :typing.List[tuple]) -> None:
+        """ Keep new outputs in the store and place those of duplicates
+
+        Entries of `results` for duplicates are filled here.
+        """
+        every = set(self.fdat_get(fp) for fp in self.fsrc)
+        if (self.dsym is not None):
+            every |= set(self.fsym_get(fp) for fp in self.fsrc)
+        n_keep = 0
+        for idx in self.fjob:
+            if (results[idx][0] == TIMEOUT_KILL_CODE):
+                continue
+            fp = self.fsrc[idx]
+            n_keep += self.store.keep(self.fkey[idx], self.fdat_get(fp),
+                self.fsym_get(fp) if (self.dsym is not None) else None,
+                results[idx][0], every)
+        for idx, src in self.fdup.items():
+            results[idx] = results[src]
+            if (results[src][0] == TIMEOUT_KILL_CODE):
+                continue
+            fd_src, fd_dst = self.fdat_get(self.fsrc[src]), self.fdat_get(self.fsrc[idx])
+            for suffix in [""] + SideFiles(fd_src, every):
+                Place(fd_src + suffix, fd_dst + suffix)
+                if (self.dsym is not None) and \
+                        os.path.isfile(self.fsym_get(self.fsrc[src]) + suffix):
+                    Place(self.fsym_get(self.fsrc[src]) + suffix,
+                          self.fsym_get(self.fsrc[idx]) + suffix)
+        self.clog.info("Keep %d new traces in the store", n_keep)
+
+    def __clear_outputs(self) -> None:
+        """ Remove what earlier runs left at the paths of jobs to run
+
+        TracerCore truncates its outputs in place, which would write
+        through a hard link into the store (see `TraceStore`), and
+        stale side files would be taken as outputs of the new job.
+        """
+        every = set(self.fdat_get(fp) for fp in self.fsrc)
+        if (self.dsym is not None):
+            every |= set(self.fsym_get(fp) for fp in self.fsrc)
+        for idx in self.fjob:
+            paths = [self.fdat_get(self.fsrc[idx])]
+            if (self.dsym is not None):
+                paths.append(self.fsym_get(self.fsrc[idx]))
+            for fpath in paths:
+                for suffix in [""] + SideFiles(fpath, every):
+                    try:
+                        if os.path.lexists(fpath + suffix):
+                            os.remove(fpath + suffix)
+                    except OSError as oe:
+                        self.clog.warning("CANNOT remove old output %s: %s",
+                                          fpath + suffix, repr(oe))
+
     def launch(self) -> None:
         """ Submit all jobs to Pool
+
+        With a trace store, only inputs not found in it are submitted.
+        Old outputs of the jobs submitted are removed first.
         """
         L_tool_DatPath    = []
         L_tool_SymPath    = None
@@ -288,8 +539,12 @@ class CoreLauncher:
         if self.read_stdin:
             L_target_stdin = self.OpenFileList #is ref, not copy!
         
-        for fp in self.fsrc:
-            L_tool_DatPath.append(self.fdat_get(fp))
+        if (self.store is not None):
+            self.__fetch_stored()
+        self.__clear_outputs()
+        for idx in self.fjob:
+            fp = self.fsrc[idx]
+            L_tool_DatPath.append(("map:" if self.trace_mmap else "") + self.fdat_get(fp))
             if (self.dsym is not None):
                 L_tool_SymPath.append(self.fsym_get(fp))
             if (self.target_arg_v is not None):
@@ -301,22 +556,34 @@ class CoreLauncher:
                         L_tool_DatPath, L_tool_SymPath, 
                         L_target_args_var, L_target_stdin)
 
+        cost = None
+        if self.worker_ljf:
+            cost_all = self.__expect_cost()
+            cost = [cost_all[idx] for idx in self.fjob]
         self.runner.apply(vargs, self.read_stdin, 
-                        self.worker_dmp, self.worker_tim)
+                        self.worker_dmp, self.worker_tim, cost)
         self.clog.info("Friendly UAV overhead.")
 
     def landing(self) -> None:
         """ Wait for all jobs done and check the results
         """
         self.runner.wait(refresh_sec = self.worker_chk)
-        results = self.runner.access()
-        if (results is None):
+        ran = self.runner.access()
+        if (ran is None):
             # Since `self.runner.wait` has returned, it should never be
             # `None` here. We keep this if-branch here just for fun :-)
             self.clog.warning("Unable to land. Mayday! Mayday!")
             return
         self.clog.info("Have a safe landing.")
-        
+
+        results = [None] * len(self.fsrc)
+        for idx, ret in zip(self.fjob, ran):
+            results[idx] = ret
+        for idx, rc in self.fhit.items():
+            results[idx] = (rc, b"", b"") if self.worker_dmp else (rc,)
+        if (self.store is not None):
+            self.__keep_stored(results)
+
         rcode = {TIMEOUT_KILL_CODE: []}
         rindx = -1
         for ret in results:
@@ -352,6 +619,21 @@ class CoreLauncher:
         self.clog.info("Report: total %d [timeout=%d%s]", 
             (1+rindx), len(rcode[TIMEOUT_KILL_CODE]), s_attach)
 
+        if (self.trace_cov is not None):
+            self.__drop_stale(rcode.get(0, []))
+
+        if (self.worker_his is not None):
+            for idx, sec in zip(self.fjob, self.runner.elapse()):
+                fp = self.fsrc[idx]
+                if (sec is not None):
+                    self.history[fp] = sec
+            try:
+                with open(self.worker_his, mode="w", encoding="utf-8") as f:
+                    json.dump(self.history, f, sort_keys=True, indent=1)
+            except BaseException as be:
+                self.clog.warning("CANNOT save runtime history %s: %s",
+                                  self.worker_his, repr(be))
+
     def __del__(self) -> None:
         """ Try to close those files in open
         """
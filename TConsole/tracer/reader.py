@@ -0,0 +1,165 @@
+import os
+import array
+import ctypes
+import typing
+
+from ..config import CONFIG_PATH
+
+def _default_lib_path() -> str:
+    """ Path of `libtrread.so` built by `make libtrread` in TraceTools
+    """
+    return os.path.join(CONFIG_PATH["DIR_TRACE_TOOLS"], "build", "libtrread.so")
+
+class TraceReader:
+    """ Read outputs of TracerCore through `libtrread.so` of TraceTools
+
+    Both a text trace file (with an optional trace symbol file) and a
+    chunked container ('-TrDatPath chunk:<path>') are accepted. Text
+    files written through a mapping ('-TrDatPath map:<path>') are read
+    up to their committed length, even if the target was killed. Files
+    are mapped and parsed in C++, and records are handed out in batches
+    of columns, so Python only touches each batch rather than each line.
+
+    Each record has an address, a thread ID (0 if unknown) and a symbol ID
+    (0 for none). Use `sym_name` to get the symbol string of an ID.
+    Any call after `close` raises `ValueError`.
+
+    ```python
+    with TraceReader("/path/to/TrDat", "/path/to/TrSym") as rd:
+        for addrs, tids, syms in rd.batches():
+            ...  # memoryviews, e.g. `numpy.frombuffer(addrs, dtype="u8")`
+    ```
+    """
+    __lib = None
+
+    @classmethod
+    def __load(cls, lib_path :typing.Optional[str]) -> ctypes.CDLL:
+        if (cls.__lib is not None) and (lib_path is None):
+            return cls.__lib
+        lib = ctypes.CDLL(lib_path if lib_path is not None else _default_lib_path())
+        lib.trread_open.restype  = ctypes.c_void_p
+        lib.trread_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+        lib.trread_close.restype  = None
+        lib.trread_close.argtypes = [ctypes.c_void_p]
+        lib.trread_rewind.restype  = None
+        lib.trread_rewind.argtypes = [ctypes.c_void_p]
+        lib.trread_next.restype  = ctypes.c_size_t
+        lib.trread_next.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+                                    ctypes.c_void_p, ctypes.c_size_t]
+        lib.trread_sym.restype  = ctypes.c_void_p
+        lib.trread_sym.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_size_t)]
+        lib.trread_nsym.restype  = ctypes.c_uint32
+        lib.trread_nsym.argtypes = [ctypes.c_void_p]
+        lib.trread_truncated.restype  = ctypes.c_int
+        lib.trread_truncated.argtypes = [ctypes.c_void_p]
+        lib.trread_chunked.restype  = ctypes.c_int
+        lib.trread_chunked.argtypes = [ctypes.c_void_p]
+        if (lib_path is None):
+            cls.__lib = lib
+        return lib
+
+    def __init__(self,
+        dat_path :str,
+        sym_path :typing.Optional[str] =None,
+        lib_path :typing.Optional[str] =None
+    ) -> None:
+        """ Constructor which maps the trace files
+
+        Parameters
+        ----------
+        dat_path:
+            Path of the trace file, text or a chunked container.
+        sym_path:
+            Path of the trace symbol file. Pass `None` for none.
+        lib_path:
+            Path of `libtrread.so`. Pass `None` to use the one
+            under `DIR_TRACE_TOOLS` of `config/path.yaml`.
+        """
+        self.handle = None
+        self.lib = self.__load(lib_path)
+        self.handle = self.lib.trread_open(dat_path.encode(),
+                                           None if sym_path is None else sym_path.encode())
+        if not self.handle:
+            raise RuntimeError("CANNOT read trace: {}".format(repr(dat_path)))
+
+    def close(self) -> None:
+        """ Unmap the files. Strings returned by `sym_name` stay valid.
+        """
+        if self.handle:
+            self.lib.trread_close(self.handle)
+            self.handle = None
+
+    def __enter__(self) -> "TraceReader":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def __del__(self) -> None:
+        self.close()
+
+    def __live(self) -> int:
+        """ Handle of the open files, which `libtrread.so` needs
+        for every call. Raises `ValueError` once closed.
+        """
+        if not self.handle:
+            raise ValueError("closed reader")
+        return self.handle
+
+    def rewind(self) -> None:
+        """ Go back to the first record
+        """
+        self.lib.trread_rewind(self.__live())
+
+    def batches(self, size :int =1 << 16) -> typing.Iterator[typing.Tuple[memoryview, memoryview, memoryview]]:
+        """ Yield records in batches of at most `size`
+
+        Each batch is `(addrs, tids, syms)`, memoryviews of unsigned
+        64-bit, 64-bit and 32-bit integers. The buffers are reused, so a
+        batch is only valid until the next one is asked for.
+        """
+        addrs = array.array("Q", bytes(8 * size))
+        tids  = array.array("Q", bytes(8 * size))
+        syms  = array.array("I", bytes(4 * size))
+        pa, pt, ps = addrs.buffer_info()[0], tids.buffer_info()[0], syms.buffer_info()[0]
+        va, vt, vs = memoryview(addrs), memoryview(tids), memoryview(syms)
+        while True:
+            n = self.lib.trread_next(self.__live(), pa, pt, ps, size)
+            if (0 == n):
+                return
+            yield (va[:n], vt[:n], vs[:n])
+
+    def __iter__(self) -> typing.Iterator[typing.Tuple[int, int, int]]:
+        """ Yield `(addr, tid, sym)` one by one from the first record
+
+        Handy but slower than `batches` for huge traces.
+        """
+        self.rewind()
+        for addrs, tids, syms in self.batches():
+            yield from zip(addrs, tids, syms)
+
+    def sym_name(self, sym_id :int) -> typing.Optional[str]:
+        """ Symbol string of an ID, or `None` for an unknown ID
+        """
+        n = ctypes.c_size_t(0)
+        p = self.lib.trread_sym(self.__live(), sym_id, ctypes.byref(n))
+        if not p:
+            return None
+        return ctypes.string_at(p, n.value).decode("utf-8", errors="replace")
+
+    def sym_count(self) -> int:
+        """ Number of distinct symbol strings seen so far
+        """
+        return self.lib.trread_nsym(self.__live())
+
+    def truncated(self) -> bool:
+        """ Whether the run stopped early on '-TrMaxEvents' / '-TrMaxBytes'
+
+        For text traces, it is known after the marker has been read.
+        """
+        return bool(self.lib.trread_truncated(self.__live()))
+
+    def chunked(self) -> bool:
+        """ Whether the trace is a chunked container
+        """
+        return bool(self.lib.trread_chunked(self.__live()))
\ No newline at end of file
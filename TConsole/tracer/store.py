@@ -0,0 +1,163 @@
+import os
+import re
+import json
+import stat
+import shutil
+import typing
+import hashlib
+import tempfile
+
+from ..utility.log import GIVE_MY_LOGGER
+
+HASH_CHUNK = 1 << 20
+# Suffixes TracerCore appends to '-TrDatPath' and '-TrSymPath': children
+# of `fork` (".<pid>"), rotated segments (".seg<N>") and coarser layers
+# of a multi-granularity run (".cal", ".bbl") and images run by `exec`
+# (".<pid>.exec"), in any combination
+RE_SIDE_SUFFIX = re.compile(r"^(\.(\d+|seg\d+|cal|bbl|exec))+$")
+
+def HashFile(fpath :str, hasher :typing.Optional[typing.Any] =None) -> str:
+    """ Hex SHA-256 of a file's bytes, fed into `hasher` if given
+    """
+    h = hasher if (hasher is not None) else hashlib.sha256()
+    with open(fpath, mode="rb") as f:
+        while True:
+            block = f.read(HASH_CHUNK)
+            if not block:
+                break
+            h.update(block)
+    return h.hexdigest()
+
+def SideFiles(fpath :str, skip :typing.Set[str]) -> typing.List[str]:
+    """ Suffixes of the files written next to `fpath` by the same job
+
+    Files in `skip` (outputs of other jobs) are never taken.
+    """
+    dpath, base = os.path.split(fpath)
+    res = []
+    try:
+        names = os.listdir(dpath)
+    except OSError:
+        return res
+    for name in names:
+        if not name.startswith(base) or (name == base):
+            continue
+        if (os.path.join(dpath, name) in skip):
+            continue
+        if RE_SIDE_SUFFIX.match(name[len(base):]):
+            res.append(name[len(base):])
+    return sorted(res)
+
+def Place(src :str, dst :str) -> None:
+    """ Hard-link `src` as `dst`, or copy it across file systems
+    """
+    if os.path.lexists(dst):
+        os.remove(dst)
+    try:
+        os.link(src, dst)
+    except OSError:
+        shutil.copyfile(src, dst)
+
+def Freeze(fpath :str) -> None:
+    """ Make a kept file read-only, so is every hard link to it
+    """
+    os.chmod(fpath, stat.S_IRUSR | stat.S_IRGRP | stat.S_IROTH)
+
+class TraceStore:
+    """ Content-addressed store of trace files
+
+    Outputs of a job are kept under a key made of the bytes of its
+    input and a salt, which stands for everything else shaping the
+    trace (target binary, TracerCore and its knobs). A later job with
+    the same key gets the kept files hard-linked to its own paths
+    rather than running again. The layout is
+    `<root>/<key[:2]>/<key>/{dat,sym,dat.<suffix>,...,meta.json}`.
+    Entries are moved in by `rename`, so runs may share a store.
+
+    Files are linked rather than copied whenever possible, so kept
+    files are made read-only, and a job must remove the files at its
+    paths before it runs rather than truncate them (see `CoreLauncher`).
+    """
+    def __init__(self, root :str, salt :str) -> None:
+        """ Open (or create) the store at `root` for jobs of `salt`
+        """
+        self.slog = GIVE_MY_LOGGER()
+        self.root = os.path.abspath(root)
+        self.salt = salt
+        os.makedirs(self.root, exist_ok=True)
+
+    @staticmethod
+    def MakeSalt(files :typing.List[str], knobs :typing.Dict[str,typing.Any]) -> str:
+        """ Salt of jobs which run the same binaries with the same knobs
+
+        `files` are hashed by content, so rebuilding the target or
+        TracerCore invalidates old entries. `knobs` must be JSON-serializable.
+        """
+        h = hashlib.sha256()
+        for fp in files:
+            h.update(HashFile(fp).encode("ascii"))
+        h.update(json.dumps(knobs, sort_keys=True).encode("utf-8"))
+        return h.hexdigest()
+
+    def key(self, fsrc :str) -> str:
+        """ Key of the job which traces the input file `fsrc`
+        """
+        h = hashlib.sha256(self.salt.encode("ascii"))
+        HashFile(fsrc, h)
+        return h.hexdigest()
+
+    def __entry(self, key :str) -> str:
+        return os.path.join(self.root, key[:2], key)
+
+    def fetch(self, key :str, fdat :str, fsym :typing.Optional[str]) -> typing.Optional[int]:
+        """ Place the kept outputs of `key` at `fdat` (and `fsym`)
+
+        Returns the return code of the job which made them,
+        or `None` if there is no entry or it lacks what is needed.
+        """
+        entry = self.__entry(key)
+        try:
+            with open(os.path.join(entry, "meta.json"), mode="r", encoding="utf-8") as f:
+                meta = json.load(f)
+            if (fsym is not None) and not meta["sym"]:
+                return None
+            for suffix in [""] + meta["side"]:
+                Place(os.path.join(entry, "dat" + suffix), fdat + suffix)
+                if (fsym is not None) and os.path.isfile(os.path.join(entry, "sym" + suffix)):
+                    Place(os.path.join(entry, "sym" + suffix), fsym + suffix)
+            return int(meta["rc"])
+        except (OSError, ValueError, KeyError, TypeError):
+            return None
+
+    def keep(self, key :str, fdat :str, fsym :typing.Optional[str], rc :int,
+        skip :typing.Set[str] =frozenset()
+    ) -> bool:
+        """ Keep the outputs of a finished job under `key`
+
+        Side files next to `fdat` (see `RE_SIDE_SUFFIX`) are kept along,
+        except those in `skip`. Returns whether a new entry is made.
+        """
+        entry = self.__entry(key)
+        if os.path.isdir(entry) or not os.path.isfile(fdat):
+            return False
+        side = SideFiles(fdat, skip)
+        os.makedirs(os.path.dirname(entry), exist_ok=True)
+        tmp = tempfile.mkdtemp(prefix=".tmp-", dir=os.path.dirname(entry))
+        try:
+            for suffix in [""] + side:
+                Place(fdat + suffix, os.path.join(tmp, "dat" + suffix))
+                Freeze(os.path.join(tmp, "dat" + suffix))
+                if (fsym is not None) and os.path.isfile(fsym + suffix):
+                    Place(fsym + suffix, os.path.join(tmp, "sym" + suffix))
+                    Freeze(os.path.join(tmp, "sym" + suffix))
+            with open(os.path.join(tmp, "meta.json"), mode="w", encoding="utf-8") as f:
+                json.dump({"rc": rc, "sym": fsym is not None, "side": side}, f, sort_keys=True)
+            os.rename(tmp, entry)
+            return True
+        except OSError as oe:
+            # another run kept the same key first, or the store is broken
+            if not os.path.isdir(entry):
+                self.slog.warning("CANNOT keep %s in the store: %s", fdat, repr(oe))
+            return False
+        finally:
+            shutil.rmtree(tmp, ignore_errors=True)
\ No newline at end of file
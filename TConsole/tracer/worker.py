@@ -1,4 +1,6 @@
+import os
 import typing
+import threading
 import subprocess
 import multiprocessing.pool
 
@@ -23,19 +25,45 @@ class ParallelWorker(multiprocessing.pool.ThreadPool):
     Based on this mechanism, it is more flexible to assign 
     different jobs to different workers, especially when 
     there are many shared long args accross all jobs.
+
+    Each worker thread gets a fixed index when the pool starts.
+    With CPU pinning enabled, the worker thread binds itself to one
+    CPU chosen by that index, and every subprocess it starts inherits
+    that affinity, so Pin and its JIT threads never migrate between
+    cores. Nothing runs between `fork` and `exec` for it, which would
+    be unsafe with threads around.
     """
     def __init__(self,
         args_common :typing.Dict[int,str], 
-        n_workers   :int =2
+        n_workers   :int =2,
+        pin_cpu     :bool =False
     ) -> None:
         """ Global settings
 
         `args_common` stores shared args accross all jobs.
         `n_workers` is the number of worker processes to use.
+        `pin_cpu` tells whether to bind each worker to its own CPU.
         """
         self.args_common = args_common
         self._n_workers = n_workers
-        super().__init__(n_workers)
+        self._cpu_list = []
+        if (pin_cpu is True):
+            self._cpu_list = sorted(os.sched_getaffinity(0))
+        self._w_lock  = threading.Lock()
+        self._w_local = threading.local()
+        self._w_count = 0
+        super().__init__(n_workers, self._init_worker)
+
+    def _init_worker(self) -> None:
+        """ Give the calling worker thread its index,
+        and bind it to its CPU if CPU pinning is enabled
+        """
+        with self._w_lock:
+            self._w_local.index = self._w_count
+            self._w_count += 1
+        if (0 != len(self._cpu_list)):
+            cpu = self._cpu_list[self._w_local.index % len(self._cpu_list)]
+            os.sched_setaffinity(0, {cpu})
 
     def get_size(self) -> int:
         """ Get num of workers in the pool
@@ -0,0 +1,135 @@
+#include "tmsg.h"
+#include "chunkread.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceChunk - read a container made by TracerCore '-TrDatPath chunk:<path>'." << std::endl;
+    std::cout << "Usage: TraceChunk -i <container> [-l] [-o <dat>] [-t <tid> [-s <seq>] [-n <count>]] [-j <threads>]" << std::endl;
+    std::cout << "  -i  Path of the container." << std::endl;
+    std::cout << "  -l  List the chunks instead of converting them." << std::endl;
+    std::cout << "  -o  Where the text trace file goes. Default is stdout." << std::endl;
+    std::cout << "  -t  Only records of this thread." << std::endl;
+    std::cout << "  -s  Start from this record of the thread. Default is 0." << std::endl;
+    std::cout << "  -n  Stop after this many records of the thread. Default is all." << std::endl;
+    std::cout << "  -j  Number of worker threads. Default is the number of cores." << std::endl;
+}
+
+/**
+ * The main procedure of the tool.
+ * Decode the chunks in parallel and write them as a text trace in
+ * the order of the container, or the order of a thread with '-t'.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string in_path, out_path;
+    bool list = false, one_tid = false;
+    uint32_t tid = 0;
+    uint64_t seq_beg = 0, seq_num = UINT64_MAX;
+    unsigned n_thread = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:lo:t:s:n:j:h")) != -1) {
+        switch (opt) {
+            case 'i': in_path  = optarg; break;
+            case 'l': list     = true; break;
+            case 'o': out_path = optarg; break;
+            case 't': tid      = static_cast<uint32_t>(strtoul(optarg, nullptr, 0)); one_tid = true; break;
+            case 's': seq_beg  = strtoull(optarg, nullptr, 0); break;
+            case 'n': seq_num  = strtoull(optarg, nullptr, 0); break;
+            case 'j': n_thread = static_cast<unsigned>(atoi(optarg)); break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if (in_path.size() == 0 || (!one_tid && (seq_beg || seq_num != UINT64_MAX))) {
+        disp_usage();
+        std::cout << "[!] Need -i, and -t for -s or -n" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+    const uint64_t seq_end = (seq_num > UINT64_MAX - seq_beg) ? UINT64_MAX : seq_beg + seq_num;
+
+    ChunkReader rd;
+    if (!rd.Open(in_path)) {
+        std::cerr << "[!] Bad container " << in_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+    const std::vector<ChkIndex> &chunks = rd.Chunks();
+    if (rd.Recovered())
+        { std::cerr << "[-] No index in " << in_path << ", " << chunks.size() << " intact chunks recovered" << std::endl; }
+
+    FILE* dat = stdout;
+    if (out_path.size() && !(dat = fopen(out_path.c_str(), "w"))) {
+        std::cerr << "[!] Failed to write " << out_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+
+    //chunks wanted, in the order of output
+    std::vector<size_t> which;
+    if (!one_tid) {
+        for (size_t i = 0; i < chunks.size(); ++i) { which.push_back(i); }
+    } else {
+        auto it = rd.Threads().find(tid);
+        if (it != rd.Threads().end()) {
+            for (size_t i : it->second) {
+                if (chunks[i].first_seq + chunks[i].count > seq_beg && chunks[i].first_seq < seq_end)
+                    { which.push_back(i); }
+            }
+        }
+    }
+
+    bool ok = true;
+    uint64_t total = 0;
+    if (list) {
+        fprintf(dat, "chunk,tid,first_seq,count,offset\n");
+        for (size_t i : which) {
+            fprintf(dat, "%zu,%u,%llu,%u,0x%llx\n", i, chunks[i].tid,
+                    static_cast<unsigned long long>(chunks[i].first_seq), chunks[i].count,
+                    static_cast<unsigned long long>(chunks[i].offset));
+        }
+    } else {
+        //decode a batch in parallel, then write it in order
+        const size_t batch = 64;
+        std::vector<size_t> slot(chunks.size());
+        std::vector<std::string> texts;
+        for (size_t beg = 0; beg < which.size(); beg += batch) {
+            std::vector<size_t> part(which.begin() + beg, which.begin() + std::min(which.size(), beg + batch));
+            for (size_t k = 0; k < part.size(); ++k) { slot[part[k]] = k; }
+            texts.assign(part.size(), std::string());
+            ok = rd.DecodeAll(part, n_thread, [&](size_t i, const uint64_t* recs, size_t n) {
+                std::string &out = texts[slot[i]];
+                const uint64_t first = chunks[i].first_seq;
+                size_t lo = 0, hi = n;
+                if (one_tid) {
+                    if (seq_beg > first) { lo = static_cast<size_t>(std::min<uint64_t>(n, seq_beg - first)); }
+                    if (seq_end - first < n) { hi = static_cast<size_t>(seq_end - first); }
+                }
+                out.reserve((hi - lo) * 12);
+                char buf[32];
+                for (size_t k = lo; k < hi; ++k) {
+                    int len = snprintf(buf, sizeof(buf), "0x%llx\n", static_cast<unsigned long long>(recs[k]));
+                    out.append(buf, len);
+                }
+            }) && ok;
+            for (const std::string &t : texts) { fwrite(t.data(), 1, t.size(), dat); }
+        }
+        for (const ChkIndex &c : chunks) { total += c.count; }
+        if (rd.Truncated() && !one_tid)
+            { fprintf(dat, "#TRUNCATED events=%llu\n", static_cast<unsigned long long>(total)); }
+    }
+    if (!ok) { std::cerr << "[!] Damaged chunks are skipped in " << in_path << std::endl; }
+
+    bool good = (0 == ferror(dat));
+    if (dat != stdout) { good = (0 == fclose(dat)) && good; } else { good = (0 == fflush(dat)) && good; }
+    if (!good) {
+        std::cerr << "[!] Failed to write " << (out_path.size() ? out_path : "stdout") << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    return ok ? GOOD_EXIT : EVIL_EXIT_READ;
+}
\ No newline at end of file
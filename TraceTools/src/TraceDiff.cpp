@@ -0,0 +1,169 @@
+#include "tmsg.h"
+#include "differ.h"
+#include "pool.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+// A pair of traces to compare, and what came out
+struct DiffPair
+{
+    std::string a_path;
+    std::string b_path;
+    std::string row; //the line of the summary
+    bool        ok;
+};
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceDiff - find where two traces diverge and the regions that differ." << std::endl;
+    std::cout << "Usage: TraceDiff -a <dat> -b <dat> [-o <diff>] [-w <records>] [-k <records>] [-m <hunks>]" << std::endl;
+    std::cout << "       TraceDiff -p <pairs> [-o <dir_out>] [-j <threads>] [-w <records>] [-k <records>] [-m <hunks>]" << std::endl;
+    std::cout << "  -a  A trace, text or chunked container." << std::endl;
+    std::cout << "  -b  Another trace of the same kind." << std::endl;
+    std::cout << "  -p  A file of pairs to compare in parallel, one \"<dat_a><TAB><dat_b>\" a line." << std::endl;
+    std::cout << "  -o  Where the hunks go. Default is stdout for -a -b, and nothing for -p,"
+                 " otherwise \"<line>.diff\" under the directory." << std::endl;
+    std::cout << "  -w  Records of each side searched for a resync after a divergence. Default is 4096." << std::endl;
+    std::cout << "  -k  Equal records in a row to resync. Default is 8." << std::endl;
+    std::cout << "  -m  Stop after this many hunks. Default is 0 for no limit." << std::endl;
+    std::cout << "  -j  Number of worker threads for -p. Default is the number of cores." << std::endl;
+}
+
+/**
+ * Compare a pair and make its line of the summary:
+ * "a,b,records_a,records_b,first_a,first_b,hunks,diff_a,diff_b,status".
+ * First records count from 1, and are 0 for equal traces.
+ * @param p the pair
+ * @param out_path where the hunks go, or "" for nowhere
+ */
+static void DiffOne(DiffPair &p, size_t window, size_t anchor, size_t max_hunks, const std::string &out_path){
+    TraceDiffer df(window, anchor, max_hunks);
+    std::ostringstream row;
+    row << CsvQuote(p.a_path) << "," << CsvQuote(p.b_path) << ",";
+    if (!df.Open(p.a_path, p.b_path)) {
+        p.ok  = false;
+        p.row = row.str() + ",,,,,,,error";
+        return;
+    }
+    const DiffResult r = df.Run();
+    uint64_t diff_a = 0, diff_b = 0;
+    for (const DiffHunk &h : r.hunks) { diff_a += h.a_len; diff_b += h.b_len; }
+    row << r.a_recs << "," << r.b_recs << ","
+        << (r.hunks.size() ? r.hunks[0].a_beg + 1 : 0) << ","
+        << (r.hunks.size() ? r.hunks[0].b_beg + 1 : 0) << ","
+        << r.hunks.size() << "," << diff_a << "," << diff_b << ","
+        << (r.hunks.empty() ? "same" : !r.aligned ? "unaligned" : r.capped ? "capped" : "diff");
+    p.ok  = true;
+    p.row = row.str();
+    if (out_path.size()) {
+        FILE* out = fopen(out_path.c_str(), "w");
+        if (!out) { p.ok = false; return; }
+        df.Print(r, out);
+        p.ok = (0 == fclose(out));
+    }
+}
+
+/**
+ * The main procedure of the tool.
+ * A single pair prints its hunks, and a batch of pairs prints a CSV
+ * summary with one line for each pair, in the order of the batch.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string a_path, b_path, pairs_path, out_path;
+    size_t window = 4096, anchor = 8, max_hunks = 0;
+    unsigned n_thread = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:p:o:w:k:m:j:h")) != -1) {
+        switch (opt) {
+            case 'a': a_path     = optarg; break;
+            case 'b': b_path     = optarg; break;
+            case 'p': pairs_path = optarg; break;
+            case 'o': out_path   = optarg; break;
+            case 'w': window     = strtoull(optarg, nullptr, 0); break;
+            case 'k': anchor     = strtoull(optarg, nullptr, 0); break;
+            case 'm': max_hunks  = strtoull(optarg, nullptr, 0); break;
+            case 'j': n_thread   = static_cast<unsigned>(atoi(optarg)); break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if ((pairs_path.size() == 0) == (a_path.size() == 0 || b_path.size() == 0) || window == 0 || anchor == 0) {
+        disp_usage();
+        std::cout << "[!] Need either -a and -b, or -p, and non-zero -w -k" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    if (pairs_path.size() == 0) {
+        TraceDiffer df(window, anchor, max_hunks);
+        if (!df.Open(a_path, b_path)) {
+            std::cerr << "[!] Failed to read " << a_path << " and " << b_path << " as traces of the same kind" << std::endl;
+            return EVIL_EXIT_READ;
+        }
+        const DiffResult r = df.Run();
+        FILE* out = stdout;
+        if (out_path.size() && !(out = fopen(out_path.c_str(), "w"))) {
+            std::cerr << "[!] Failed to write " << out_path << std::endl;
+            return EVIL_EXIT_SAVE;
+        }
+        df.Print(r, out);
+        if ((out != stdout ? fclose(out) : fflush(out)) != 0) {
+            std::cerr << "[!] Failed to write " << out_path << std::endl;
+            return EVIL_EXIT_SAVE;
+        }
+        if (r.hunks.empty()) { std::cerr << "[+] Same " << r.a_recs << " records" << std::endl; }
+        else {
+            std::cerr << "[+] First divergence at record " << r.hunks[0].a_beg + 1 << " of -a and "
+                      << r.hunks[0].b_beg + 1 << " of -b, " << r.hunks.size() << " hunks ("
+                      << SimdLevel() << ")" << std::endl;
+        }
+        return GOOD_EXIT;
+    }
+
+    std::ifstream in(pairs_path);
+    if (!in) {
+        std::cerr << "[!] Failed to read " << pairs_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+    std::vector<DiffPair> pairs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.size() && line.back() == '\r') { line.pop_back(); }
+        const size_t tab = line.find('\t');
+        if (line.empty() || std::string::npos == tab) { continue; }
+        DiffPair p;
+        p.a_path = line.substr(0, tab);
+        p.b_path = line.substr(tab + 1);
+        p.ok     = false;
+        pairs.push_back(p);
+    }
+    if (out_path.size() && 0 != access(out_path.c_str(), W_OK)) {
+        std::cerr << "[!] Failed to write " << out_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+
+    //a task for each pair, as they take from milliseconds to minutes
+    TaskPool pool(n_thread);
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        pool.Push([&pairs, i, window, anchor, max_hunks, &out_path](unsigned){
+            DiffOne(pairs[i], window, anchor, max_hunks,
+                    out_path.size() ? JoinPath(out_path, std::to_string(i + 1) + ".diff") : "");
+        });
+    }
+    pool.Run();
+
+    int ret = GOOD_EXIT;
+    std::cout << "a,b,records_a,records_b,first_a,first_b,hunks,diff_a,diff_b,status\n";
+    for (const DiffPair &p : pairs) {
+        std::cout << p.row << "\n";
+        if (!p.ok) { std::cerr << "[!] Failed on " << p.a_path << " and " << p.b_path << std::endl; ret = EVIL_EXIT_READ; }
+    }
+    std::cout.flush();
+    return ret;
+}
\ No newline at end of file
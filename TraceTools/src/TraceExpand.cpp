@@ -0,0 +1,322 @@
+#include "tmsg.h"
+#include "trfile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <unordered_map>
+#include <unistd.h>
+
+// Instruction addresses of all blocks, those of block `id`
+// are `Ins[Beg[id]]` to `Ins[Beg[id+1]-1]`. ID 0 is never used.
+struct BlkTable
+{
+    std::vector<uint64_t> Beg;
+    std::vector<uint64_t> Ins;
+};
+
+/**
+ * Load the block table written by TracerCore '-TrScaType ixb'
+ * @param mf the mapped table
+ * @param tab recieves the table
+ * @return false for a malformed table
+ */
+static bool LoadTable(const MappedFile &mf, BlkTable &tab){
+    std::vector<std::pair<uint64_t, uint64_t> > span; //(begin, end) in `tmp` by ID
+    std::vector<uint64_t> tmp;
+    const char* p = mf.Data();
+    const char* end = p + mf.Size();
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        uint64_t id, addr;
+        if (!ParseHexAddr(p, eol, id) || id == 0) { return false; }
+        const uint64_t beg = tmp.size();
+        while (p < eol && *p == ',') {
+            ++p;
+            if (!ParseHexAddr(p, eol, addr)) { return false; }
+            tmp.push_back(addr);
+        }
+        if (id >= span.size()) { span.resize(id + 1, std::make_pair(0, 0)); }
+        span[id] = std::make_pair(beg, tmp.size());
+        p = nl ? nl + 1 : end;
+    }
+    tab.Beg.assign(1, 0);
+    tab.Ins.clear();
+    tab.Ins.reserve(tmp.size());
+    for (size_t id = 1; id < span.size(); ++id) {
+        tab.Beg.push_back(tab.Ins.size());
+        tab.Ins.insert(tab.Ins.end(), tmp.begin() + span[id].first, tmp.begin() + span[id].second);
+    }
+    tab.Beg.push_back(tab.Ins.size());
+    return true;
+}
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceExpand - regenerate instruction-level traces from '-TrScaType ixb'." << std::endl;
+    std::cout << "Usage: TraceExpand -b <table> -i <dat> [-o <dat_out>] [-s <sym> -S <sym_out>]" << std::endl;
+    std::cout << "  -b  Block table, i.e. '-TrBlkPath' of TracerCore." << std::endl;
+    std::cout << "  -i  Trace file of block IDs, i.e. '-TrDatPath' of TracerCore." << std::endl;
+    std::cout << "  -o  Where the instruction-level trace file goes. Default is stdout." << std::endl;
+    std::cout << "  -s  Trace symbol file of the blocks, i.e. '-TrSymPath' of TracerCore." << std::endl;
+    std::cout << "  -S  Where the instruction-level trace symbol file goes." << std::endl;
+}
+
+// Most blocks kept pending at once. Past it, the oldest one is
+// written whole even if its thread may still cut it.
+#define PEND_MAX ((size_t) 65536)
+
+// A block recorded but not written yet
+struct Pending
+{
+    uint64_t    id;
+    uint64_t    n;     //instructions to write
+    bool        done;  //whether it can no longer be cut
+    std::string tid;
+    std::string sec;   //"<section>+" or "" without section info
+    uint64_t    off;
+    std::string name;  //":<routine>" or the whole symbol string
+    bool        off_ok;
+};
+
+// Writes the expanded records. The block recorded lastly by each
+// thread is kept pending, since an "#EXIT" marker of that thread may
+// cut it short afterwards. Blocks are written in the order recorded,
+// once they and all blocks before them can no longer be cut.
+class Expander
+{
+protected:
+    const BlkTable &Tab;
+    FILE*       Dat;
+    FILE*       Sym;
+    std::deque<Pending> Pend;
+    uint64_t    PendHead;  //sequence number of `Pend.front()`
+    std::unordered_map<std::string, uint64_t> Last; //tid => sequence number of its pending block
+
+    /**
+     * Write the first pending block and drop it
+     */
+    void WriteHead(){
+        const Pending &b = Pend.front();
+        const uint64_t* ins = Tab.Ins.data() + Tab.Beg[b.id];
+        const uint64_t base = ins[0];
+        char buf[32];
+        for (uint64_t i = 0; i < b.n; ++i) {
+            int len = snprintf(buf, sizeof(buf), "0x%llx\n", static_cast<unsigned long long>(ins[i]));
+            fwrite(buf, 1, len, Dat);
+            if (!Sym) { continue; }
+            fputs(b.tid.c_str(), Sym);
+            fputc(',', Sym);
+            if (b.off_ok) {
+                fputs(b.sec.c_str(), Sym);
+                fprintf(Sym, "0x%llx", static_cast<unsigned long long>(b.off + ins[i] - base));
+            }
+            fputs(b.name.c_str(), Sym);
+            fputc('\n', Sym);
+        }
+        std::unordered_map<std::string, uint64_t>::iterator it = Last.find(b.tid);
+        if (it != Last.end() && it->second == PendHead) { Last.erase(it); }
+        Pend.pop_front();
+        ++PendHead;
+    }
+
+    /**
+     * Write the pending blocks from the first one till one may still be cut
+     */
+    void WriteDone(){
+        while (Pend.size() && (Pend.front().done || Pend.size() > PEND_MAX)) { WriteHead(); }
+    }
+
+    /**
+     * The pending block of a thread, `NULL` if it has none
+     */
+    Pending* LastOf(const std::string &tid){
+        std::unordered_map<std::string, uint64_t>::iterator it = Last.find(tid);
+        return (it == Last.end()) ? nullptr : &Pend[it->second - PendHead];
+    }
+public:
+    uint64_t Bad;
+
+    Expander(const BlkTable &tab, FILE* dat, FILE* sym)
+        : Tab(tab), Dat(dat), Sym(sym), PendHead(0), Bad(0) {}
+
+    /**
+     * A block entered, with its line in the trace symbol file if any.
+     * Without that file, all blocks count as from one thread.
+     */
+    void Block(uint64_t id, const char* sym_line, size_t sym_len){
+        if (id + 1 >= Tab.Beg.size() || Tab.Beg[id] == Tab.Beg[id + 1]) { ++Bad; return; }
+        Pending b;
+        b.id = id;
+        b.n = Tab.Beg[id + 1] - Tab.Beg[id];
+        b.done = false;
+        b.off = 0;
+        b.off_ok = false;
+        if (Sym) {
+            //"<tid>,<section>+<offset>:<routine>" gives offsets of every instruction
+            const char* comma = static_cast<const char*>(memchr(sym_line, ',', sym_len));
+            const char* s = comma ? comma + 1 : sym_line + sym_len;
+            const char* e = sym_line + sym_len;
+            b.tid.assign(sym_line, comma ? comma : sym_line);
+            const char* plus  = static_cast<const char*>(memchr(s, '+', e - s));
+            const char* colon = static_cast<const char*>(memchr(s, ':', e - s));
+            if (plus && colon && plus < colon) {
+                const char* q = plus + 1;
+                if (ParseHexAddr(q, colon, b.off) && q == colon) {
+                    b.sec.assign(s, plus + 1);
+                    b.name.assign(colon, e);
+                    b.off_ok = true;
+                }
+            }
+            if (!b.off_ok) { b.name.assign(s, e); }
+        }
+        Pending* prev = LastOf(b.tid);
+        if (prev) { prev->done = true; }
+        Last[b.tid] = PendHead + Pend.size();
+        Pend.push_back(b);
+        WriteDone();
+    }
+
+    /**
+     * The pending block of a thread was left right before `ip`.
+     * An address outside the block cuts nothing.
+     * @param tid thread ID as in the trace symbol file
+     * @param ip address of the instruction not executed
+     */
+    void Exit(const std::string &tid, uint64_t ip){
+        Pending* b = LastOf(Sym ? tid : std::string());
+        if (!b) { return; }
+        const uint64_t* ins = Tab.Ins.data() + Tab.Beg[b->id];
+        for (uint64_t i = 0; i < b->n; ++i)
+            { if (ins[i] == ip) { b->n = i; break; } }
+        b->done = true;
+        WriteDone();
+    }
+
+    /**
+     * Write all pending blocks
+     */
+    void FlushAll(){
+        while (Pend.size()) { WriteHead(); }
+    }
+
+    /**
+     * Copy a comment line (like "#TRUNCATED") to the outputs
+     */
+    void Comment(const char* line, size_t len){
+        FlushAll();
+        fwrite(line, 1, len, Dat); fputc('\n', Dat);
+        if (Sym) { fwrite(line, 1, len, Sym); fputc('\n', Sym); }
+    }
+};
+
+/**
+ * Cut the next line out of a buffer, without its line break
+ */
+static bool NextLine(const char* &p, const char* end, const char* &line, size_t &len){
+    if (p >= end) { return false; }
+    const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    const char* eol = nl ? nl : end;
+    line = p;
+    len  = eol - p;
+    if (len && line[len - 1] == '\r') { --len; }
+    p = nl ? nl + 1 : end;
+    return true;
+}
+
+/**
+ * The main procedure of the tool.
+ * Replace each block ID in the trace with the addresses of its
+ * instructions, and cut blocks short at "#EXIT" markers.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string tab_path, dat_path, out_path, sym_path, sym_out;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:i:o:s:S:h")) != -1) {
+        switch (opt) {
+            case 'b': tab_path = optarg; break;
+            case 'i': dat_path = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 's': sym_path = optarg; break;
+            case 'S': sym_out  = optarg; break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if (tab_path.size() == 0 || dat_path.size() == 0 ||
+            (sym_path.size() == 0) != (sym_out.size() == 0)) {
+        disp_usage();
+        std::cout << "[!] Need -b, -i, and -s together with -S" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    MappedFile mtab, mdat, msym;
+    BlkTable tab;
+    if (!mtab.Open(tab_path) || !LoadTable(mtab, tab)) {
+        std::cerr << "[!] Bad block table " << tab_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+    mtab.Close();
+    if (!mdat.Open(dat_path) || (sym_path.size() && !msym.Open(sym_path))) {
+        std::cerr << "[!] Failed to map " << dat_path << " or " << sym_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+
+    FILE* dat = stdout;
+    FILE* sym = nullptr;
+    if (out_path.size() && !(dat = fopen(out_path.c_str(), "w"))) {
+        std::cerr << "[!] Failed to write " << out_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    if (sym_out.size() && !(sym = fopen(sym_out.c_str(), "w"))) {
+        std::cerr << "[!] Failed to write " << sym_out << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    static char dat_buf[1 << 20], sym_buf[1 << 20];
+    setvbuf(dat, dat_buf, _IOFBF, sizeof(dat_buf));
+    if (sym) { setvbuf(sym, sym_buf, _IOFBF, sizeof(sym_buf)); }
+
+    //each line of TrDat has its own line in TrSym, markers included
+    Expander ex(tab, dat, sym);
+    const char* p = mdat.Data();
+    const char* p_end = p + mdat.Size();
+    const char* q = msym.Data();
+    const char* q_end = q + msym.Size();
+    const char* line; size_t len;
+    const char* sline = ""; size_t slen = 0;
+    while (NextLine(p, p_end, line, len)) {
+        if (sym && !NextLine(q, q_end, sline, slen)) { sline = ""; slen = 0; }
+        if (len == 0) { continue; }
+        if (line[0] == '#') {
+            //"#EXIT <tid> <address>"
+            const char* t = line + 6;
+            const char* sp = (len > 6) ? static_cast<const char*>(memchr(t, ' ', line + len - t)) : nullptr;
+            const char* s = sp ? sp + 1 : t;
+            uint64_t ip;
+            if (sp && 0 == memcmp(line, "#EXIT ", 6) && ParseHexAddr(s, line + len, ip) && s == line + len)
+                { ex.Exit(std::string(t, sp), ip); }
+            else { ex.Comment(line, len); }
+            continue;
+        }
+        const char* s = line;
+        uint64_t id;
+        if (ParseHexAddr(s, line + len, id)) { ex.Block(id, sline, slen); }
+    }
+    ex.FlushAll();
+
+    if (ex.Bad) { std::cerr << "[!] " << ex.Bad << " records have no block in the table" << std::endl; }
+    bool ok = (0 == ferror(dat)) && (!sym || 0 == ferror(sym));
+    if (sym) { ok = (0 == fclose(sym)) && ok; }
+    if (dat != stdout) { ok = (0 == fclose(dat)) && ok; } else { ok = (0 == fflush(dat)) && ok; }
+    if (!ok) {
+        std::cerr << "[!] Failed to write the outputs" << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    return GOOD_EXIT;
+}
\ No newline at end of file
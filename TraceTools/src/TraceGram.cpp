@@ -0,0 +1,167 @@
+#include "tmsg.h"
+#include "grammar.h"
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceGram - compact traces into a shared grammar, expand or count them." << std::endl;
+    std::cout << "Usage: TraceGram -c -i <dat|dir_dat> -o <gram> [-u]" << std::endl;
+    std::cout << "       TraceGram -x -i <gram> [-f <name>] [-o <dat|dir_out>]" << std::endl;
+    std::cout << "       TraceGram -q -i <gram> [-f <name>] [-a <address>]..." << std::endl;
+    std::cout << "  -c  Compact a trace file, or all traces under a directory, into one grammar." << std::endl;
+    std::cout << "  -u  With -c, keep the traces of an existing grammar at -o and reuse its rules." << std::endl;
+    std::cout << "  -x  Expand traces. With -f, one trace goes to -o or stdout,"
+                 " otherwise all traces go under the directory -o." << std::endl;
+    std::cout << "  -q  Print \"trace,lines\" of each trace, plus a column of the count of each -a,"
+                 " without expanding them." << std::endl;
+    std::cout << "  -f  Name of a trace inside the grammar, as listed by -q." << std::endl;
+    std::cout << "  -a  An address (i.e. a line of TrDat) to count." << std::endl;
+}
+
+/**
+ * Create a directory and its parents, like `mkdir -p`
+ */
+static bool MakeDirs(const std::string &dir){
+    for (size_t i = 1; i <= dir.size(); ++i) {
+        if (i < dir.size() && dir[i] != '/') { continue; }
+        const std::string part = dir.substr(0, i);
+        if (0 != mkdir(part.c_str(), 0755) && errno != EEXIST) { return false; }
+    }
+    return true;
+}
+
+/**
+ * Write one trace into a file, or stdout for ""
+ */
+static bool ExpandTo(const GramReader &rd, size_t i, const std::string &path){
+    FILE* out = stdout;
+    if (path.size() && !(out = fopen(path.c_str(), "w"))) { return false; }
+    static char buf[1 << 20];
+    setvbuf(out, buf, _IOFBF, sizeof(buf));
+    bool ok = rd.Expand(i, out);
+    if (out != stdout) { ok = (0 == fclose(out)) && ok; } else { ok = (0 == fflush(out)) && ok; }
+    return ok;
+}
+
+/**
+ * The main procedure of the tool.
+ * Traces are split into lines, and each distinct line is a terminal
+ * of the grammar, so any line-based output of TracerCore (TrSym too)
+ * comes back byte for byte.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string in_path, out_path, name;
+    std::vector<std::string> addrs;
+    char mode = 0;
+    bool update = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "cxqui:o:f:a:h")) != -1) {
+        switch (opt) {
+            case 'c': case 'x': case 'q': mode = static_cast<char>(opt); break;
+            case 'u': update   = true; break;
+            case 'i': in_path  = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'f': name     = optarg; break;
+            case 'a': addrs.push_back(HexStr(strtoull(optarg, nullptr, 16))); break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if (mode == 0 || in_path.size() == 0 || (mode == 'c' && out_path.size() == 0) ||
+            (mode == 'x' && name.size() == 0 && out_path.size() == 0)) {
+        disp_usage();
+        std::cout << "[!] Need one of -c -x -q, -i, and -o for -c or for -x without -f" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    if (mode == 'c') {
+        GramBuilder gb;
+        if (update && 0 == access(out_path.c_str(), F_OK) && !gb.Load(out_path)) {
+            std::cerr << "[!] Bad grammar " << out_path << std::endl;
+            return EVIL_EXIT_READ;
+        }
+        struct stat st;
+        if (0 != stat(in_path.c_str(), &st)) {
+            std::cerr << "[!] Failed to read " << in_path << std::endl;
+            return EVIL_EXIT_READ;
+        }
+        std::vector<std::string> files;
+        if (S_ISDIR(st.st_mode)) { ListFiles(in_path, files); }
+        else {
+            const size_t slash = in_path.rfind('/');
+            files.push_back(in_path.substr(std::string::npos == slash ? 0 : slash + 1));
+            in_path = in_path.substr(0, std::string::npos == slash ? 0 : slash);
+        }
+        for (const std::string &rel : files) {
+            if (!gb.AddFile(rel, JoinPath(in_path, rel))) {
+                std::cerr << "[!] Failed to read " << JoinPath(in_path, rel) << std::endl;
+                return EVIL_EXIT_READ;
+            }
+        }
+        gb.Build();
+        if (!gb.Save(out_path)) {
+            std::cerr << "[!] Failed to write " << out_path << std::endl;
+            return EVIL_EXIT_SAVE;
+        }
+        GramReader rd;
+        if (rd.Open(out_path)) {
+            std::cout << "[+] " << rd.FileCount() << " traces, " << rd.TermCount() << " distinct lines, "
+                      << rd.RuleCount() << " rules" << std::endl;
+        }
+        return GOOD_EXIT;
+    }
+
+    GramReader rd;
+    if (!rd.Open(in_path)) {
+        std::cerr << "[!] Bad grammar " << in_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+    std::vector<size_t> which;
+    if (name.size()) {
+        const size_t i = rd.FindFile(name);
+        if (i == rd.FileCount()) {
+            std::cerr << "[!] No trace named " << name << std::endl;
+            return EVIL_EXIT_MISS;
+        }
+        which.push_back(i);
+    } else {
+        for (size_t i = 0; i < rd.FileCount(); ++i) { which.push_back(i); }
+    }
+
+    if (mode == 'x') {
+        for (size_t i : which) {
+            std::string path = out_path;
+            if (name.size() == 0) {
+                path = JoinPath(out_path, rd.FileName(i));
+                const size_t slash = path.rfind('/');
+                if (std::string::npos != slash && !MakeDirs(path.substr(0, slash))) { path.clear(); }
+            }
+            if ((name.size() == 0 && path.size() == 0) || !ExpandTo(rd, i, path)) {
+                std::cerr << "[!] Failed to write " << rd.FileName(i) << std::endl;
+                return EVIL_EXIT_SAVE;
+            }
+        }
+        return GOOD_EXIT;
+    }
+
+    std::vector<std::vector<uint64_t> > counts(addrs.size());
+    for (size_t k = 0; k < addrs.size(); ++k) { rd.Occurrences(addrs[k], counts[k]); }
+    std::cout << "trace,lines";
+    for (const std::string &a : addrs) { std::cout << "," << a; }
+    std::cout << "\n";
+    for (size_t i : which) {
+        std::cout << CsvQuote(rd.FileName(i)) << "," << rd.Lines(i);
+        for (size_t k = 0; k < addrs.size(); ++k) { std::cout << "," << counts[k][i]; }
+        std::cout << "\n";
+    }
+    std::cout.flush();
+    return GOOD_EXIT;
+}
\ No newline at end of file
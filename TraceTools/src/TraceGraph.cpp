@@ -0,0 +1,146 @@
+#include "tmsg.h"
+#include "trfile.h"
+#include "cgraph.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unistd.h>
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceGraph - export a call graph made by TracerCore '-TrScaType cg'." << std::endl;
+    std::cout << "Usage: TraceGraph -i <graph> [-o <output>] [-f dot|json] [-m <count>]" << std::endl;
+    std::cout << "  -i  Path of the call graph, i.e. '-TrDatPath' of TracerCore." << std::endl;
+    std::cout << "  -o  Path of the output file. Default is stdout." << std::endl;
+    std::cout << "  -f  Format of the output. Default is dot." << std::endl;
+    std::cout << "  -m  Skip edges called fewer times than this. Default is 1." << std::endl;
+    std::cout << "DOT merges the call sites of a caller-callee pair, JSON keeps each of them." << std::endl;
+}
+
+/**
+ * Name of a routine for output, its address if no symbol is known
+ */
+static std::string RtnName(const CgRtn &r, const char* strs){
+    if (r.str_len) { return std::string(strs + r.str_off, r.str_len); }
+    return HexStr(r.addr);
+}
+
+/**
+ * The main procedure of the tool.
+ * Check the call-graph file and write it as DOT or JSON.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string in_path, out_path, fmt = "dot";
+    uint64_t min_count = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:f:m:h")) != -1) {
+        switch (opt) {
+            case 'i': in_path   = optarg; break;
+            case 'o': out_path  = optarg; break;
+            case 'f': fmt       = optarg; break;
+            case 'm': min_count = strtoull(optarg, nullptr, 10); break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if (in_path.size() == 0 || (fmt != "dot" && fmt != "json")) {
+        disp_usage();
+        std::cout << "[!] Need -i and a valid -f" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    MappedFile mf;
+    if (!mf.Open(in_path) || mf.Size() < sizeof(CgHead)) {
+        std::cerr << "[!] Failed to map " << in_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+    CgHead head;
+    memcpy(&head, mf.Data(), sizeof(head));
+    const uint64_t need = sizeof(CgHead) + (uint64_t) head.n_rtn * sizeof(CgRtn)
+                        + head.n_edge * sizeof(CgEdge) + head.str_len;
+    if (0 != memcmp(head.magic, CG_MAGIC, sizeof(head.magic)) ||
+            head.version != CG_VERSION || need != mf.Size()) {
+        std::cerr << "[!] Bad call graph " << in_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+    const CgRtn*  rtns  = reinterpret_cast<const CgRtn*>(mf.Data() + sizeof(CgHead));
+    const CgEdge* edges = reinterpret_cast<const CgEdge*>(rtns + head.n_rtn);
+    const char*   strs  = reinterpret_cast<const char*>(edges + head.n_edge);
+    for (uint64_t i = 0; i < head.n_rtn; ++i) {
+        if ((uint64_t) rtns[i].str_off + rtns[i].str_len > head.str_len) {
+            std::cerr << "[!] Bad call graph " << in_path << std::endl;
+            return EVIL_EXIT_READ;
+        }
+    }
+    for (uint64_t i = 0; i < head.n_edge; ++i) {
+        if ((edges[i].caller != CG_NO_RTN && edges[i].caller >= head.n_rtn) ||
+                edges[i].callee >= head.n_rtn) {
+            std::cerr << "[!] Bad call graph " << in_path << std::endl;
+            return EVIL_EXIT_READ;
+        }
+    }
+
+    std::ofstream ofs;
+    if (out_path.size()) {
+        ofs.open(out_path.c_str(), std::ios::out|std::ios::trunc);
+        if (!ofs.is_open()) {
+            std::cerr << "[!] Failed to write " << out_path << std::endl;
+            return EVIL_EXIT_SAVE;
+        }
+    }
+    std::ostream &os = out_path.size() ? ofs : std::cout;
+
+    if (fmt == "dot") {
+        //(caller, callee) => (calls, sites)
+        std::map<std::pair<uint32_t, uint32_t>, std::pair<uint64_t, uint64_t> > pairs;
+        for (uint64_t i = 0; i < head.n_edge; ++i) {
+            std::pair<uint64_t, uint64_t> &v = pairs[std::make_pair(edges[i].caller, edges[i].callee)];
+            v.first += edges[i].count;
+            ++v.second;
+        }
+        os << "digraph callgraph {\n";
+        os << "  node [shape=box];\n";
+        os << "  \"?\" [label=\"<unknown>\", style=dashed];\n";
+        for (uint64_t i = 0; i < head.n_rtn; ++i)
+            { os << "  r" << i << " [label=" << Quote(RtnName(rtns[i], strs)) << "];\n"; }
+        for (const auto &kv : pairs) {
+            if (kv.second.first < min_count) { continue; }
+            if (kv.first.first == CG_NO_RTN) { os << "  \"?\""; }
+            else { os << "  r" << kv.first.first; }
+            os << " -> r" << kv.first.second << " [label=\"" << kv.second.first;
+            if (kv.second.second > 1) { os << " (" << kv.second.second << " sites)"; }
+            os << "\"];\n";
+        }
+        os << "}\n";
+    } else {
+        os << "{\"routines\":[";
+        for (uint64_t i = 0; i < head.n_rtn; ++i) {
+            os << (i ? ",\n" : "\n") << "{\"id\":" << i << ",\"addr\":\"" << HexStr(rtns[i].addr)
+               << "\",\"name\":" << Quote(RtnName(rtns[i], strs)) << "}";
+        }
+        os << "\n],\"edges\":[";
+        bool first = true;
+        for (uint64_t i = 0; i < head.n_edge; ++i) {
+            if (edges[i].count < min_count) { continue; }
+            os << (first ? "\n" : ",\n") << "{\"caller\":";
+            if (edges[i].caller == CG_NO_RTN) { os << "null"; } else { os << edges[i].caller; }
+            os << ",\"callee\":" << edges[i].callee << ",\"site\":\"" << HexStr(edges[i].site)
+               << "\",\"count\":" << edges[i].count << "}";
+            first = false;
+        }
+        os << "\n]}\n";
+    }
+    os.flush();
+    if (!os.good()) {
+        std::cerr << "[!] Failed to write " << (out_path.size() ? out_path : "stdout") << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    return GOOD_EXIT;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "tmsg.h"
+#include "index.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceIndex - build or update the inverted index of a trace directory." << std::endl;
+    std::cout << "Usage: TraceIndex -d <dir_dat> [-s <dir_sym>] -o <index> [-j <threads>]" << std::endl;
+    std::cout << "  -d  Directory of trace files (`dir_dat` of CoreLauncher)." << std::endl;
+    std::cout << "  -s  Directory of trace symbol files (`dir_sym` of CoreLauncher)."
+                 " Routine names are indexed only when it is given." << std::endl;
+    std::cout << "  -o  Path of the index file. An existing index will be updated"
+                 " and only new or changed traces are parsed." << std::endl;
+    std::cout << "  -j  Number of parsing threads. Default is the number of cores." << std::endl;
+}
+
+/**
+ * Whether a stamp equals the one recorded in the index
+ */
+static bool SameStamp(const FileStamp &a, const FileStamp &b){
+    return a.fsize == b.fsize && a.mtime == b.mtime;
+}
+
+/**
+ * The main procedure of the tool.
+ * Parse new or changed traces under a trace directory and
+ * write the merged inverted index.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string dir_dat, dir_sym, idx_path;
+    unsigned n_thread = std::thread::hardware_concurrency();
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:o:j:h")) != -1) {
+        switch (opt) {
+            case 'd': dir_dat  = optarg; break;
+            case 's': dir_sym  = optarg; break;
+            case 'o': idx_path = optarg; break;
+            case 'j': n_thread = static_cast<unsigned>(atoi(optarg)); break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if (dir_dat.size() == 0 || idx_path.size() == 0) {
+        disp_usage();
+        std::cout << "[!] Both -d and -o are required" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+    if (n_thread == 0) { n_thread = 1; }
+
+    IndexBuilder builder;
+    if (0 == access(idx_path.c_str(), F_OK) && !builder.Load(idx_path)) {
+        std::cout << "[!] Bad index file " << idx_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+
+    //find out which traces are new or changed since last time
+    std::vector<std::string> files;
+    ListFiles(dir_dat, files);
+    std::unordered_map<std::string, size_t> now;
+    std::vector<InputEntry> todo;
+    for (const std::string &rel : files) {
+        InputEntry e;
+        e.path = rel;
+        e.sym.fsize = e.sym.mtime = 0;
+        if (!GetFileStamp(JoinPath(dir_dat, rel), e.dat)) { continue; }
+        if (dir_sym.size() && !GetFileStamp(JoinPath(dir_sym, rel), e.sym))
+            { e.sym.fsize = e.sym.mtime = 0; }
+        now[rel] = todo.size();
+        todo.push_back(e);
+    }
+
+    const std::vector<InputEntry> &old = builder.GetInputs();
+    std::vector<bool> dead(old.size(), false);
+    std::vector<bool> keep(todo.size(), false);
+    for (size_t i = 0; i < old.size(); ++i) {
+        auto it = now.find(old[i].path);
+        if (it != now.end() && SameStamp(old[i].dat, todo[it->second].dat)
+                            && SameStamp(old[i].sym, todo[it->second].sym))
+            { keep[it->second] = true; }
+        else { dead[i] = true; }
+    }
+    builder.DropInputs(dead);
+
+    std::vector<InputEntry> fresh;
+    for (size_t i = 0; i < todo.size(); ++i)
+        { if (!keep[i]) { fresh.push_back(todo[i]); } }
+
+    //parse in parallel, but add in order so input IDs are stable
+    std::vector<InputKeys> keys(fresh.size());
+    std::vector<char> good(fresh.size(), 0);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++; i < fresh.size(); i = next++) {
+            std::string sym_path;
+            if (fresh[i].sym.fsize || fresh[i].sym.mtime)
+                { sym_path = JoinPath(dir_sym, fresh[i].path); }
+            good[i] = CollectInputKeys(JoinPath(dir_dat, fresh[i].path), sym_path, keys[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < n_thread; ++t) { pool.push_back(std::thread(work)); }
+    for (std::thread &t : pool) { t.join(); }
+
+    size_t n_add = 0;
+    for (size_t i = 0; i < fresh.size(); ++i) {
+        if (!good[i]) {
+            std::cout << "[!] Skip unreadable trace " << fresh[i].path << std::endl;
+            continue;
+        }
+        builder.AddInput(fresh[i], keys[i]);
+        keys[i] = InputKeys();
+        ++n_add;
+    }
+
+    if (!builder.Save(idx_path)) {
+        std::cout << "[!] Failed to write " << idx_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    std::cout << "[+] " << builder.GetInputs().size() << " inputs indexed ("
+              << n_add << " parsed, "
+              << builder.GetInputs().size() - n_add << " reused)" << std::endl;
+    return GOOD_EXIT;
+}
\ No newline at end of file
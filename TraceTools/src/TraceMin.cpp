@@ -0,0 +1,244 @@
+#include "tmsg.h"
+#include "trfile.h"
+#include "index.h"
+#include "cover.h"
+#include "pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <unistd.h>
+
+#define KEY_SHARDS ((size_t) 64)
+
+// Dense IDs of keys (block addresses or edges) shared by all workers.
+// IDs are dense so that the covered keys fit in one plain bitmap.
+struct KeyIds
+{
+    struct Shard
+    {
+        std::mutex                             lock;
+        std::unordered_map<uint64_t, uint32_t> ids;
+    };
+    Shard                 shards[KEY_SHARDS];
+    std::atomic<uint32_t> next;
+    KeyIds() : next(0) {}
+};
+
+static inline size_t ShardOf(uint64_t key){
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 58) % KEY_SHARDS;
+}
+
+/**
+ * Key of the edge between two records in a row
+ */
+static inline uint64_t EdgeKey(uint64_t from, uint64_t to){
+    uint64_t h = from * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+    return (h ^ to) * 0xBF58476D1CE4E5B9ULL;
+}
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceMin - keep a minimal set of inputs with the same coverage." << std::endl;
+    std::cout << "Usage: TraceMin (-d <dir_dat> [-e] | -x <index>) -o <list> [-u] [-j <threads>]" << std::endl;
+    std::cout << "  -d  Directory of traces, each a line-based TrDat like those of 'bbl'." << std::endl;
+    std::cout << "  -e  With -d, cover the edges between records in a row rather than records." << std::endl;
+    std::cout << "  -x  An index made by TraceIndex, covering the addresses indexed." << std::endl;
+    std::cout << "  -o  Where the kept inputs go, one path relative to the traces a line,"
+                 " as 'src_list' of TConsole's CoreLauncher takes." << std::endl;
+    std::cout << "  -u  Count every input as the same cost, rather than by the size of its TrDat." << std::endl;
+    std::cout << "  -j  Number of worker threads. Default is the number of cores." << std::endl;
+}
+
+/**
+ * Read the keys of a trace into a set
+ * @param path path of the TrDat
+ * @param edge cover edges rather than records
+ * @param keys dense IDs of keys, new keys are added
+ * @param set receives the keys
+ * @param fsize receives the size of the TrDat
+ * @return false if the file can not be read
+ */
+static bool LoadDat(const std::string &path, bool edge, KeyIds &keys, CovSet &set, uint64_t &fsize){
+    MappedFile mf;
+    if (!mf.Open(path)) { return false; }
+    fsize = mf.Size();
+    std::vector<uint64_t> raw;
+    const char* p   = mf.Data();
+    const char* end = p + mf.Size();
+    uint64_t addr, prev = 0;
+    while (ParseDatLine(p, end, addr)) {
+        raw.push_back(edge ? EdgeKey(prev, addr) : addr);
+        prev = addr;
+    }
+    mf.Close();
+    std::sort(raw.begin(), raw.end());
+    raw.erase(std::unique(raw.begin(), raw.end()), raw.end());
+
+    //group keys by shard, so each shard is locked once for the file
+    std::vector<size_t> beg(KEY_SHARDS + 1, 0);
+    for (uint64_t k : raw) { ++beg[ShardOf(k) + 1]; }
+    for (size_t s = 0; s < KEY_SHARDS; ++s) { beg[s + 1] += beg[s]; }
+    std::vector<uint64_t> grouped(raw.size());
+    std::vector<size_t> pos(beg.begin(), beg.end() - 1);
+    for (uint64_t k : raw) { grouped[pos[ShardOf(k)]++] = k; }
+    std::vector<uint32_t> ids;
+    ids.reserve(raw.size());
+    for (size_t s = 0; s < KEY_SHARDS; ++s) {
+        if (beg[s] == beg[s + 1]) { continue; }
+        std::lock_guard<std::mutex> guard(keys.shards[s].lock);
+        for (size_t i = beg[s]; i < beg[s + 1]; ++i) {
+            auto it = keys.shards[s].ids.emplace(grouped[i], 0);
+            if (it.second) { it.first->second = keys.next++; }
+            ids.push_back(it.first->second);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    set.Build(ids);
+    return true;
+}
+
+/**
+ * Turn the posting lists of an index into a set of each input.
+ * Addresses are walked in order, so their positions are the dense IDs
+ * and each set gets them in order.
+ */
+static void LoadIndex(const IndexReader &rd, std::vector<CovSet> &sets,
+                      std::vector<uint64_t> &fsizes, std::vector<std::string> &paths)
+{
+    sets.assign(rd.NumInputs(), CovSet());
+    for (uint32_t i = 0; i < rd.NumInputs(); ++i) {
+        paths.push_back(rd.InputPath(i));
+        fsizes.push_back(rd.InputDat(i).fsize);
+    }
+    std::vector<uint32_t> ids;
+    for (uint32_t k = 0; k < rd.NumAddrs(); ++k) {
+        rd.AddrAt(k, ids);
+        for (uint32_t id : ids) { if (id < sets.size()) { sets[id].Append(k); } }
+    }
+    for (CovSet &s : sets) { s.Shrink(); }
+}
+
+/**
+ * Drop inputs with the same coverage as a cheaper one. Corpora of
+ * fuzzers are full of them, and the greedy pass never needs them.
+ * @return number of inputs dropped
+ */
+static size_t DropDups(std::vector<CovSet> &sets, const std::vector<double> &weights, unsigned n_thread){
+    std::vector<uint64_t> hash(sets.size());
+    TaskPool pool(n_thread);
+    const size_t step = sets.size() / (pool.Size() * 8) + 1;
+    for (size_t beg = 0; beg < sets.size(); beg += step) {
+        pool.Push([&sets, &hash, beg, step](unsigned){
+            for (size_t i = beg; i < std::min(sets.size(), beg + step); ++i) { hash[i] = sets[i].Hash(); }
+        });
+    }
+    pool.Run();
+    std::vector<uint32_t> order(sets.size());
+    for (uint32_t i = 0; i < order.size(); ++i) { order[i] = i; }
+    std::sort(order.begin(), order.end(), [&hash, &weights](uint32_t x, uint32_t y){
+        if (hash[x] != hash[y]) { return hash[x] < hash[y]; }
+        if (weights[x] != weights[y]) { return weights[x] < weights[y]; }
+        return x < y;
+    });
+    size_t n_drop = 0;
+    for (size_t i = 0; i < order.size(); ) {
+        size_t j = i + 1;
+        while (j < order.size() && hash[order[j]] == hash[order[i]]) { ++j; }
+        //the cheapest of each distinct set in the run is kept
+        for (size_t a = i; a < j; ++a) {
+            if (0 == sets[order[a]].Size()) { continue; }
+            for (size_t b = a + 1; b < j; ++b) {
+                if (sets[order[b]].Size() && sets[order[b]] == sets[order[a]])
+                    { sets[order[b]] = CovSet(); ++n_drop; }
+            }
+        }
+        i = j;
+    }
+    return n_drop;
+}
+
+/**
+ * The main procedure of the tool.
+ * Coverage of each input is read from its cheap outputs of TracerCore,
+ * and a greedy weighted set cover keeps the inputs which reach all the
+ * keys reached by the whole corpus, at a low total cost.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string dir_dat, idx_path, out_path;
+    bool edge = false, unit = false;
+    unsigned n_thread = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:ex:o:uj:h")) != -1) {
+        switch (opt) {
+            case 'd': dir_dat  = optarg; break;
+            case 'e': edge     = true; break;
+            case 'x': idx_path = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'u': unit     = true; break;
+            case 'j': n_thread = static_cast<unsigned>(atoi(optarg)); break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if ((dir_dat.size() == 0) == (idx_path.size() == 0) || out_path.size() == 0 || (edge && idx_path.size())) {
+        disp_usage();
+        std::cout << "[!] Need -o and either -d or -x, and -e only works with -d" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    std::vector<CovSet>      sets;
+    std::vector<uint64_t>    fsizes;
+    std::vector<std::string> paths;
+    KeyIds keys;
+    uint64_t n_key = 0;
+    if (dir_dat.size()) {
+        ListFiles(dir_dat, paths);
+        sets.resize(paths.size());
+        fsizes.assign(paths.size(), 0);
+        std::vector<char> ok(paths.size(), 0);
+        TaskPool pool(n_thread);
+        for (size_t i = 0; i < paths.size(); ++i) {
+            pool.Push([&, i](unsigned){ ok[i] = LoadDat(JoinPath(dir_dat, paths[i]), edge, keys, sets[i], fsizes[i]); });
+        }
+        pool.Run();
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (!ok[i]) { std::cerr << "[!] Failed to read " << JoinPath(dir_dat, paths[i]) << std::endl; return EVIL_EXIT_READ; }
+        }
+        n_key = keys.next;
+    } else {
+        IndexReader rd;
+        if (!rd.Open(idx_path)) {
+            std::cerr << "[!] Bad index " << idx_path << std::endl;
+            return EVIL_EXIT_READ;
+        }
+        LoadIndex(rd, sets, fsizes, paths);
+        n_key = rd.NumAddrs();
+    }
+
+    std::vector<double> weights(sets.size());
+    for (size_t i = 0; i < sets.size(); ++i) { weights[i] = unit ? 1.0 : static_cast<double>(std::max<uint64_t>(fsizes[i], 1)); }
+    const size_t n_dup = DropDups(sets, weights, n_thread);
+    std::vector<uint32_t> picked;
+    const uint64_t n_cov = GreedyCover(sets, weights, n_thread, picked);
+
+    std::ofstream out(out_path);
+    for (uint32_t i : picked) { out << paths[i] << "\n"; }
+    out.close();
+    if (!out) {
+        std::cerr << "[!] Failed to write " << out_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    std::cout << "[+] Keep " << picked.size() << " of " << sets.size() << " inputs ("
+              << n_dup << " with duplicate coverage), covering " << n_cov << " of " << n_key
+              << (edge ? " edges" : " keys") << std::endl;
+    return GOOD_EXIT;
+}
\ No newline at end of file
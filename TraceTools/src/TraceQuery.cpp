@@ -0,0 +1,76 @@
+#include "tmsg.h"
+#include "index.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <unistd.h>
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceQuery - find the inputs which hit some blocks or routines." << std::endl;
+    std::cout << "Usage: TraceQuery -i <index> [-a <address>]... [-r <routine>]... [-c]" << std::endl;
+    std::cout << "  -i  Path of the index file made by TraceIndex." << std::endl;
+    std::cout << "  -a  Address of a block (or a routine in 'cal' traces), like 0x401a2b." << std::endl;
+    std::cout << "  -r  Name of a routine, case sensitive." << std::endl;
+    std::cout << "  -c  Only print the number of matched inputs." << std::endl;
+    std::cout << "When several -a/-r are given, inputs hitting ALL of them are printed." << std::endl;
+}
+
+/**
+ * The main procedure of the tool.
+ * Look up the inputs which hit every given block or routine
+ * in an index file and print their relative paths.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string idx_path;
+    std::vector<uint64_t> addrs;
+    std::vector<std::string> names;
+    bool count_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:a:r:ch")) != -1) {
+        switch (opt) {
+            case 'i': idx_path = optarg; break;
+            case 'a': addrs.push_back(strtoull(optarg, nullptr, 16)); break;
+            case 'r': names.push_back(optarg); break;
+            case 'c': count_only = true; break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if (idx_path.size() == 0 || (addrs.size() + names.size()) == 0) {
+        disp_usage();
+        std::cout << "[!] Need -i and at least one -a or -r" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    IndexReader reader;
+    if (!reader.Open(idx_path)) {
+        std::cout << "[!] Bad index file " << idx_path << std::endl;
+        return EVIL_EXIT_READ;
+    }
+
+    std::vector<uint32_t> hits, ids, tmp;
+    bool first = true;
+    auto meet = [&]() {
+        if (first) { hits.swap(ids); first = false; return; }
+        tmp.clear();
+        std::set_intersection(hits.begin(), hits.end(), ids.begin(), ids.end(),
+                              std::back_inserter(tmp));
+        hits.swap(tmp);
+    };
+    for (uint64_t a : addrs) { reader.FindAddr(a, ids); meet(); }
+    for (const std::string &n : names) { reader.FindName(n, ids); meet(); }
+
+    if (count_only) { std::cout << hits.size() << std::endl; }
+    else {
+        for (uint32_t id : hits)
+            { std::cout << reader.InputPath(id) << '\n'; }
+        std::cout.flush();
+    }
+    return hits.size() ? GOOD_EXIT : EVIL_EXIT_MISS;
+}
\ No newline at end of file
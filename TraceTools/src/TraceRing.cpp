@@ -0,0 +1,118 @@
+#include "tmsg.h"
+#include "trfile.h"
+#include "ringread.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceRing - stream records out of the shared-memory rings of TracerCore." << std::endl;
+    std::cout << "Usage: TraceRing -n <name> [-o <dat>] [-s <sym>] [-b] [-w <sec>] [-k]" << std::endl;
+    std::cout << "  -n  Name of the segment, i.e. <name> in '-TrDatPath shm:<name>'." << std::endl;
+    std::cout << "  -o  Where records go, like a trace file. Default is stdout." << std::endl;
+    std::cout << "  -s  Also write a trace symbol file here." << std::endl;
+    std::cout << "  -b  Write raw binary records instead of text." << std::endl;
+    std::cout << "  -w  Seconds to wait for TracerCore to create the segment. Default is 10." << std::endl;
+    std::cout << "  -k  Keep the segment after TracerCore finishes. Default is to remove it." << std::endl;
+}
+
+/**
+ * The main procedure of the tool.
+ * Attach to the rings, drain them until TracerCore finishes (or
+ * its process is gone) and write the records out in the format
+ * of TrDat/TrSym files.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string name, dat_path, sym_path;
+    bool binary = false, keep = false;
+    unsigned wait_sec = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:s:w:bkh")) != -1) {
+        switch (opt) {
+            case 'n': name     = optarg; break;
+            case 'o': dat_path = optarg; break;
+            case 's': sym_path = optarg; break;
+            case 'w': wait_sec = static_cast<unsigned>(atoi(optarg)); break;
+            case 'b': binary   = true; break;
+            case 'k': keep     = true; break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if (name.size() == 0) {
+        disp_usage();
+        std::cout << "[!] -n is required" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    FILE* dat = stdout;
+    FILE* sym = nullptr;
+    if (dat_path.size() && !(dat = fopen(dat_path.c_str(), binary ? "wb" : "w"))) {
+        std::cerr << "[!] Failed to write " << dat_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    if (sym_path.size() && !(sym = fopen(sym_path.c_str(), "w"))) {
+        std::cerr << "[!] Failed to write " << sym_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+
+    RingReader reader;
+    if (!reader.Attach(name, wait_sec)) {
+        std::cerr << "[!] No ring named " << name << std::endl;
+        return EVIL_EXIT_READ;
+    }
+
+    auto emit = [&](const RingRec* recs, size_t n) {
+        if (binary) { fwrite(recs, sizeof(RingRec), n, dat); }
+        else {
+            for (size_t i = 0; i < n; ++i) {
+                if (SHM_SYM_TRUNC == recs[i].sym) { fprintf(dat, "#TRUNCATED events=%llu\n", static_cast<unsigned long long>(recs[i].addr)); }
+                else if (SHM_SYM_EXIT == recs[i].sym) { fprintf(dat, "#EXIT 0x%x 0x%llx\n", recs[i].tid, static_cast<unsigned long long>(recs[i].addr)); }
+                else { fprintf(dat, "0x%llx\n", static_cast<unsigned long long>(recs[i].addr)); }
+            }
+        }
+        if (!sym) { return; }
+        for (size_t i = 0; i < n; ++i) {
+            if (SHM_SYM_TRUNC == recs[i].sym) {
+                fprintf(sym, "#TRUNCATED events=%llu\n", static_cast<unsigned long long>(recs[i].addr));
+                continue;
+            }
+            if (SHM_SYM_EXIT == recs[i].sym) {
+                fprintf(sym, "#EXIT 0x%x 0x%llx\n", recs[i].tid, static_cast<unsigned long long>(recs[i].addr));
+                continue;
+            }
+            const char* s = ""; size_t s_len = 0;
+            reader.SymName(recs[i].sym, s, s_len);
+            fprintf(sym, "0x%x,%.*s\n", recs[i].tid, static_cast<int>(s_len), s);
+        }
+    };
+
+    unsigned idle_us = 50;
+    while (true) {
+        bool closed = reader.Closed();
+        bool dead = !closed && !reader.Alive();
+        if (reader.Poll(emit)) { idle_us = 50; continue; }
+        if (closed) { break; }
+        if (dead) {
+            std::cerr << "[!] TracerCore " << reader.Pid() << " is gone without closing the rings" << std::endl;
+            break;
+        }
+        usleep(idle_us);
+        if (idle_us < 2000) { idle_us *= 2; }
+    }
+
+    if (reader.Drops() || reader.Lost()) {
+        std::cerr << "[!] " << reader.Drops() << " records dropped, "
+                  << reader.Lost() << " records lost" << std::endl;
+    }
+    if (!keep) { reader.Unlink(); }
+    if (sym) { fclose(sym); }
+    if (dat != stdout) { fclose(dat); } else { fflush(dat); }
+    return GOOD_EXIT;
+}
\ No newline at end of file
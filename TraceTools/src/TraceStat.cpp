@@ -0,0 +1,352 @@
+#include "tmsg.h"
+#include "trfile.h"
+#include "pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <unistd.h>
+
+// Files larger than this are split into line-aligned chunks,
+// so one huge trace does not leave the other cores idle.
+#define CHUNK_BYTES ((size_t) 64 << 20)
+
+#define NO_INPUT ((uint32_t) -1)
+
+// Hit statistics of a block or a routine
+struct HitStat
+{
+    uint64_t hits;   //number of records
+    uint64_t inputs; //number of inputs touching it
+    uint32_t last;   //input which touched it lastly in this worker
+    HitStat() : hits(0), inputs(0), last(NO_INPUT) {}
+};
+
+typedef std::unordered_map<uint64_t,    HitStat> AddrStat;
+typedef std::unordered_map<std::string, HitStat> NameStat;
+
+// Statistics owned by one worker. Maps are sharded by key hash,
+// so shards can be merged across workers in parallel later.
+struct WorkerStat
+{
+    std::vector<AddrStat> addr;
+    std::vector<NameStat> name;
+};
+
+// A piece of a mapped file as a task
+struct Chunk
+{
+    uint32_t    input;
+    const char* beg;
+    const char* end;
+    int32_t     part; //-1 if the chunk is the whole file, or index in `Parts`
+};
+
+// Distinct keys seen in one chunk of a file split into pieces
+struct Part
+{
+    uint32_t                 input;
+    std::vector<uint64_t>    addrs;
+    std::vector<std::string> names;
+};
+
+static inline unsigned ShardOf(uint64_t addr, unsigned n){
+    return static_cast<unsigned>(((addr >> 2) * 0x9E3779B97F4A7C15ULL) >> 40) % n;
+}
+
+static inline unsigned ShardOf(const std::string &name, unsigned n){
+    return static_cast<unsigned>(std::hash<std::string>()(name) % n);
+}
+
+/**
+ * Bump the statistics of a key
+ * @param st the statistics
+ * @param input ID of the input, or `NO_INPUT` to skip counting inputs
+ */
+static inline void Touch(HitStat &st, uint32_t input){
+    ++st.hits;
+    if (input != NO_INPUT && st.last != input) { st.last = input; ++st.inputs; }
+}
+
+/**
+ * Aggregate a chunk of a TrDat file
+ */
+static void ScanDat(const Chunk &c, WorkerStat &ws, Part *pt){
+    const unsigned n = static_cast<unsigned>(ws.addr.size());
+    const uint32_t input = pt ? NO_INPUT : c.input;
+    const char* p = c.beg;
+    uint64_t addr;
+    uint64_t last_addr = 0;
+    HitStat* last_st = nullptr;
+    while (ParseDatLine(p, c.end, addr)) {
+        if (!last_st || addr != last_addr) {
+            last_st = &ws.addr[ShardOf(addr, n)][addr];
+            last_addr = addr;
+        }
+        Touch(*last_st, input);
+        if (pt) { pt->addrs.push_back(addr); }
+    }
+    if (pt) {
+        std::sort(pt->addrs.begin(), pt->addrs.end());
+        pt->addrs.erase(std::unique(pt->addrs.begin(), pt->addrs.end()), pt->addrs.end());
+    }
+}
+
+/**
+ * Aggregate a chunk of a TrSym file by routine names
+ */
+static void ScanSym(const Chunk &c, WorkerStat &ws, Part *pt){
+    const unsigned n = static_cast<unsigned>(ws.name.size());
+    const uint32_t input = pt ? NO_INPUT : c.input;
+    const char* p = c.beg;
+    uint64_t tidv;
+    const char* s; size_t s_len;
+    const char* r; size_t r_len;
+    std::string name;
+    HitStat* last_st = nullptr;
+    while (ParseSymLine(p, c.end, tidv, s, s_len)) {
+        SymRoutineName(s, s_len, r, r_len);
+        //consecutive records mostly share the routine
+        if (!last_st || r_len != name.size() || 0 != memcmp(r, name.data(), r_len)) {
+            name.assign(r, r_len);
+            last_st = &ws.name[ShardOf(name, n)][name];
+            if (pt) { pt->names.push_back(name); }
+        }
+        Touch(*last_st, input);
+    }
+    if (pt) {
+        std::sort(pt->names.begin(), pt->names.end());
+        pt->names.erase(std::unique(pt->names.begin(), pt->names.end()), pt->names.end());
+    }
+}
+
+/**
+ * Cut a mapped file into line-aligned chunks
+ */
+static void CutChunks(const MappedFile &mf, uint32_t input,
+                      std::vector<Chunk> &chunks, std::vector<Part> &parts)
+{
+    const char* p   = mf.Data();
+    const char* end = p + mf.Size();
+    if (mf.Size() <= CHUNK_BYTES) {
+        Chunk c = { input, p, end, -1 };
+        chunks.push_back(c);
+        return;
+    }
+    while (p < end) {
+        const char* q = (end - p > (ptrdiff_t)CHUNK_BYTES) ? p + CHUNK_BYTES : end;
+        if (q < end) {
+            const char* nl = static_cast<const char*>(memchr(q, '\n', end - q));
+            q = nl ? nl + 1 : end;
+        }
+        Chunk c = { input, p, q, static_cast<int32_t>(parts.size()) };
+        chunks.push_back(c);
+        Part pt;
+        pt.input = input;
+        parts.push_back(pt);
+        p = q;
+    }
+}
+
+// A row of the final report
+struct Row
+{
+    std::string key;
+    HitStat     st;
+};
+
+/**
+ * Sort rows by hits in descending order, then by key
+ */
+static void SortRows(std::vector<Row> &rows){
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        if (a.st.hits != b.st.hits) { return a.st.hits > b.st.hits; }
+        return a.key < b.key;
+    });
+}
+
+/**
+ * Print out a summary of all command line options
+ */
+static void disp_usage(){
+    std::cout << "[+] TraceStat - aggregate hit statistics over a traced corpus." << std::endl;
+    std::cout << "Usage: TraceStat [-d <dir_dat>] [-s <dir_sym>] -o <output> [-f csv|json] [-j <threads>]" << std::endl;
+    std::cout << "  -d  Directory of trace files. Gives per-block statistics." << std::endl;
+    std::cout << "  -s  Directory of trace symbol files. Gives per-routine statistics." << std::endl;
+    std::cout << "  -o  Path of the output file." << std::endl;
+    std::cout << "  -f  Format of the output file. Default is csv." << std::endl;
+    std::cout << "  -j  Number of worker threads. Default is the number of cores." << std::endl;
+}
+
+/**
+ * The main procedure of the tool.
+ * Map all traces under the directories, aggregate them in a
+ * work-stealing pool and write hits and touching inputs of
+ * each block and routine.
+ * @param argc total number of elements in the argv array
+ * @param argv array of command line arguments
+ */
+int main(int argc, char* argv[])
+{
+    std::string dir_dat, dir_sym, out_path, fmt = "csv";
+    unsigned n_thread = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:o:f:j:h")) != -1) {
+        switch (opt) {
+            case 'd': dir_dat  = optarg; break;
+            case 's': dir_sym  = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'f': fmt      = optarg; break;
+            case 'j': n_thread = static_cast<unsigned>(atoi(optarg)); break;
+            default : disp_usage(); return EVIL_EXIT_ARGV;
+        }
+    }
+    if ((dir_dat.size() + dir_sym.size()) == 0 || out_path.size() == 0 ||
+            (fmt != "csv" && fmt != "json")) {
+        disp_usage();
+        std::cout << "[!] Need -o, a valid -f and at least one of -d and -s" << std::endl;
+        return EVIL_EXIT_ARGV;
+    }
+
+    //the same relative path under both directories means the same input
+    std::vector<std::string> rel_dat, rel_sym, inputs;
+    if (dir_dat.size()) { ListFiles(dir_dat, rel_dat); }
+    if (dir_sym.size()) { ListFiles(dir_sym, rel_sym); }
+    std::set_union(rel_dat.begin(), rel_dat.end(), rel_sym.begin(), rel_sym.end(),
+                   std::back_inserter(inputs));
+
+    std::vector<std::unique_ptr<MappedFile> > maps;
+    std::vector<Chunk> dat_chunks, sym_chunks;
+    std::vector<Part>  parts;
+    auto load = [&](const std::vector<std::string> &rels, const std::string &dir,
+                    std::vector<Chunk> &chunks) -> bool {
+        for (const std::string &rel : rels) {
+            uint32_t input = static_cast<uint32_t>(
+                std::lower_bound(inputs.begin(), inputs.end(), rel) - inputs.begin());
+            std::unique_ptr<MappedFile> mf(new MappedFile());
+            if (!mf->Open(JoinPath(dir, rel))) {
+                std::cout << "[!] Failed to map " << JoinPath(dir, rel) << std::endl;
+                return false;
+            }
+            CutChunks(*mf, input, chunks, parts);
+            maps.push_back(std::move(mf));
+        }
+        return true;
+    };
+    if (!load(rel_dat, dir_dat, dat_chunks) || !load(rel_sym, dir_sym, sym_chunks))
+        { return EVIL_EXIT_READ; }
+
+    TaskPool pool(n_thread);
+    const unsigned n = pool.Size();
+    std::vector<WorkerStat> wstat(n);
+    for (WorkerStat &ws : wstat) { ws.addr.resize(n); ws.name.resize(n); }
+
+    for (const Chunk &c : dat_chunks) {
+        pool.Push([&wstat, &parts, c](unsigned w) {
+            ScanDat(c, wstat[w], c.part < 0 ? nullptr : &parts[c.part]);
+        });
+    }
+    for (const Chunk &c : sym_chunks) {
+        pool.Push([&wstat, &parts, c](unsigned w) {
+            ScanSym(c, wstat[w], c.part < 0 ? nullptr : &parts[c.part]);
+        });
+    }
+    pool.Run();
+
+    //merge the same shard of all workers, one shard per task
+    std::vector<AddrStat> addr_all(n);
+    std::vector<NameStat> name_all(n);
+    for (unsigned s = 0; s < n; ++s) {
+        pool.Push([&wstat, &addr_all, &name_all, n, s](unsigned w) {
+            for (unsigned i = 0; i < n; ++i) {
+                for (const auto &kv : wstat[i].addr[s]) {
+                    HitStat &st = addr_all[s][kv.first];
+                    st.hits += kv.second.hits; st.inputs += kv.second.inputs;
+                }
+                AddrStat().swap(wstat[i].addr[s]);
+                for (const auto &kv : wstat[i].name[s]) {
+                    HitStat &st = name_all[s][kv.first];
+                    st.hits += kv.second.hits; st.inputs += kv.second.inputs;
+                }
+                NameStat().swap(wstat[i].name[s]);
+            }
+        });
+    }
+    pool.Run();
+
+    //inputs of split files are counted once over all of their chunks
+    std::sort(parts.begin(), parts.end(),
+        [](const Part &a, const Part &b) { return a.input < b.input; });
+    for (size_t i = 0; i < parts.size();) {
+        std::vector<uint64_t>    addrs;
+        std::vector<std::string> names;
+        size_t j = i;
+        for (; j < parts.size() && parts[j].input == parts[i].input; ++j) {
+            addrs.insert(addrs.end(), parts[j].addrs.begin(), parts[j].addrs.end());
+            names.insert(names.end(), parts[j].names.begin(), parts[j].names.end());
+        }
+        std::sort(addrs.begin(), addrs.end());
+        std::sort(names.begin(), names.end());
+        addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        for (uint64_t a : addrs) { ++addr_all[ShardOf(a, n)][a].inputs; }
+        for (const std::string &r : names) { ++name_all[ShardOf(r, n)][r].inputs; }
+        i = j;
+    }
+
+    std::vector<Row> blocks, routines;
+    for (const AddrStat &m : addr_all) {
+        for (const auto &kv : m) {
+            Row r;
+            r.key = HexStr(kv.first);
+            r.st  = kv.second;
+            blocks.push_back(r);
+        }
+    }
+    for (const NameStat &m : name_all) {
+        for (const auto &kv : m) {
+            Row r;
+            r.key = kv.first;
+            r.st  = kv.second;
+            routines.push_back(r);
+        }
+    }
+    SortRows(blocks);
+    SortRows(routines);
+
+    std::ofstream ofs(out_path.c_str(), std::ios::out|std::ios::trunc);
+    if (!ofs.is_open()) {
+        std::cout << "[!] Failed to write " << out_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    if (fmt == "csv") {
+        ofs << "kind,key,hits,inputs\n";
+        for (const Row &r : blocks)
+            { ofs << "bbl," << r.key << "," << r.st.hits << "," << r.st.inputs << "\n"; }
+        for (const Row &r : routines)
+            { ofs << "rtn," << CsvQuote(r.key) << "," << r.st.hits << "," << r.st.inputs << "\n"; }
+    } else {
+        ofs << "{\"inputs\":" << inputs.size() << ",\n\"blocks\":[";
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            ofs << (i ? ",\n" : "\n") << "{\"addr\":\"" << blocks[i].key << "\",\"hits\":"
+                << blocks[i].st.hits << ",\"inputs\":" << blocks[i].st.inputs << "}";
+        }
+        ofs << "],\n\"routines\":[";
+        for (size_t i = 0; i < routines.size(); ++i) {
+            ofs << (i ? ",\n" : "\n") << "{\"name\":" << Quote(routines[i].key) << ",\"hits\":"
+                << routines[i].st.hits << ",\"inputs\":" << routines[i].st.inputs << "}";
+        }
+        ofs << "]}\n";
+    }
+    ofs.close();
+    if (ofs.fail()) {
+        std::cout << "[!] Failed to write " << out_path << std::endl;
+        return EVIL_EXIT_SAVE;
+    }
+    std::cout << "[+] " << inputs.size() << " inputs, " << blocks.size() << " blocks, "
+              << routines.size() << " routines" << std::endl;
+    return GOOD_EXIT;
+}
\ No newline at end of file
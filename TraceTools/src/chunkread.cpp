@@ -0,0 +1,158 @@
+#include "chunkread.h"
+#include "pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+/**
+ * Constructor
+ */
+ChunkReader::ChunkReader(){
+    Flags   = 0;
+    Scanned = false;
+}
+
+/**
+ * Map a container and find its chunks
+ * @param path path of the container
+ * @return false if it can not be mapped or has a bad file header
+ */
+bool ChunkReader::Open(const std::string &path){
+    Close();
+    if (!File.Open(path) || File.Size() < sizeof(ChkFile)) { return false; }
+    ChkFile fh;
+    memcpy(&fh, File.Data(), sizeof(fh));
+    if (0 != memcmp(fh.magic, CHK_MAGIC, sizeof(fh.magic)) || fh.version != CHK_VERSION)
+        { Close(); return false; }
+    if (!LoadIndex()) { ScanChunks(); }
+    for (size_t i = 0; i < Index.size(); ++i) { ByTid[Index[i].tid].push_back(i); }
+    for (auto &kv : ByTid) {
+        std::sort(kv.second.begin(), kv.second.end(), [this](size_t a, size_t b)
+            { return Index[a].first_seq < Index[b].first_seq; });
+    }
+    return true;
+}
+
+/**
+ * Unmap the container and forget its chunks
+ */
+void ChunkReader::Close(){
+    File.Close();
+    Index.clear();
+    ByTid.clear();
+    Flags   = 0;
+    Scanned = false;
+}
+
+/**
+ * Load the index written at the end of the container
+ * @return false if the footer or the index is missing or damaged
+ */
+bool ChunkReader::LoadIndex(){
+    const uint64_t size = File.Size();
+    if (size < sizeof(ChkFile) + sizeof(ChkFoot)) { return false; }
+    ChkFoot ft;
+    memcpy(&ft, File.Data() + size - sizeof(ft), sizeof(ft));
+    if (0 != memcmp(ft.magic, CHK_FOOT_MAGIC, sizeof(ft.magic))) { return false; }
+    if (ft.off_index < sizeof(ChkFile) || ft.n_chunk > size / sizeof(ChkIndex) ||
+            ft.off_index + ft.n_chunk * sizeof(ChkIndex) + sizeof(ChkFoot) != size)
+        { return false; }
+    Index.resize(ft.n_chunk);
+    if (ft.n_chunk)
+        { memcpy(&Index[0], File.Data() + ft.off_index, ft.n_chunk * sizeof(ChkIndex)); }
+    for (const ChkIndex &ent : Index) {
+        ChkHead ch;
+        if (ent.offset + sizeof(ch) > ft.off_index) { Index.clear(); return false; }
+        memcpy(&ch, File.Data() + ent.offset, sizeof(ch));
+        if (ch.magic != CHK_HEAD_MAGIC || ch.tid != ent.tid || ch.count != ent.count ||
+                ent.offset + sizeof(ch) + ch.bytes > ft.off_index)
+            { Index.clear(); return false; }
+    }
+    Flags = ft.flags;
+    return true;
+}
+
+/**
+ * Walk the chunks from the start of the container, e.g. the target
+ * was killed before the index was written. It stops at the first
+ * chunk which is cut short or whose payload is damaged.
+ */
+void ChunkReader::ScanChunks(){
+    Scanned = true;
+    const uint64_t size = File.Size();
+    uint64_t pos = sizeof(ChkFile);
+    while (pos + sizeof(ChkHead) <= size) {
+        ChkHead ch;
+        memcpy(&ch, File.Data() + pos, sizeof(ch));
+        if (ch.magic != CHK_HEAD_MAGIC || ch.count > CHK_MAX_EVENTS ||
+                ch.bytes > CHK_MAX_BYTES || pos + sizeof(ch) + ch.bytes > size)
+            { break; }
+        const unsigned char* pay = reinterpret_cast<const unsigned char*>(File.Data() + pos + sizeof(ch));
+        if (ChkCrc(pay, ch.bytes) != ch.crc) { break; }
+        ChkIndex ent;
+        ent.offset    = pos;
+        ent.first_seq = ch.first_seq;
+        ent.tid       = ch.tid;
+        ent.count     = ch.count;
+        Index.push_back(ent);
+        pos += sizeof(ch) + ch.bytes;
+    }
+}
+
+/**
+ * Decode the records of a chunk
+ * @param i index of the chunk in `Chunks()`
+ * @param out receives the records
+ * @return false for a damaged chunk
+ */
+bool ChunkReader::Decode(size_t i, std::vector<uint64_t> &out) const{
+    out.clear();
+    if (i >= Index.size()) { return false; }
+    ChkHead ch;
+    memcpy(&ch, File.Data() + Index[i].offset, sizeof(ch));
+    if (ch.count > CHK_MAX_EVENTS || Index[i].offset + sizeof(ch) + ch.bytes > File.Size())
+        { return false; }
+    const unsigned char* pay = reinterpret_cast<const unsigned char*>(File.Data() + Index[i].offset + sizeof(ch));
+    if (ChkCrc(pay, ch.bytes) != ch.crc) { return false; }
+    out.resize(ch.count);
+    if (!ChkDecode(pay, ch.bytes, ch.count, out.data())) { out.clear(); return false; }
+    return true;
+}
+
+/**
+ * Find the chunk holding a record of a thread
+ * @param tid Pin thread ID
+ * @param seq sequence number of the record in that thread
+ * @return index of the chunk, or `Chunks().size()` if none holds it
+ */
+size_t ChunkReader::Seek(uint32_t tid, uint64_t seq) const{
+    auto it = ByTid.find(tid);
+    if (it == ByTid.end()) { return Index.size(); }
+    const std::vector<size_t> &lst = it->second;
+    auto pos = std::upper_bound(lst.begin(), lst.end(), seq, [this](uint64_t s, size_t c)
+        { return s < Index[c].first_seq; });
+    if (pos == lst.begin()) { return Index.size(); }
+    const ChkIndex &ent = Index[*(pos - 1)];
+    return (seq < ent.first_seq + ent.count) ? *(pos - 1) : Index.size();
+}
+
+/**
+ * Decode chunks in parallel
+ * @param which indexes of the chunks
+ * @param n_thread number of worker threads, 0 for all cores
+ * @param fn receives the records of each chunk
+ * @return false if any chunk is damaged, others are still visited
+ */
+bool ChunkReader::DecodeAll(const std::vector<size_t> &which, unsigned n_thread, const Visitor &fn) const{
+    TaskPool pool(n_thread);
+    std::vector<std::vector<uint64_t> > bufs(pool.Size());
+    std::atomic<bool> ok(true);
+    for (size_t i : which) {
+        pool.Push([this, i, &bufs, &ok, &fn](unsigned w) {
+            if (Decode(i, bufs[w])) { fn(i, bufs[w].data(), bufs[w].size()); }
+            else { ok.store(false); }
+        });
+    }
+    pool.Run();
+    return ok.load();
+}
\ No newline at end of file
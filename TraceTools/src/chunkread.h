@@ -0,0 +1,45 @@
+#ifndef HEAD_CHUNKREAD_H
+#define HEAD_CHUNKREAD_H
+
+#include "trchunk.h"
+#include "trfile.h"
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reader of the chunked container written by TracerCore with
+// `-TrDatPath chunk:<path>`. The index at the end of the file is
+// used when it is intact, otherwise chunks are found by scanning
+// and those up to the first damaged one are kept.
+class ChunkReader
+{
+public:
+    // Called with the records of a chunk, by index of the chunk.
+    // Calls may come from several threads at the same time.
+    typedef std::function<void(size_t, const uint64_t*, size_t)> Visitor;
+protected:
+    MappedFile            File;
+    std::vector<ChkIndex> Index;
+    std::map<uint32_t, std::vector<size_t> > ByTid; //chunks of each thread, by sequence
+    uint32_t              Flags;
+    bool                  Scanned;
+    bool LoadIndex();
+    void ScanChunks();
+public:
+    bool Open(const std::string &path);
+    void Close();
+    const std::vector<ChkIndex> &Chunks() const { return Index; }
+    const std::map<uint32_t, std::vector<size_t> > &Threads() const { return ByTid; }
+    bool Truncated() const { return 0 != (Flags & CHK_FLAG_TRUNC); }
+    bool Recovered() const { return Scanned; }
+    bool Decode(size_t i, std::vector<uint64_t> &out) const;
+    size_t Seek(uint32_t tid, uint64_t seq) const;
+    bool DecodeAll(const std::vector<size_t> &which, unsigned n_thread, const Visitor &fn) const;
+    ChunkReader();
+    ChunkReader(const ChunkReader &) = delete;
+    ChunkReader &operator=(const ChunkReader &) = delete;
+};
+
+#endif
\ No newline at end of file
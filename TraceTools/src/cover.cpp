@@ -0,0 +1,271 @@
+#include "cover.h"
+#include "pool.h"
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define COV_X86 1
+#endif
+
+// Stale candidates popped to be scored again at once, for each worker
+#define RESCORE_BATCH ((size_t) 64)
+// Fewer candidates than this are scored by the caller alone
+#define RESCORE_PAR_MIN ((size_t) 256)
+
+static uint64_t PopAndNotScalar(const uint64_t* a, const uint64_t* b, size_t n){
+    uint64_t k = 0;
+    for (size_t i = 0; i < n; ++i) { k += __builtin_popcountll(a[i] & ~b[i]); }
+    return k;
+}
+
+#ifdef COV_X86
+
+__attribute__((target("popcnt")))
+static uint64_t PopAndNotPOPCNT(const uint64_t* a, const uint64_t* b, size_t n){
+    uint64_t k = 0;
+    for (size_t i = 0; i < n; ++i) { k += __builtin_popcountll(a[i] & ~b[i]); }
+    return k;
+}
+
+//popcount of each nibble by a table lookup, summed up by `vpsadbw`
+__attribute__((target("avx2,popcnt")))
+static uint64_t PopAndNotAVX2(const uint64_t* a, const uint64_t* b, size_t n){
+    const __m256i lut  = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low  = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i v = _mm256_andnot_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)),
+                                              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        const __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+                                          _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, zero));
+    }
+    uint64_t k = static_cast<uint64_t>(_mm256_extract_epi64(acc, 0)) + static_cast<uint64_t>(_mm256_extract_epi64(acc, 1)) +
+                 static_cast<uint64_t>(_mm256_extract_epi64(acc, 2)) + static_cast<uint64_t>(_mm256_extract_epi64(acc, 3));
+    for (; i < n; ++i) { k += __builtin_popcountll(a[i] & ~b[i]); }
+    return k;
+}
+
+#endif
+
+typedef uint64_t (*PopFn)(const uint64_t*, const uint64_t*, size_t);
+
+/**
+ * Pick the kernel once by what the CPU has
+ */
+static PopFn PickPop(){
+#ifdef COV_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))   { return PopAndNotAVX2; }
+    if (__builtin_cpu_supports("popcnt")) { return PopAndNotPOPCNT; }
+#endif
+    return PopAndNotScalar;
+}
+
+/**
+ * Number of bits set in `a` but not in `b`
+ * @param a a bitmap
+ * @param b another bitmap
+ * @param n number of 64-bit words of both
+ */
+uint64_t PopAndNot(const uint64_t* a, const uint64_t* b, size_t n){
+    static const PopFn fn = PickPop();
+    return fn(a, b, n);
+}
+
+/**
+ * Constructor
+ */
+CovSet::CovSet(){
+    Card = 0;
+}
+
+/**
+ * Add a key ID no less than all IDs added before
+ * @param id the key ID
+ */
+void CovSet::Append(uint32_t id){
+    const uint16_t hi = static_cast<uint16_t>(id >> 16);
+    const uint16_t lo = static_cast<uint16_t>(id & 0xFFFF);
+    if (Boxes.empty() || Boxes.back().hi != hi) {
+        Box b = { hi, 0, 0, static_cast<uint32_t>(Arr.size()) };
+        Boxes.push_back(b);
+    }
+    Box &b = Boxes.back();
+    if (!b.bitmap) {
+        if (b.card && Arr.back() == lo) { return; }
+        if (b.card < COV_ARR_MAX) { Arr.push_back(lo); ++b.card; ++Card; return; }
+        //the array would be larger than a bitmap now
+        const uint32_t off = static_cast<uint32_t>(Bits.size());
+        Bits.resize(Bits.size() + COV_BOX_WORDS, 0);
+        for (uint32_t i = b.off; i < Arr.size(); ++i) { Bits[off + Arr[i] / 64] |= 1ULL << (Arr[i] % 64); }
+        Arr.resize(b.off);
+        b.bitmap = 1;
+        b.off = off;
+    }
+    uint64_t &w = Bits[b.off + lo / 64];
+    if (w & (1ULL << (lo % 64))) { return; }
+    w |= 1ULL << (lo % 64);
+    ++b.card;
+    ++Card;
+}
+
+/**
+ * Build the set from sorted key IDs, dropping what it held
+ */
+void CovSet::Build(const std::vector<uint32_t> &sorted_ids){
+    Boxes.clear(); Arr.clear(); Bits.clear();
+    Card = 0;
+    for (uint32_t id : sorted_ids) { Append(id); }
+    Shrink();
+}
+
+/**
+ * Release the spare capacity once the set is done
+ */
+void CovSet::Shrink(){
+    Boxes.shrink_to_fit();
+    Arr.shrink_to_fit();
+    Bits.shrink_to_fit();
+}
+
+/**
+ * Count the keys of the set not covered yet
+ * @param covered bitmap of covered keys, of at least `MaxBox() + 1` containers
+ */
+uint64_t CovSet::CountNew(const CovBits &covered) const {
+    uint64_t k = 0;
+    for (const Box &b : Boxes) {
+        const uint64_t* c = covered.data() + static_cast<size_t>(b.hi) * COV_BOX_WORDS;
+        if (b.bitmap) { k += PopAndNot(Bits.data() + b.off, c, COV_BOX_WORDS); continue; }
+        for (uint32_t i = b.off; i < b.off + b.card; ++i) { k += !((c[Arr[i] / 64] >> (Arr[i] % 64)) & 1); }
+    }
+    return k;
+}
+
+/**
+ * Mark the keys of the set as covered
+ * @param covered bitmap of covered keys, of at least `MaxBox() + 1` containers
+ */
+void CovSet::AddTo(CovBits &covered) const {
+    for (const Box &b : Boxes) {
+        uint64_t* c = covered.data() + static_cast<size_t>(b.hi) * COV_BOX_WORDS;
+        if (b.bitmap) {
+            for (uint32_t i = 0; i < COV_BOX_WORDS; ++i) { c[i] |= Bits[b.off + i]; }
+            continue;
+        }
+        for (uint32_t i = b.off; i < b.off + b.card; ++i) { c[Arr[i] / 64] |= 1ULL << (Arr[i] % 64); }
+    }
+}
+
+/**
+ * Hash of the keys, to find inputs with the same coverage
+ */
+uint64_t CovSet::Hash() const {
+    uint64_t h = 0xcbf29ce484222325ULL ^ Card;
+    for (const Box &b : Boxes) {
+        h = (h ^ b.hi) * 0x100000001b3ULL;
+        if (b.bitmap) { for (uint32_t i = 0; i < COV_BOX_WORDS; ++i) { h = (h ^ Bits[b.off + i]) * 0x100000001b3ULL; } }
+        else { for (uint32_t i = b.off; i < b.off + b.card; ++i) { h = (h ^ Arr[i]) * 0x100000001b3ULL; } }
+    }
+    return h;
+}
+
+/**
+ * Whether two sets hold the same keys. As a container is a bitmap
+ * exactly when it has more than `COV_ARR_MAX` keys, equal sets have
+ * the same layout.
+ */
+bool CovSet::operator==(const CovSet &o) const {
+    if (Card != o.Card || Boxes.size() != o.Boxes.size()) { return false; }
+    for (size_t i = 0; i < Boxes.size(); ++i) {
+        const Box &x = Boxes[i], &y = o.Boxes[i];
+        if (x.hi != y.hi || x.bitmap != y.bitmap || x.card != y.card) { return false; }
+        const bool same = x.bitmap ?
+            0 == memcmp(Bits.data() + x.off, o.Bits.data() + y.off, COV_BOX_WORDS * sizeof(uint64_t)) :
+            0 == memcmp(Arr.data() + x.off, o.Arr.data() + y.off, x.card * sizeof(uint16_t));
+        if (!same) { return false; }
+    }
+    return true;
+}
+
+/**
+ * Greedy weighted set cover: take the input with the most new keys per
+ * weight, until no input adds anything. Scores only drop as keys get
+ * covered, so a candidate scored after the last pick and still on top
+ * of the heap is the best (lazy greedy). Stale candidates on top are
+ * popped in batches and scored again by all workers.
+ * @param sets keys of each input
+ * @param weights positive cost of each input
+ * @param n_thread number of worker threads, 0 for all cores
+ * @param picked receives the inputs taken, in order
+ * @return number of keys covered by them
+ */
+uint64_t GreedyCover(const std::vector<CovSet> &sets, const std::vector<double> &weights,
+                     unsigned n_thread, std::vector<uint32_t> &picked)
+{
+    struct Cand
+    {
+        double   score;
+        uint64_t gain;
+        uint32_t id;
+        uint32_t epoch; //number of picks when it was scored
+    };
+    //the best on top, and the lower ID first on a tie to be deterministic
+    auto worse = [](const Cand &x, const Cand &y){
+        return x.score < y.score || (x.score == y.score && x.id > y.id);
+    };
+    std::priority_queue<Cand, std::vector<Cand>, decltype(worse)> heap(worse);
+
+    picked.clear();
+    uint32_t max_box = 0;
+    for (uint32_t i = 0; i < sets.size(); ++i) {
+        if (0 == sets[i].Size()) { continue; }
+        max_box = std::max(max_box, sets[i].MaxBox());
+        Cand c = { sets[i].Size() / weights[i], sets[i].Size(), i, 0 };
+        heap.push(c);
+    }
+    CovBits covered(static_cast<size_t>(max_box + 1) * COV_BOX_WORDS, 0);
+
+    TaskPool pool(n_thread);
+    const unsigned n_worker = pool.Size();
+    std::vector<Cand> batch;
+    uint32_t epoch = 0;
+    uint64_t total = 0;
+    while (!heap.empty()) {
+        if (heap.top().epoch == epoch) {
+            picked.push_back(heap.top().id);
+            total += heap.top().gain;
+            sets[heap.top().id].AddTo(covered);
+            heap.pop();
+            ++epoch;
+            continue;
+        }
+        batch.clear();
+        while (!heap.empty() && heap.top().epoch != epoch && batch.size() < RESCORE_BATCH * n_worker)
+            { batch.push_back(heap.top()); heap.pop(); }
+        auto rescore = [&](size_t beg, size_t end){
+            for (size_t i = beg; i < end; ++i) {
+                Cand &c = batch[i];
+                c.gain  = sets[c.id].CountNew(covered);
+                c.score = c.gain / weights[c.id];
+                c.epoch = epoch;
+            }
+        };
+        if (batch.size() < RESCORE_PAR_MIN || n_worker < 2) { rescore(0, batch.size()); }
+        else {
+            const size_t step = (batch.size() + n_worker - 1) / n_worker;
+            for (size_t beg = 0; beg < batch.size(); beg += step) {
+                const size_t end = std::min(batch.size(), beg + step);
+                pool.Push([&rescore, beg, end](unsigned){ rescore(beg, end); });
+            }
+            pool.Run();
+        }
+        for (const Cand &c : batch) { if (c.gain) { heap.push(c); } }
+    }
+    return total;
+}
\ No newline at end of file
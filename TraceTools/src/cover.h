@@ -0,0 +1,53 @@
+#ifndef HEAD_COVER_H
+#define HEAD_COVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define COV_BOX_BITS  ((uint32_t) 65536) //key IDs of a container
+#define COV_BOX_WORDS ((uint32_t) COV_BOX_BITS / 64)
+#define COV_ARR_MAX   ((uint32_t) 4096)  //beyond this, an array is larger than a bitmap
+
+uint64_t PopAndNot(const uint64_t* a, const uint64_t* b, size_t n);
+
+// Keys covered so far, as a plain bitmap over all key IDs
+typedef std::vector<uint64_t> CovBits;
+
+// Key IDs (blocks or edges) reached by one input, compressed like
+// Roaring bitmaps: IDs are grouped by their high 16 bits, and each
+// group is a sorted array of the low 16 bits while it has no more
+// than `COV_ARR_MAX` of them, or a bitmap of 65536 bits otherwise.
+// Inputs mostly reach a few thousand keys scattered over the whole
+// target, so most groups are short arrays.
+class CovSet
+{
+protected:
+    struct Box
+    {
+        uint16_t hi;
+        uint16_t bitmap; //1 if it is in `Bits`, otherwise in `Arr`
+        uint32_t card;
+        uint32_t off;    //where its array or bitmap starts
+    };
+    std::vector<Box>      Boxes;
+    std::vector<uint16_t> Arr;
+    std::vector<uint64_t> Bits;
+    uint64_t              Card;
+public:
+    void Append(uint32_t id);
+    void Build(const std::vector<uint32_t> &sorted_ids);
+    void Shrink();
+    uint64_t Size() const { return Card; }
+    uint32_t MaxBox() const { return Boxes.size() ? Boxes.back().hi : 0; }
+    uint64_t CountNew(const CovBits &covered) const;
+    void AddTo(CovBits &covered) const;
+    uint64_t Hash() const;
+    bool operator==(const CovSet &o) const;
+    CovSet();
+};
+
+uint64_t GreedyCover(const std::vector<CovSet> &sets, const std::vector<double> &weights,
+                     unsigned n_thread, std::vector<uint32_t> &picked);
+
+#endif
\ No newline at end of file
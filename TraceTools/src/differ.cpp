@@ -0,0 +1,369 @@
+#include "differ.h"
+#include "chunkread.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define DIFF_X86 1
+#endif
+
+/**
+ * Common prefix of two buffers, 8 bytes at a time
+ */
+static size_t SamePrefixScalar(const char* a, const char* b, size_t n){
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y) { break; }
+    }
+    while (i < n && a[i] == b[i]) { ++i; }
+    return i;
+}
+
+/**
+ * Number of a byte in a buffer, one byte at a time
+ */
+static size_t CountByteScalar(const char* p, size_t n, char c){
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) { k += (p[i] == c); }
+    return k;
+}
+
+#ifdef DIFF_X86
+
+static size_t SamePrefixSSE2(const char* a, const char* b, size_t n){
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const unsigned ne = 0xFFFFu & ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (ne) { return i + __builtin_ctz(ne); }
+    }
+    return i + SamePrefixScalar(a + i, b + i, n - i);
+}
+
+static size_t CountByteSSE2(const char* p, size_t n, char c){
+    const __m128i v = _mm_set1_epi8(c);
+    size_t i = 0, k = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        k += __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, v))));
+    }
+    return k + CountByteScalar(p + i, n - i, c);
+}
+
+//two vectors per step, as equal runs of traces are long
+__attribute__((target("avx2")))
+static size_t SamePrefixAVX2(const char* a, const char* b, size_t n){
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        const __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        const __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32));
+        const __m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32));
+        const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(x0, y0), _mm256_cmpeq_epi8(x1, y1));
+        if (0xFFFFFFFFu != static_cast<unsigned>(_mm256_movemask_epi8(eq))) { break; }
+    }
+    for (; i + 32 <= n; i += 32) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        const unsigned ne = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+        if (ne) { return i + __builtin_ctz(ne); }
+    }
+    return i + SamePrefixScalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t CountByteAVX2(const char* p, size_t n, char c){
+    const __m256i v = _mm256_set1_epi8(c);
+    size_t i = 0, k = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        k += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, v))));
+    }
+    return k + CountByteScalar(p + i, n - i, c);
+}
+
+#endif
+
+typedef size_t (*PrefixFn)(const char*, const char*, size_t);
+typedef size_t (*CountFn)(const char*, size_t, char);
+
+// Kernels picked once by what the CPU has
+struct SimdKernels
+{
+    PrefixFn    prefix;
+    CountFn     count;
+    const char* level;
+    SimdKernels() : prefix(SamePrefixScalar), count(CountByteScalar), level("scalar") {
+#ifdef DIFF_X86
+        prefix = SamePrefixSSE2; count = CountByteSSE2; level = "sse2";
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) { prefix = SamePrefixAVX2; count = CountByteAVX2; level = "avx2"; }
+#endif
+    }
+};
+
+static const SimdKernels &Kernels(){
+    static const SimdKernels k;
+    return k;
+}
+
+/**
+ * Length of the common prefix of two buffers, by
+ * the widest vector compare the CPU supports
+ * @param a a buffer
+ * @param b another buffer
+ * @param n number of bytes to compare
+ * @return index of the first different byte, or `n`
+ */
+size_t SamePrefix(const char* a, const char* b, size_t n){
+    return Kernels().prefix(a, b, n);
+}
+
+/**
+ * Count a byte in a buffer, vectorized like `SamePrefix`
+ */
+size_t CountByte(const char* p, size_t n, char c){
+    return Kernels().count(p, n, c);
+}
+
+/**
+ * Name of the vector kernels in use: "avx2", "sse2" or "scalar"
+ */
+const char* SimdLevel(){
+    return Kernels().level;
+}
+
+/**
+ * Constructor
+ */
+DiffSide::DiffSide(){
+    pData  = nullptr;
+    nSize  = 0;
+    Binary = false;
+}
+
+/**
+ * Open a text trace, or decode a chunked container told by its magic.
+ * Threads of a container follow each other by their IDs, as the order
+ * of chunks in the file changes from run to run.
+ * @param path path of the trace
+ * @return true for success
+ */
+bool DiffSide::Open(const std::string &path){
+    if (!File.Open(path)) { return false; }
+    Binary = File.Size() >= sizeof(CHK_MAGIC) - 1 &&
+             0 == memcmp(File.Data(), CHK_MAGIC, sizeof(CHK_MAGIC) - 1);
+    if (!Binary) {
+        pData = File.Data();
+        nSize = File.Size();
+        return true;
+    }
+    File.Close();
+    ChunkReader rd;
+    if (!rd.Open(path)) { return false; }
+    std::vector<uint64_t> recs;
+    for (const auto &t : rd.Threads()) {
+        for (size_t i : t.second) {
+            if (!rd.Decode(i, recs)) { return false; }
+            Words.insert(Words.end(), recs.begin(), recs.end());
+        }
+    }
+    pData = reinterpret_cast<const char*>(Words.data());
+    nSize = Words.size() * sizeof(uint64_t);
+    return true;
+}
+
+/**
+ * Total number of records. The last line counts even without a line break.
+ */
+uint64_t DiffSide::Records() const {
+    if (Binary) { return Words.size(); }
+    return CountByte(pData, nSize, '\n') + (nSize && pData[nSize - 1] != '\n');
+}
+
+/**
+ * Byte position of the record after the one at `pos`
+ */
+size_t DiffSide::Next(size_t pos) const {
+    if (Binary) { return pos + sizeof(uint64_t); }
+    const char* nl = static_cast<const char*>(memchr(pData + pos, '\n', nSize - pos));
+    return nl ? nl - pData + 1 : nSize;
+}
+
+/**
+ * Hash of the record at `pos`, without its line break
+ */
+uint64_t DiffSide::Hash(size_t pos) const {
+    if (Binary) { return Words[pos / sizeof(uint64_t)] * 0x9E3779B97F4A7C15ULL; }
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = pos; i < nSize && pData[i] != '\n'; ++i) { h = (h ^ (unsigned char)pData[i]) * 0x100000001b3ULL; }
+    return h;
+}
+
+/**
+ * Whether the record at `pos` equals the one at `o_pos` of another side
+ */
+bool DiffSide::Same(size_t pos, const DiffSide &o, size_t o_pos) const {
+    const size_t n = Next(pos) - pos, o_n = o.Next(o_pos) - o_pos;
+    const size_t m = n - (!Binary && pData[pos + n - 1] == '\n');
+    const size_t o_m = o_n - (!o.Binary && o.pData[o_pos + o_n - 1] == '\n');
+    return m == o_m && 0 == memcmp(pData + pos, o.pData + o_pos, m);
+}
+
+/**
+ * Byte positions of up to `n` records from `pos`, plus the end of the last
+ * @param out receives the positions
+ */
+void DiffSide::Window(size_t pos, size_t n, std::vector<size_t> &out) const {
+    out.clear();
+    out.push_back(pos);
+    for (size_t i = 0; i < n && pos < nSize; ++i) { out.push_back(pos = Next(pos)); }
+}
+
+/**
+ * Print `n` records from `pos`, each after a sign like a unified diff
+ */
+void DiffSide::Print(size_t pos, uint64_t n, char sign, FILE* out) const {
+    for (uint64_t i = 0; i < n && pos < nSize; ++i) {
+        const size_t next = Next(pos);
+        fputc(sign, out);
+        if (Binary) { fputs(HexStr(Words[pos / sizeof(uint64_t)]).c_str(), out); }
+        else { fwrite(pData + pos, 1, next - pos - (pData[next - 1] == '\n'), out); }
+        fputc('\n', out);
+        pos = next;
+    }
+}
+
+/**
+ * Constructor
+ * @param window records of each side searched for a resync
+ * @param anchor equal records in a row to resync
+ * @param max_hunks stop after this many hunks, 0 for no limit
+ */
+TraceDiffer::TraceDiffer(size_t window, size_t anchor, size_t max_hunks) :
+    Window(window ? window : 1), Anchor(anchor ? anchor : 1), MaxHunks(max_hunks)
+{
+}
+
+/**
+ * Open the two traces, which must be of the same kind
+ */
+bool TraceDiffer::Open(const std::string &a_path, const std::string &b_path){
+    return A.Open(a_path) && B.Open(b_path) && A.IsBinary() == B.IsBinary();
+}
+
+/**
+ * Find the resync after a divergence. A run of `Anchor` equal records,
+ * or the equal tails when both windows reach the ends, is searched with
+ * the fewest records skipped on both sides.
+ * @param wa positions of the window of A, as made by `DiffSide::Window`
+ * @param wb positions of the window of B
+ * @param i_out receives the records of A before the resync
+ * @param j_out receives the records of B before the resync
+ * @return false if there is no resync within the windows
+ */
+bool TraceDiffer::Align(const std::vector<size_t> &wa, const std::vector<size_t> &wb,
+                        size_t &i_out, size_t &j_out) const
+{
+    const size_t n = wa.size() - 1, m = wb.size() - 1;
+    size_t best = SIZE_MAX;
+    auto run_hash = [this](const DiffSide &s, const std::vector<size_t> &w, size_t i){
+        uint64_t h = 0;
+        for (size_t k = 0; k < Anchor; ++k) { h = (h ^ s.Hash(w[i + k])) * 0x100000001b3ULL; }
+        return h;
+    };
+    auto same_run = [this, &wa, &wb](size_t i, size_t j, size_t len){
+        for (size_t k = 0; k < len; ++k) { if (!A.Same(wa[i + k], B, wb[j + k])) { return false; } }
+        return true;
+    };
+    if (n >= Anchor && m >= Anchor) {
+        //first position of each run in B, which is the best for it
+        std::unordered_map<uint64_t, size_t> first;
+        for (size_t j = 0; j + Anchor <= m; ++j) { first.emplace(run_hash(B, wb, j), j); }
+        for (size_t i = 0; i + Anchor <= n && i < best; ++i) {
+            auto it = first.find(run_hash(A, wa, i));
+            if (it == first.end() || i + it->second >= best) { continue; }
+            if (same_run(i, it->second, Anchor)) { best = i + it->second; i_out = i; j_out = it->second; }
+        }
+    }
+    if (wa.back() == A.Size() && wb.back() == B.Size()) {
+        for (size_t t = std::min(std::min(n, m), Anchor - 1) + 1; t-- > 0; ) {
+            if (n + m - 2 * t < best && same_run(n - t, m - t, t))
+                { best = n + m - 2 * t; i_out = n - t; j_out = m - t; break; }
+        }
+    }
+    return best != SIZE_MAX;
+}
+
+/**
+ * Compare the traces from the start to the end
+ */
+DiffResult TraceDiffer::Run() const {
+    DiffResult r;
+    r.a_recs  = A.Records();
+    r.b_recs  = B.Records();
+    r.aligned = true;
+    r.capped  = false;
+    const size_t unit = A.IsBinary() ? sizeof(uint64_t) : 0;
+    size_t pa = 0, pb = 0;
+    uint64_t ra = 0, rb = 0;
+    std::vector<size_t> wa, wb;
+    for (;;) {
+        //skip the equal run and step back to the record holding the first different byte
+        const size_t k = SamePrefix(A.Data() + pa, B.Data() + pb, std::min(A.Size() - pa, B.Size() - pb));
+        size_t skip;
+        if (unit) { skip = k - k % unit; ra += skip / unit; rb += skip / unit; }
+        else {
+            const char* nl = static_cast<const char*>(memrchr(A.Data() + pa, '\n', k));
+            skip = nl ? nl - (A.Data() + pa) + 1 : 0;
+            const uint64_t lines = CountByte(A.Data() + pa, skip, '\n');
+            ra += lines; rb += lines;
+        }
+        pa += skip; pb += skip;
+        if (pa == A.Size() && pb == B.Size()) { break; }
+        if (MaxHunks && r.hunks.size() == MaxHunks) { r.capped = true; break; }
+
+        DiffHunk h = { ra, 0, rb, 0, pa, pb };
+        if (pa == A.Size() || pb == B.Size()) {
+            //one side ended, the rest of the other is the last hunk
+            h.a_len = r.a_recs - ra;
+            h.b_len = r.b_recs - rb;
+            r.hunks.push_back(h);
+            break;
+        }
+        A.Window(pa, Window, wa);
+        B.Window(pb, Window, wb);
+        size_t i = wa.size() - 1, j = wb.size() - 1;
+        const bool found = Align(wa, wb, i, j);
+        h.a_len = i;
+        h.b_len = j;
+        if (i || j) { r.hunks.push_back(h); }
+        if (!found) { r.aligned = false; break; }
+        //step over the anchor record by record, as records may be equal
+        //with different bytes (a missing line break at the end)
+        pa = wa[i]; pb = wb[j]; ra += i; rb += j;
+        for (size_t t = 0; t < Anchor && pa < A.Size() && pb < B.Size() && A.Same(pa, B, pb); ++t)
+            { pa = A.Next(pa); pb = B.Next(pb); ++ra; ++rb; }
+    }
+    return r;
+}
+
+/**
+ * Print hunks like a unified diff with no context. Records count from 1.
+ */
+void TraceDiffer::Print(const DiffResult &r, FILE* out) const {
+    for (const DiffHunk &h : r.hunks) {
+        fprintf(out, "@@ -%llu,%llu +%llu,%llu @@\n",
+                (unsigned long long)h.a_beg + 1, (unsigned long long)h.a_len,
+                (unsigned long long)h.b_beg + 1, (unsigned long long)h.b_len);
+        A.Print(h.a_pos, h.a_len, '-', out);
+        B.Print(h.b_pos, h.b_len, '+', out);
+    }
+    if (!r.aligned) { fprintf(out, "@@ no %zu equal records within %zu records, stopped @@\n", Anchor, Window); }
+    if (r.capped) { fprintf(out, "@@ stopped after %zu hunks @@\n", MaxHunks); }
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef HEAD_DIFFER_H
+#define HEAD_DIFFER_H
+
+#include "trfile.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+size_t SamePrefix(const char* a, const char* b, size_t n);
+size_t CountByte(const char* p, size_t n, char c);
+const char* SimdLevel();
+
+// One trace as a sequence of records: the lines of a text trace, or
+// the addresses of a chunked container, thread after thread. Records
+// are handled by their byte position, so equal runs are skipped on
+// the raw bytes and only the records around a divergence are split.
+class DiffSide
+{
+protected:
+    MappedFile            File;
+    std::vector<uint64_t> Words; //records of a chunked container
+    const char*           pData;
+    size_t                nSize;
+    bool                  Binary;
+public:
+    bool Open(const std::string &path);
+    bool IsBinary() const { return Binary; }
+    const char* Data() const { return pData; }
+    size_t Size() const { return nSize; }
+    uint64_t Records() const;
+    size_t Next(size_t pos) const;
+    uint64_t Hash(size_t pos) const;
+    bool Same(size_t pos, const DiffSide &o, size_t o_pos) const;
+    void Window(size_t pos, size_t n, std::vector<size_t> &out) const;
+    void Print(size_t pos, uint64_t n, char sign, FILE* out) const;
+    DiffSide();
+    DiffSide(const DiffSide &) = delete;
+    DiffSide &operator=(const DiffSide &) = delete;
+};
+
+// A region where two traces differ, in records from 0. Byte positions
+// of both starts are kept to print the region without a line index.
+struct DiffHunk
+{
+    uint64_t a_beg, a_len;
+    uint64_t b_beg, b_len;
+    size_t   a_pos, b_pos;
+};
+
+struct DiffResult
+{
+    uint64_t              a_recs;
+    uint64_t              b_recs;
+    std::vector<DiffHunk> hunks;
+    bool                  aligned; //false if the last hunk found no common run after it
+    bool                  capped;  //stopped at the limit of hunks
+};
+
+// Finds where two traces diverge and aligns them again. Equal runs
+// are skipped by vector compares. After a divergence, the next
+// `Anchor` equal records within `Window` records of both sides, with
+// the fewest records skipped in total, resync the traces.
+class TraceDiffer
+{
+protected:
+    DiffSide A, B;
+    size_t   Window;
+    size_t   Anchor;
+    size_t   MaxHunks;
+    bool Align(const std::vector<size_t> &wa, const std::vector<size_t> &wb,
+               size_t &i_out, size_t &j_out) const;
+public:
+    bool Open(const std::string &a_path, const std::string &b_path);
+    DiffResult Run() const;
+    void Print(const DiffResult &r, FILE* out) const;
+    TraceDiffer(size_t window, size_t anchor, size_t max_hunks);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,464 @@
+#include "grammar.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+// While building, a rule is `GRAM_RULE | <index>` instead of
+// `n_term + <index>`, so terminals of traces added later never
+// shift the rules of a loaded grammar.
+#define GRAM_RULE ((uint32_t) 1 << 31)
+// Separates traces in the sequence being built, never paired
+#define GRAM_SEP  ((uint32_t) -1)
+
+/**
+ * Append a number to the buffer as LEB128 varint
+ */
+static inline void PutVar(std::string &out, uint64_t v){
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+/**
+ * Read a LEB128 varint
+ * @return false if it runs out of the buffer
+ */
+static inline bool GetVar(const uint8_t* &p, const uint8_t* end, uint64_t &v){
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) { return true; }
+    }
+    return false;
+}
+
+/**
+ * Get the ID of a terminal, i.e. a distinct line
+ */
+uint32_t GramBuilder::Term(const char* s, size_t len){
+    std::string key(s, len);
+    auto it = TermIds.find(key);
+    if (it != TermIds.end()) { return it->second; }
+    const uint32_t id = static_cast<uint32_t>(Terms.size());
+    Terms.push_back(key);
+    TermIds.emplace(std::move(key), id);
+    return id;
+}
+
+/**
+ * Load an existing grammar, so traces added later share its rules
+ * @param path path of the grammar file
+ * @return false if it is not a valid grammar
+ */
+bool GramBuilder::Load(const std::string &path){
+    GramReader rd;
+    if (!rd.Open(path)) { return false; }
+    Terms.clear(); TermIds.clear(); Rules.clear(); Files.clear();
+    for (uint64_t t = 0; t < rd.NTerm; ++t) {
+        Terms.push_back(std::string(rd.File.Data() + rd.TermOff[t], rd.TermLen[t]));
+        TermIds[Terms.back()] = static_cast<uint32_t>(t);
+    }
+    const uint32_t n_term = static_cast<uint32_t>(rd.NTerm);
+    auto sym = [n_term](uint32_t s) { return (s < n_term) ? s : (GRAM_RULE | (s - n_term)); };
+    for (size_t r = 0; r < rd.RuleL.size(); ++r)
+        { Rules.push_back(std::make_pair(sym(rd.RuleL[r]), sym(rd.RuleR[r]))); }
+    Files.resize(rd.Refs.size());
+    for (size_t i = 0; i < rd.Refs.size(); ++i) {
+        Files[i].name  = rd.Refs[i].name;
+        Files[i].flags = rd.Refs[i].flags;
+        if (!rd.LoadTop(i, Files[i].top)) { return false; }
+        for (uint32_t &s : Files[i].top) { s = sym(s); }
+    }
+    return true;
+}
+
+/**
+ * Add a trace, or replace the trace of the same name.
+ * Its lines become terminals and no rule is made until `Build`.
+ * @param name name of the trace inside the grammar
+ * @param path path of the trace file
+ * @return false if it can not be read
+ */
+bool GramBuilder::AddFile(const std::string &name, const std::string &path){
+    MappedFile mf;
+    if (!mf.Open(path)) { return false; }
+    FileSeq fs;
+    fs.name  = name;
+    fs.flags = 0;
+    const char* p   = mf.Data();
+    const char* end = p + mf.Size();
+    if (p < end && end[-1] != '\n') { fs.flags |= GRAM_FLAG_NOEOL; }
+    while (p < end) {
+        const char* nl  = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        fs.top.push_back(Term(p, eol - p));
+        p = nl ? nl + 1 : end;
+    }
+    for (FileSeq &old : Files)
+        { if (old.name == name) { old = std::move(fs); return true; } }
+    Files.push_back(std::move(fs));
+    return true;
+}
+
+/**
+ * One round of pair replacement over the whole sequence.
+ * A pair already having a rule is always replaced, even if it is
+ * seen once. Other pairs seen twice or more get new rules, and
+ * those which end up replaced only once are reverted.
+ * @param seq top symbols of all traces, separated by `GRAM_SEP`
+ * @param pair_rule rule of each pair, updated with the new rules
+ * @return whether the sequence got shorter
+ */
+bool GramBuilder::Round(std::vector<uint32_t> &seq,
+                        std::unordered_map<uint64_t, uint32_t> &pair_rule)
+{
+    const size_t n = seq.size();
+    if (n < 2) { return false; }
+
+    //pairs inside a run like "a a a" overlap, so only every other counts
+    std::unordered_map<uint64_t, uint64_t> cnt;
+    bool run = false;
+    for (size_t i = 0; i + 1 < n; ++i) {
+        const uint32_t a = seq[i], b = seq[i + 1];
+        if (a == GRAM_SEP || b == GRAM_SEP) { run = false; continue; }
+        if (a == b && run) { run = false; continue; }
+        run = (a == b);
+        ++cnt[(static_cast<uint64_t>(a) << 32) | b];
+    }
+
+    //score of the pair at each position, 0 if it is not replaced
+    const uint64_t known = static_cast<uint64_t>(1) << 63;
+    auto score = [&](size_t i) -> uint64_t {
+        if (i + 1 >= n || seq[i] == GRAM_SEP || seq[i + 1] == GRAM_SEP) { return 0; }
+        const uint64_t key = (static_cast<uint64_t>(seq[i]) << 32) | seq[i + 1];
+        auto it = cnt.find(key);
+        const uint64_t c = (it != cnt.end()) ? it->second : 0;
+        if (pair_rule.count(key)) { return known | c; }
+        return (c >= 2) ? c : 0;
+    };
+    auto key_at = [&](size_t i) -> uint64_t {
+        return (static_cast<uint64_t>(seq[i]) << 32) | seq[i + 1];
+    };
+
+    const uint32_t first_new = GRAM_RULE | static_cast<uint32_t>(Rules.size());
+    std::vector<uint64_t> uses; //times each new rule is used
+    size_t reused = 0;
+    size_t w = 0, i = 0;
+    uint64_t s_here = score(0);
+    while (i < n) {
+        const uint64_t s_next = score(i + 1);
+        //where two pairs overlap, the more frequent (or the smaller on a tie) wins
+        if (s_here && (s_here > s_next || (s_here == s_next && key_at(i) <= key_at(i + 1)))) {
+            const uint64_t key = key_at(i);
+            auto it = pair_rule.find(key);
+            uint32_t sym;
+            if (it != pair_rule.end()) {
+                sym = it->second;
+                if (sym >= first_new) { ++uses[sym - first_new]; } else { ++reused; }
+            } else {
+                sym = GRAM_RULE | static_cast<uint32_t>(Rules.size());
+                Rules.push_back(std::make_pair(seq[i], seq[i + 1]));
+                pair_rule[key] = sym;
+                uses.push_back(1);
+            }
+            seq[w++] = sym;
+            i += 2;
+            s_here = score(i);
+        } else {
+            seq[w++] = seq[i++];
+            s_here = s_next;
+        }
+    }
+    seq.resize(w);
+
+    //new rules used once save nothing
+    std::vector<uint32_t> remap(uses.size());
+    uint32_t kept = 0;
+    for (size_t k = 0; k < uses.size(); ++k)
+        { remap[k] = (uses[k] >= 2) ? first_new + kept++ : GRAM_SEP; }
+    if (kept == uses.size()) { return kept || reused; }
+
+    std::vector<uint32_t> out;
+    out.reserve(seq.size() + uses.size());
+    for (uint32_t sym : seq) {
+        if (sym == GRAM_SEP || sym < first_new) { out.push_back(sym); continue; }
+        const uint32_t k = sym - first_new;
+        if (remap[k] != GRAM_SEP) { out.push_back(remap[k]); continue; }
+        out.push_back(Rules[sym & ~GRAM_RULE].first);
+        out.push_back(Rules[sym & ~GRAM_RULE].second);
+    }
+    seq.swap(out);
+    for (size_t k = 0; k < uses.size(); ++k) {
+        const std::pair<uint32_t, uint32_t> rp = Rules[(first_new & ~GRAM_RULE) + k];
+        const uint64_t key = (static_cast<uint64_t>(rp.first) << 32) | rp.second;
+        if (remap[k] == GRAM_SEP) { pair_rule.erase(key); continue; }
+        pair_rule[key] = remap[k];
+        Rules[remap[k] & ~GRAM_RULE] = rp;
+    }
+    Rules.resize((first_new & ~GRAM_RULE) + kept);
+    return kept || reused;
+}
+
+/**
+ * Drop the terminals and rules no trace refers to any more,
+ * e.g. those of a replaced trace, and number the rest again
+ */
+void GramBuilder::Prune(){
+    const uint32_t n_term = static_cast<uint32_t>(Terms.size());
+    auto at = [n_term](uint32_t sym) -> size_t
+        { return (sym & GRAM_RULE) ? n_term + (sym & ~GRAM_RULE) : sym; };
+    std::vector<char> live(n_term + Rules.size(), 0);
+    for (const FileSeq &fs : Files)
+        { for (uint32_t sym : fs.top) { live[at(sym)] = 1; } }
+    for (size_t r = Rules.size(); r-- > 0; ) {
+        if (!live[n_term + r]) { continue; }
+        live[at(Rules[r].first)]  = 1;
+        live[at(Rules[r].second)] = 1;
+    }
+    std::vector<uint32_t> remap(live.size());
+    std::vector<std::string> terms;
+    for (uint32_t t = 0; t < n_term; ++t) {
+        if (!live[t]) { continue; }
+        remap[t] = static_cast<uint32_t>(terms.size());
+        terms.push_back(std::move(Terms[t]));
+    }
+    std::vector<std::pair<uint32_t, uint32_t> > rules;
+    for (size_t r = 0; r < Rules.size(); ++r) {
+        if (!live[n_term + r]) { continue; }
+        remap[n_term + r] = GRAM_RULE | static_cast<uint32_t>(rules.size());
+        rules.push_back(std::make_pair(remap[at(Rules[r].first)], remap[at(Rules[r].second)]));
+    }
+    for (FileSeq &fs : Files)
+        { for (uint32_t &sym : fs.top) { sym = remap[at(sym)]; } }
+    Terms.swap(terms);
+    Rules.swap(rules);
+    TermIds.clear();
+    for (uint32_t t = 0; t < Terms.size(); ++t) { TermIds[Terms[t]] = t; }
+}
+
+/**
+ * Make rules over all traces added so far. Rules of a loaded grammar
+ * are kept and reused, so the traces added only get new rules for
+ * what the old ones have never seen.
+ */
+void GramBuilder::Build(){
+    std::unordered_map<uint64_t, uint32_t> pair_rule;
+    for (size_t r = 0; r < Rules.size(); ++r) {
+        const uint64_t key = (static_cast<uint64_t>(Rules[r].first) << 32) | Rules[r].second;
+        pair_rule.emplace(key, GRAM_RULE | static_cast<uint32_t>(r));
+    }
+
+    std::vector<uint32_t> seq;
+    for (FileSeq &fs : Files) {
+        seq.insert(seq.end(), fs.top.begin(), fs.top.end());
+        seq.push_back(GRAM_SEP);
+        std::vector<uint32_t>().swap(fs.top);
+    }
+    while (Round(seq, pair_rule)) {}
+
+    size_t f = 0;
+    for (uint32_t sym : seq) {
+        if (sym == GRAM_SEP) { ++f; continue; }
+        Files[f].top.push_back(sym);
+    }
+    Prune();
+}
+
+/**
+ * Write the grammar
+ * @param path path of the grammar file, replaced as a whole
+ * @return false if it fails to write
+ */
+bool GramBuilder::Save(const std::string &path){
+    const uint64_t n_term = Terms.size();
+    auto sym = [n_term](uint32_t s) -> uint64_t { return (s & GRAM_RULE) ? n_term + (s & ~GRAM_RULE) : s; };
+    std::string body;
+    for (const std::string &t : Terms) { PutVar(body, t.size()); body += t; }
+    for (const std::pair<uint32_t, uint32_t> &r : Rules) { PutVar(body, sym(r.first)); PutVar(body, sym(r.second)); }
+    for (const FileSeq &fs : Files) {
+        PutVar(body, fs.name.size());
+        body += fs.name;
+        PutVar(body, fs.flags);
+        PutVar(body, fs.top.size());
+        for (uint32_t s : fs.top) { PutVar(body, sym(s)); }
+    }
+
+    GramHead h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, GRAM_MAGIC, sizeof(GRAM_MAGIC));
+    h.version = GRAM_VERSION;
+    h.n_term  = Terms.size();
+    h.n_rule  = Rules.size();
+    h.n_file  = Files.size();
+
+    std::string tmp = path + ".tmp";
+    std::ofstream ofs(tmp.c_str(), std::ios::out|std::ios::trunc|std::ios::binary);
+    if (!ofs.is_open()) { return false; }
+    ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    ofs.write(body.data(), body.size());
+    ofs.close();
+    if (ofs.fail()) { std::remove(tmp.c_str()); return false; }
+    return 0 == std::rename(tmp.c_str(), path.c_str());
+}
+
+/**
+ * Constructor
+ */
+GramReader::GramReader(){
+    NTerm = 0;
+}
+
+/**
+ * Map a grammar file and check all of its sections
+ * @param path path of the grammar file
+ * @return false if it is not a valid grammar
+ */
+bool GramReader::Open(const std::string &path){
+    Close();
+    if (!File.Open(path) || File.Size() < sizeof(GramHead)) { return false; }
+    GramHead h;
+    memcpy(&h, File.Data(), sizeof(h));
+    if (0 != memcmp(h.magic, GRAM_MAGIC, sizeof(GRAM_MAGIC)) || h.version != GRAM_VERSION)
+        { Close(); return false; }
+
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(File.Data());
+    const uint8_t* p    = base + sizeof(GramHead);
+    const uint8_t* end  = base + File.Size();
+    uint64_t v, l, r;
+    NTerm = h.n_term;
+    for (uint64_t t = 0; t < h.n_term; ++t) {
+        if (!GetVar(p, end, v) || v > static_cast<uint64_t>(end - p)) { Close(); return false; }
+        TermOff.push_back(p - base);
+        TermLen.push_back(static_cast<uint32_t>(v));
+        p += v;
+    }
+    for (uint64_t k = 0; k < h.n_rule; ++k) {
+        if (!GetVar(p, end, l) || !GetVar(p, end, r) || l >= NTerm + k || r >= NTerm + k)
+            { Close(); return false; }
+        RuleL.push_back(static_cast<uint32_t>(l));
+        RuleR.push_back(static_cast<uint32_t>(r));
+        RuleLen.push_back((l < NTerm ? 1 : RuleLen[l - NTerm]) + (r < NTerm ? 1 : RuleLen[r - NTerm]));
+    }
+    for (uint64_t f = 0; f < h.n_file; ++f) {
+        FileRef fr;
+        if (!GetVar(p, end, v) || v > static_cast<uint64_t>(end - p)) { Close(); return false; }
+        fr.name.assign(reinterpret_cast<const char*>(p), v);
+        p += v;
+        if (!GetVar(p, end, fr.flags) || !GetVar(p, end, fr.n_top)) { Close(); return false; }
+        fr.off_top = p - base;
+        for (uint64_t k = 0; k < fr.n_top; ++k) {
+            if (!GetVar(p, end, v) || v >= NTerm + h.n_rule) { Close(); return false; }
+        }
+        Refs.push_back(fr);
+    }
+    return true;
+}
+
+/**
+ * Unmap the grammar and forget it
+ */
+void GramReader::Close(){
+    File.Close();
+    NTerm = 0;
+    TermOff.clear(); TermLen.clear();
+    RuleL.clear(); RuleR.clear(); RuleLen.clear();
+    Refs.clear();
+}
+
+/**
+ * Find a trace by name
+ * @return its index, or `FileCount()` if there is none
+ */
+size_t GramReader::FindFile(const std::string &name) const {
+    for (size_t i = 0; i < Refs.size(); ++i)
+        { if (Refs[i].name == name) { return i; } }
+    return Refs.size();
+}
+
+/**
+ * Decode the top symbols of a trace, checked by `Open` already
+ */
+bool GramReader::LoadTop(size_t i, std::vector<uint32_t> &top) const {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(File.Data());
+    const uint8_t* p    = base + Refs[i].off_top;
+    const uint8_t* end  = base + File.Size();
+    top.clear();
+    top.reserve(Refs[i].n_top);
+    uint64_t v;
+    for (uint64_t k = 0; k < Refs[i].n_top; ++k) {
+        if (!GetVar(p, end, v)) { return false; }
+        top.push_back(static_cast<uint32_t>(v));
+    }
+    return true;
+}
+
+/**
+ * Stream a trace out exactly as it was added
+ * @param i index of the trace
+ * @param out where the trace goes
+ * @return false if it fails to write
+ */
+bool GramReader::Expand(size_t i, FILE* out) const {
+    std::vector<uint32_t> top, stack;
+    if (!LoadTop(i, top)) { return false; }
+    bool first = true;
+    for (uint32_t sym : top) {
+        stack.push_back(sym);
+        while (!stack.empty()) {
+            const uint32_t s = stack.back();
+            stack.pop_back();
+            if (s >= NTerm) {
+                stack.push_back(RuleR[s - NTerm]);
+                stack.push_back(RuleL[s - NTerm]);
+                continue;
+            }
+            if (!first) { putc('\n', out); }
+            fwrite(File.Data() + TermOff[s], 1, TermLen[s], out);
+            first = false;
+        }
+    }
+    if (!first && !(Refs[i].flags & GRAM_FLAG_NOEOL)) { putc('\n', out); }
+    return 0 == ferror(out);
+}
+
+/**
+ * Number of lines of a trace, with no expansion
+ */
+uint64_t GramReader::Lines(size_t i) const {
+    std::vector<uint32_t> top;
+    if (!LoadTop(i, top)) { return 0; }
+    uint64_t n = 0;
+    for (uint32_t sym : top) { n += (sym < NTerm) ? 1 : RuleLen[sym - NTerm]; }
+    return n;
+}
+
+/**
+ * Count a line in every trace, with no expansion. The count of
+ * each rule is worked out once from those of its two symbols.
+ * @param line the whole line, like "0x401a2b"
+ * @param per_file recieves the count in each trace
+ */
+void GramReader::Occurrences(const std::string &line, std::vector<uint64_t> &per_file) const {
+    per_file.assign(Refs.size(), 0);
+    uint64_t term = NTerm;
+    for (uint64_t t = 0; t < NTerm; ++t) {
+        if (TermLen[t] == line.size() && 0 == memcmp(File.Data() + TermOff[t], line.data(), line.size()))
+            { term = t; break; }
+    }
+    if (term == NTerm) { return; }
+
+    std::vector<uint64_t> occ(RuleL.size());
+    auto of = [&](uint32_t sym) -> uint64_t {
+        return (sym < NTerm) ? (sym == term) : occ[sym - NTerm];
+    };
+    for (size_t k = 0; k < RuleL.size(); ++k) { occ[k] = of(RuleL[k]) + of(RuleR[k]); }
+
+    std::vector<uint32_t> top;
+    for (size_t i = 0; i < Refs.size(); ++i) {
+        if (!LoadTop(i, top)) { continue; }
+        for (uint32_t sym : top) { per_file[i] += of(sym); }
+    }
+}
\ No newline at end of file
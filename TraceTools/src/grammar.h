@@ -0,0 +1,107 @@
+#ifndef HEAD_GRAMMAR_H
+#define HEAD_GRAMMAR_H
+
+#include "trfile.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Layout of a grammar file (all in native byte order):
+//
+// | GramHead | terminals | rules | files |
+//
+// Terminals are the distinct lines of all traces, each as a varint
+// length and the bytes without the line break. A symbol below
+// `n_term` is a terminal, otherwise it is rule `symbol - n_term`.
+// Each rule is a pair of varint symbols, and only refers to symbols
+// below its own, so rules are in a topological order. Each file is
+// its varint name length, name, flags, number of top symbols and the
+// varint top symbols. All traces of a grammar share its terminals
+// and rules, so the same loop in different traces costs only once.
+
+#define GRAM_MAGIC      "TRGRAM"
+#define GRAM_VERSION    ((uint32_t) 1)
+#define GRAM_FLAG_NOEOL ((uint64_t) 1) //the last line has no line break
+
+struct GramHead
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t n_term;
+    uint64_t n_rule;
+    uint64_t n_file;
+};
+
+// Builds a grammar over traces Re-Pair-style: each round counts the
+// adjacent pairs of symbols, and pairs seen twice or more become new
+// rules, until no pair repeats. A round replaces all frequent pairs at
+// once, preferring the more frequent one where two overlap, instead of
+// the single most frequent pair of the original Re-Pair, so there
+// are a few rounds rather than one per rule.
+class GramBuilder
+{
+protected:
+    struct FileSeq
+    {
+        std::string           name;
+        uint64_t              flags;
+        std::vector<uint32_t> top;
+    };
+    std::vector<std::string>                  Terms;
+    std::unordered_map<std::string, uint32_t> TermIds;
+    std::vector<std::pair<uint32_t, uint32_t> > Rules;
+    std::vector<FileSeq>                      Files;
+    uint32_t Term(const char* s, size_t len);
+    bool Round(std::vector<uint32_t> &seq,
+               std::unordered_map<uint64_t, uint32_t> &pair_rule);
+    void Prune();
+public:
+    bool Load(const std::string &path);
+    bool AddFile(const std::string &name, const std::string &path);
+    void Build();
+    bool Save(const std::string &path);
+    size_t FileCount() const { return Files.size(); }
+};
+
+// Reads a grammar file by mapping it. Traces are streamed out by
+// expanding their rules, and counting queries work on the rules
+// with no expansion at all.
+class GramReader
+{
+    friend class GramBuilder;
+protected:
+    struct FileRef
+    {
+        std::string name;
+        uint64_t    flags;
+        uint64_t    n_top;
+        size_t      off_top; //offset of its top symbols in the mapping
+    };
+    MappedFile                File;
+    uint64_t                  NTerm;
+    std::vector<size_t>       TermOff; //offset of each terminal, plus the end
+    std::vector<uint32_t>     TermLen;
+    std::vector<uint32_t>     RuleL, RuleR;
+    std::vector<uint64_t>     RuleLen; //number of lines a rule expands to
+    std::vector<FileRef>      Refs;
+    bool LoadTop(size_t i, std::vector<uint32_t> &top) const;
+public:
+    bool Open(const std::string &path);
+    void Close();
+    size_t FileCount() const { return Refs.size(); }
+    const std::string &FileName(size_t i) const { return Refs[i].name; }
+    size_t FindFile(const std::string &name) const;
+    uint64_t TermCount() const { return NTerm; }
+    uint64_t RuleCount() const { return RuleL.size(); }
+    bool Expand(size_t i, FILE* out) const;
+    uint64_t Lines(size_t i) const;
+    void Occurrences(const std::string &line, std::vector<uint64_t> &per_file) const;
+    GramReader();
+    GramReader(const GramReader &) = delete;
+    GramReader &operator=(const GramReader &) = delete;
+};
+
+#endif
\ No newline at end of file
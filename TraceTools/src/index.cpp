@@ -0,0 +1,399 @@
+#include "index.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+/**
+ * Collect the distinct blocks (addresses in TrDat) and routines
+ * (names in TrSym) reached by one input.
+ * @param dat_path path of the trace file
+ * @param sym_path path of the trace symbol file, "" for none
+ * @param keys recieves the keys in sorted order
+ * @return false if any given file cannot be read
+ */
+bool CollectInputKeys(const std::string &dat_path, const std::string &sym_path,
+                      InputKeys &keys)
+{
+    keys.addrs.clear();
+    keys.names.clear();
+
+    MappedFile dat;
+    if (!dat.Open(dat_path)) { return false; }
+    const char* p   = dat.Data();
+    const char* end = p + dat.Size();
+    uint64_t addr;
+    while (ParseDatLine(p, end, addr))
+        { keys.addrs.push_back(addr); }
+    std::sort(keys.addrs.begin(), keys.addrs.end());
+    keys.addrs.erase(std::unique(keys.addrs.begin(), keys.addrs.end()), keys.addrs.end());
+
+    if (sym_path.size() == 0) { return true; }
+    MappedFile sym;
+    if (!sym.Open(sym_path)) { return false; }
+    p   = sym.Data();
+    end = p + sym.Size();
+    uint64_t tidv;
+    const char* s; size_t s_len;
+    const char* n; size_t n_len;
+    const char* last = nullptr; size_t last_len = 0;
+    std::unordered_set<std::string> names;
+    while (ParseSymLine(p, end, tidv, s, s_len)) {
+        SymRoutineName(s, s_len, n, n_len);
+        if (n_len == 0) { continue; }
+        //consecutive records mostly share the routine
+        if (last && last_len == n_len && 0 == memcmp(last, n, n_len)) { continue; }
+        last = n; last_len = n_len;
+        names.insert(std::string(n, n_len));
+    }
+    keys.names.assign(names.begin(), names.end());
+    std::sort(keys.names.begin(), keys.names.end());
+    return true;
+}
+
+/**
+ * Append a sorted list of IDs to the blob as varint deltas
+ * @param ids sorted input IDs
+ * @param blob recieves the encoded bytes
+ */
+void EncodePosting(const std::vector<uint32_t> &ids, std::string &blob){
+    uint32_t prev = 0;
+    for (uint32_t id : ids) {
+        uint32_t d = id - prev;
+        prev = id;
+        while (d >= 0x80) {
+            blob.push_back(static_cast<char>((d & 0x7f) | 0x80));
+            d >>= 7;
+        }
+        blob.push_back(static_cast<char>(d));
+    }
+}
+
+/**
+ * Decode a posting list made by `EncodePosting`
+ * @param p start of the encoded bytes
+ * @param len number of the encoded bytes
+ * @param ids recieves the input IDs
+ */
+void DecodePosting(const uint8_t* p, size_t len, std::vector<uint32_t> &ids){
+    ids.clear();
+    const uint8_t* end = p + len;
+    uint32_t prev = 0;
+    while (p < end) {
+        uint32_t d = 0;
+        int shift = 0;
+        while (p < end) {
+            uint8_t b = *p++;
+            d |= static_cast<uint32_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) { break; }
+            shift += 7;
+        }
+        prev += d;
+        ids.push_back(prev);
+    }
+}
+
+/**
+ * Whether [off, off + len) lies inside [0, room), without overflow
+ */
+static inline bool InRange(uint64_t off, uint64_t len, uint64_t room){
+    return off <= room && len <= room - off;
+}
+
+/**
+ * Check that the header and every entry fit the mapped file,
+ * so no string or posting list is read out of the mapping
+ */
+static const IdxHead* CheckHead(const MappedFile &mf){
+    const uint64_t size = mf.Size();
+    if (size < sizeof(IdxHead)) { return nullptr; }
+    const IdxHead* h = reinterpret_cast<const IdxHead*>(mf.Data());
+    if (0 != memcmp(h->magic, IDX_MAGIC, 4)) { return nullptr; }
+    if (h->version != IDX_VERSION) { return nullptr; }
+    if (!InRange(h->off_input, (uint64_t)h->n_input * sizeof(IdxInput), size)) { return nullptr; }
+    if (!InRange(h->off_addr,  (uint64_t)h->n_addr  * sizeof(IdxAddr),  size)) { return nullptr; }
+    if (!InRange(h->off_name,  (uint64_t)h->n_name  * sizeof(IdxName),  size)) { return nullptr; }
+    if (h->off_post > h->off_str || h->off_str > size) { return nullptr; }
+
+    //posting lists lie in [off_post, off_str) and strings in [off_str, size)
+    const uint64_t n_post = h->off_str - h->off_post;
+    const uint64_t n_str  = size - h->off_str;
+    const char* base = mf.Data();
+    const IdxInput* in_t = reinterpret_cast<const IdxInput*>(base + h->off_input);
+    const IdxAddr*  ad_t = reinterpret_cast<const IdxAddr*>(base + h->off_addr);
+    const IdxName*  nm_t = reinterpret_cast<const IdxName*>(base + h->off_name);
+    for (uint32_t i = 0; i < h->n_input; ++i)
+        { if (!InRange(in_t[i].str_off, in_t[i].str_len, n_str)) { return nullptr; } }
+    for (uint32_t i = 0; i < h->n_addr; ++i)
+        { if (!InRange(ad_t[i].post_off, ad_t[i].post_len, n_post)) { return nullptr; } }
+    for (uint32_t i = 0; i < h->n_name; ++i) {
+        if (!InRange(nm_t[i].str_off, nm_t[i].str_len, n_str) ||
+            !InRange(nm_t[i].post_off, nm_t[i].post_len, n_post)) { return nullptr; }
+    }
+    return h;
+}
+
+/**
+ * Load an existing index file into memory
+ * @param path path of the index file
+ * @return false if it is not a valid index
+ */
+bool IndexBuilder::Load(const std::string &path){
+    MappedFile mf;
+    if (!mf.Open(path)) { return false; }
+    const IdxHead* h = CheckHead(mf);
+    if (!h) { return false; }
+
+    const char*     base = mf.Data();
+    const char*     strs = base + h->off_str;
+    const uint8_t*  post = reinterpret_cast<const uint8_t*>(base + h->off_post);
+    const IdxInput* in_t = reinterpret_cast<const IdxInput*>(base + h->off_input);
+    const IdxAddr*  ad_t = reinterpret_cast<const IdxAddr*>(base + h->off_addr);
+    const IdxName*  nm_t = reinterpret_cast<const IdxName*>(base + h->off_name);
+
+    Inputs.clear();
+    AddrPost.clear();
+    NamePost.clear();
+    for (uint32_t i = 0; i < h->n_input; ++i) {
+        InputEntry e;
+        e.path.assign(strs + in_t[i].str_off, in_t[i].str_len);
+        e.dat = in_t[i].dat;
+        e.sym = in_t[i].sym;
+        Inputs.push_back(e);
+    }
+    for (uint32_t i = 0; i < h->n_addr; ++i)
+        { DecodePosting(post + ad_t[i].post_off, ad_t[i].post_len, AddrPost[ad_t[i].addr]); }
+    for (uint32_t i = 0; i < h->n_name; ++i) {
+        std::string name(strs + nm_t[i].str_off, nm_t[i].str_len);
+        DecodePosting(post + nm_t[i].post_off, nm_t[i].post_len, NamePost[name]);
+    }
+    return true;
+}
+
+/**
+ * Remove inputs from the index and renumber the rest.
+ * Relative order of the kept inputs does not change,
+ * so posting lists stay sorted.
+ * @param dead marks the inputs to remove, indexed by input ID
+ */
+void IndexBuilder::DropInputs(const std::vector<bool> &dead){
+    std::vector<uint32_t> remap(Inputs.size());
+    std::vector<InputEntry> kept;
+    for (size_t i = 0; i < Inputs.size(); ++i) {
+        remap[i] = static_cast<uint32_t>(kept.size());
+        if (!dead[i]) { kept.push_back(Inputs[i]); }
+    }
+    if (kept.size() == Inputs.size()) { return; }
+    Inputs.swap(kept);
+
+    auto rewrite = [&](std::vector<uint32_t> &ids) {
+        size_t w = 0;
+        for (uint32_t id : ids)
+            { if (!dead[id]) { ids[w++] = remap[id]; } }
+        ids.resize(w);
+    };
+    for (auto it = AddrPost.begin(); it != AddrPost.end();) {
+        rewrite(it->second);
+        if (it->second.empty()) { it = AddrPost.erase(it); } else { ++it; }
+    }
+    for (auto it = NamePost.begin(); it != NamePost.end();) {
+        rewrite(it->second);
+        if (it->second.empty()) { it = NamePost.erase(it); } else { ++it; }
+    }
+}
+
+/**
+ * Add a new input with its keys. The input always gets
+ * the largest ID so far, which keeps posting lists sorted.
+ * @param entry path and stamps of the input
+ * @param keys keys reached by the input
+ * @return ID of the new input
+ */
+uint32_t IndexBuilder::AddInput(const InputEntry &entry, const InputKeys &keys){
+    uint32_t id = static_cast<uint32_t>(Inputs.size());
+    Inputs.push_back(entry);
+    for (uint64_t a : keys.addrs) { AddrPost[a].push_back(id); }
+    for (const std::string &n : keys.names) { NamePost[n].push_back(id); }
+    return id;
+}
+
+/**
+ * Write the index into a file. The file is written aside
+ * and renamed at last, so readers never see a partial one.
+ * @param path path of the index file
+ * @return false if the file cannot be written
+ */
+bool IndexBuilder::Save(const std::string &path) const {
+    std::string strs, post;
+    std::vector<IdxInput> in_t;
+    std::vector<IdxAddr>  ad_t;
+    std::vector<IdxName>  nm_t;
+
+    for (const InputEntry &e : Inputs) {
+        IdxInput r;
+        memset(&r, 0, sizeof(r));
+        r.str_off = strs.size();
+        r.str_len = static_cast<uint32_t>(e.path.size());
+        r.dat = e.dat;
+        r.sym = e.sym;
+        strs += e.path;
+        in_t.push_back(r);
+    }
+
+    std::vector<uint64_t> addrs;
+    addrs.reserve(AddrPost.size());
+    for (const auto &kv : AddrPost) { addrs.push_back(kv.first); }
+    std::sort(addrs.begin(), addrs.end());
+    for (uint64_t a : addrs) {
+        const std::vector<uint32_t> &ids = AddrPost.at(a);
+        IdxAddr r;
+        r.addr = a;
+        r.post_off = post.size();
+        EncodePosting(ids, post);
+        r.post_len = static_cast<uint32_t>(post.size() - r.post_off);
+        r.count = static_cast<uint32_t>(ids.size());
+        ad_t.push_back(r);
+    }
+
+    std::vector<const std::string *> names;
+    names.reserve(NamePost.size());
+    for (const auto &kv : NamePost) { names.push_back(&kv.first); }
+    std::sort(names.begin(), names.end(),
+        [](const std::string *a, const std::string *b) { return *a < *b; });
+    for (const std::string *n : names) {
+        const std::vector<uint32_t> &ids = NamePost.at(*n);
+        IdxName r;
+        memset(&r, 0, sizeof(r));
+        r.str_off = strs.size();
+        r.str_len = static_cast<uint32_t>(n->size());
+        strs += *n;
+        r.post_off = post.size();
+        EncodePosting(ids, post);
+        r.post_len = static_cast<uint32_t>(post.size() - r.post_off);
+        r.count = static_cast<uint32_t>(ids.size());
+        nm_t.push_back(r);
+    }
+
+    IdxHead h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IDX_MAGIC, 4);
+    h.version   = IDX_VERSION;
+    h.n_input   = static_cast<uint32_t>(in_t.size());
+    h.n_addr    = static_cast<uint32_t>(ad_t.size());
+    h.n_name    = static_cast<uint32_t>(nm_t.size());
+    h.off_input = sizeof(IdxHead);
+    h.off_addr  = h.off_input + in_t.size() * sizeof(IdxInput);
+    h.off_name  = h.off_addr  + ad_t.size() * sizeof(IdxAddr);
+    h.off_post  = h.off_name  + nm_t.size() * sizeof(IdxName);
+    h.off_str   = h.off_post  + post.size();
+
+    std::string tmp = path + ".tmp";
+    std::ofstream ofs(tmp.c_str(), std::ios::out|std::ios::trunc|std::ios::binary);
+    if (!ofs.is_open()) { return false; }
+    ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    ofs.write(reinterpret_cast<const char*>(in_t.data()), in_t.size() * sizeof(IdxInput));
+    ofs.write(reinterpret_cast<const char*>(ad_t.data()), ad_t.size() * sizeof(IdxAddr));
+    ofs.write(reinterpret_cast<const char*>(nm_t.data()), nm_t.size() * sizeof(IdxName));
+    ofs.write(post.data(), post.size());
+    ofs.write(strs.data(), strs.size());
+    ofs.close();
+    if (ofs.fail()) { std::remove(tmp.c_str()); return false; }
+    return 0 == std::rename(tmp.c_str(), path.c_str());
+}
+
+/**
+ * Constructor
+ */
+IndexReader::IndexReader(){
+    pHead = nullptr;
+}
+
+/**
+ * Map an index file for queries
+ * @param path path of the index file
+ * @return false if it is not a valid index
+ */
+bool IndexReader::Open(const std::string &path){
+    pHead = nullptr;
+    if (!IdxFile.Open(path)) { return false; }
+    pHead = CheckHead(IdxFile);
+    return pHead != nullptr;
+}
+
+/**
+ * Get relative path of an input
+ * @param id input ID
+ * @return "" for a bad ID
+ */
+std::string IndexReader::InputPath(uint32_t id) const {
+    if (!pHead || id >= pHead->n_input) { return ""; }
+    const IdxInput* in_t = reinterpret_cast<const IdxInput*>(IdxFile.Data() + pHead->off_input);
+    return std::string(IdxFile.Data() + pHead->off_str + in_t[id].str_off, in_t[id].str_len);
+}
+
+/**
+ * Get the stamp of TrDat of an input when it was indexed
+ * @param id input ID
+ * @return zeros for a bad ID
+ */
+FileStamp IndexReader::InputDat(uint32_t id) const {
+    FileStamp st = { 0, 0 };
+    if (!pHead || id >= pHead->n_input) { return st; }
+    return reinterpret_cast<const IdxInput*>(IdxFile.Data() + pHead->off_input)[id].dat;
+}
+
+/**
+ * Walk the addresses in order, for tools reading the whole index
+ * @param k index of the address, below `NumAddrs()`
+ * @param ids recieves the sorted IDs of the inputs which reached it
+ * @return the address
+ */
+uint64_t IndexReader::AddrAt(uint32_t k, std::vector<uint32_t> &ids) const {
+    const IdxAddr &r = reinterpret_cast<const IdxAddr*>(IdxFile.Data() + pHead->off_addr)[k];
+    DecodePosting(reinterpret_cast<const uint8_t*>(IdxFile.Data() + pHead->off_post + r.post_off),
+                  r.post_len, ids);
+    return r.addr;
+}
+
+/**
+ * Find the inputs which reached a block or routine address
+ * @param addr the address
+ * @param ids recieves the sorted input IDs
+ * @return false if the address is not indexed
+ */
+bool IndexReader::FindAddr(uint64_t addr, std::vector<uint32_t> &ids) const {
+    ids.clear();
+    if (!pHead) { return false; }
+    const IdxAddr* lo = reinterpret_cast<const IdxAddr*>(IdxFile.Data() + pHead->off_addr);
+    const IdxAddr* hi = lo + pHead->n_addr;
+    const IdxAddr* it = std::lower_bound(lo, hi, addr,
+        [](const IdxAddr &r, uint64_t a) { return r.addr < a; });
+    if (it == hi || it->addr != addr) { return false; }
+    DecodePosting(reinterpret_cast<const uint8_t*>(IdxFile.Data() + pHead->off_post + it->post_off),
+                  it->post_len, ids);
+    return true;
+}
+
+/**
+ * Find the inputs which reached a routine
+ * @param name the routine name, case sensitive
+ * @param ids recieves the sorted input IDs
+ * @return false if the routine is not indexed
+ */
+bool IndexReader::FindName(const std::string &name, std::vector<uint32_t> &ids) const {
+    ids.clear();
+    if (!pHead) { return false; }
+    const char* strs = IdxFile.Data() + pHead->off_str;
+    const IdxName* lo = reinterpret_cast<const IdxName*>(IdxFile.Data() + pHead->off_name);
+    const IdxName* hi = lo + pHead->n_name;
+    const IdxName* it = std::lower_bound(lo, hi, name,
+        [strs](const IdxName &r, const std::string &n) {
+            return 0 < n.compare(0, std::string::npos, strs + r.str_off, r.str_len);
+        });
+    if (it == hi) { return false; }
+    if (0 != name.compare(0, std::string::npos, strs + it->str_off, it->str_len)) { return false; }
+    DecodePosting(reinterpret_cast<const uint8_t*>(IdxFile.Data() + pHead->off_post + it->post_off),
+                  it->post_len, ids);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef HEAD_INDEX_H
+#define HEAD_INDEX_H
+
+#include "trfile.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Layout of an index file (all in native byte order):
+//
+// | IdxHead | IdxInput[n_input] | IdxAddr[n_addr] | IdxName[n_name] | postings | strings |
+//
+// `IdxAddr` is sorted by address and `IdxName` is sorted by routine name,
+// so a query is just a binary search on the mapped file. Each posting
+// list is a sorted list of input IDs, stored as LEB128 varint deltas.
+
+#define IDX_MAGIC   "TRIX"
+#define IDX_VERSION ((uint32_t) 1)
+
+struct IdxHead
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t n_input;
+    uint32_t n_addr;
+    uint32_t n_name;
+    uint32_t reserved;
+    uint64_t off_input;
+    uint64_t off_addr;
+    uint64_t off_name;
+    uint64_t off_post;
+    uint64_t off_str;
+};
+
+struct IdxInput
+{
+    uint64_t  str_off;  //relative path of the input
+    uint32_t  str_len;
+    uint32_t  reserved;
+    FileStamp dat;      //stamp of TrDat when indexed
+    FileStamp sym;      //stamp of TrSym when indexed (zero if none)
+};
+
+struct IdxAddr
+{
+    uint64_t addr;
+    uint64_t post_off;
+    uint32_t post_len;  //bytes of the encoded posting list
+    uint32_t count;     //number of inputs in the posting list
+};
+
+struct IdxName
+{
+    uint64_t str_off;
+    uint64_t post_off;
+    uint32_t str_len;
+    uint32_t post_len;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+// Keys seen in the traces of one input
+struct InputKeys
+{
+    std::vector<uint64_t>    addrs;
+    std::vector<std::string> names;
+};
+
+// An indexed input
+struct InputEntry
+{
+    std::string path;
+    FileStamp   dat;
+    FileStamp   sym;
+};
+
+bool CollectInputKeys(const std::string &dat_path, const std::string &sym_path,
+                      InputKeys &keys);
+
+void EncodePosting(const std::vector<uint32_t> &ids, std::string &blob);
+void DecodePosting(const uint8_t* p, size_t len, std::vector<uint32_t> &ids);
+
+// Inverted index held in memory, for building and updating.
+class IndexBuilder
+{
+protected:
+    std::vector<InputEntry> Inputs;
+    std::unordered_map<uint64_t,    std::vector<uint32_t> > AddrPost;
+    std::unordered_map<std::string, std::vector<uint32_t> > NamePost;
+public:
+    bool Load(const std::string &path);
+    bool Save(const std::string &path) const;
+    const std::vector<InputEntry> &GetInputs() const { return Inputs; }
+    void DropInputs(const std::vector<bool> &dead);
+    uint32_t AddInput(const InputEntry &entry, const InputKeys &keys);
+};
+
+// Read-only view of an index file for queries.
+class IndexReader
+{
+protected:
+    MappedFile     IdxFile;
+    const IdxHead* pHead;
+public:
+    bool Open(const std::string &path);
+    uint32_t NumInputs() const { return pHead ? pHead->n_input : 0; }
+    std::string InputPath(uint32_t id) const;
+    FileStamp InputDat(uint32_t id) const;
+    uint32_t NumAddrs() const { return pHead ? pHead->n_addr : 0; }
+    uint64_t AddrAt(uint32_t k, std::vector<uint32_t> &ids) const;
+    bool FindAddr(uint64_t addr, std::vector<uint32_t> &ids) const;
+    bool FindName(const std::string &name, std::vector<uint32_t> &ids) const;
+    IndexReader();
+};
+
+#endif
\ No newline at end of file
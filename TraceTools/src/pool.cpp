@@ -0,0 +1,73 @@
+#include "pool.h"
+#include <thread>
+
+/**
+ * Constructor
+ * @param n_worker number of threads, 0 means the number of cores
+ */
+TaskPool::TaskPool(unsigned n_worker) :
+    Queues(n_worker ? n_worker :
+           (std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1)),
+    Turn(0)
+{
+}
+
+/**
+ * Submit a task before `Run`. Tasks are dealt to
+ * the workers in turn as their initial share.
+ * @param task the task
+ */
+void TaskPool::Push(Task task){
+    Queue &q = Queues[Turn++ % Queues.size()];
+    std::lock_guard<std::mutex> guard(q.lock);
+    q.tasks.push_back(task);
+}
+
+/**
+ * Get a task for a worker, from its own deque firstly
+ * @param self index of the worker
+ * @param task recieves the task
+ * @return false when all deques are empty
+ */
+bool TaskPool::Fetch(unsigned self, Task &task){
+    {
+        Queue &q = Queues[self];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            return true;
+        }
+    }
+    for (unsigned i = 1; i < Queues.size(); ++i) {
+        Queue &q = Queues[(self + i) % Queues.size()];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Loop of a worker. No task is pushed while running,
+ * so a worker finding nothing to fetch can leave.
+ * @param self index of the worker
+ */
+void TaskPool::Worker(unsigned self){
+    Task task;
+    while (Fetch(self, task)) { task(self); }
+}
+
+/**
+ * Run all submitted tasks and wait for them
+ */
+void TaskPool::Run(){
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < Queues.size(); ++i)
+        { threads.push_back(std::thread(&TaskPool::Worker, this, i)); }
+    Worker(0);
+    for (std::thread &t : threads) { t.join(); }
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef HEAD_POOL_H
+#define HEAD_POOL_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// A fixed-size pool of threads with work stealing.
+// Each worker owns a deque: it pops tasks from the back of its own
+// deque and, once that runs dry, steals from the front of others.
+// Tasks receive the index of the worker running them, so they can
+// use per-worker state without any lock.
+class TaskPool
+{
+public:
+    typedef std::function<void(unsigned)> Task;
+protected:
+    struct Queue
+    {
+        std::mutex       lock;
+        std::deque<Task> tasks;
+    };
+    std::vector<Queue> Queues;
+    unsigned           Turn;
+    bool Fetch(unsigned self, Task &task);
+    void Worker(unsigned self);
+public:
+    unsigned Size() const { return static_cast<unsigned>(Queues.size()); }
+    void Push(Task task);
+    void Run();
+    explicit TaskPool(unsigned n_worker);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "ringread.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Constructor
+ */
+RingReader::RingReader(){
+    pBase = nullptr;
+    nSize = 0;
+    pHead = nullptr;
+    pCtl  = nullptr;
+    pRec  = nullptr;
+    SymSeen = 0;
+}
+
+/**
+ * Destructor to release the mapping
+ */
+RingReader::~RingReader(){
+    Detach();
+}
+
+/**
+ * Whether a process still runs. A zombie is gone as well.
+ * @param pid the process, 0 for unknown which counts as running
+ */
+static bool PidAlive(uint32_t pid){
+    if (0 == pid) { return true; }
+    if (0 != kill(static_cast<pid_t>(pid), 0) && ESRCH == errno) { return false; }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+    FILE* f = fopen(path, "r");
+    if (!f) { return true; }
+    char state = 0;
+    const bool got = 1 == fscanf(f, "%*d (%*[^)]) %c", &state);
+    fclose(f);
+    return !(got && 'Z' == state);
+}
+
+/**
+ * Map the segment made by TracerCore. The producer may not have
+ * started yet, so wait until it is created and fully initialized.
+ * A segment whose producer is gone is left by an earlier run (e.g.
+ * with `-k`), and is only taken if no new producer replaces it in
+ * time, since it may still hold records nobody has read.
+ * @param name name of the segment, i.e. what follows 'shm:'
+ * @param wait_sec give up after these seconds
+ * @return false if no valid segment shows up in time
+ */
+bool RingReader::Attach(const std::string &name, unsigned wait_sec){
+    Detach();
+    ShmPath = std::string(SHM_DIR) + name;
+    const unsigned last = wait_sec * 100;
+    for (unsigned tick = 0; tick <= last; ++tick) {
+        if (tick) { usleep(10000); }
+        int fd = open(ShmPath.c_str(), O_RDWR);
+        if (fd < 0) { continue; }
+        struct stat st;
+        if (0 != fstat(fd, &st) || st.st_size < (off_t)sizeof(RingHead)) { close(fd); continue; }
+        void* mem = mmap(nullptr, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == mem) { return false; }
+
+        RingHead* h = static_cast<RingHead*>(mem);
+        if (0 != memcmp(h->magic, SHM_MAGIC, sizeof(h->magic))) {
+            munmap(mem, st.st_size);
+            continue;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (h->version != SHM_VERSION) { munmap(mem, st.st_size); return false; }
+        //the producer unlinks a stale segment before making its own
+        if (tick < last && !PidAlive(h->pid)) {
+            munmap(mem, st.st_size);
+            continue;
+        }
+
+        pBase = static_cast<char*>(mem);
+        nSize = st.st_size;
+        pHead = h;
+        pCtl  = reinterpret_cast<RingCtl*>(pBase + h->off_ctl);
+        pRec  = reinterpret_cast<RingRec*>(pBase + h->off_rec);
+        SymSeen = 0;
+        Syms.clear();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Unmap the segment
+ */
+void RingReader::Detach(){
+    if (pBase) { munmap(pBase, nSize); }
+    pBase = nullptr;
+    nSize = 0;
+    pHead = nullptr;
+}
+
+/**
+ * Remove the segment from the system. Mapped memory stays valid.
+ */
+void RingReader::Unlink(){
+    if (ShmPath.size()) { unlink(ShmPath.c_str()); }
+}
+
+/**
+ * Hand out all records available now and free their slots
+ * @param fn called with each contiguous span of records
+ * @return number of records handed out
+ */
+size_t RingReader::Poll(const Visitor &fn){
+    if (!pHead) { return 0; }
+    const uint64_t n_slot = pHead->n_slot;
+    const uint64_t mask = n_slot - 1;
+    size_t total = 0;
+    for (uint32_t i = 0; i < pHead->n_ring; ++i) {
+        RingCtl &c = pCtl[i];
+        if (!c.used.load(std::memory_order_acquire)) { continue; }
+        uint64_t head = c.head.load(std::memory_order_acquire);
+        uint64_t tail = c.tail.load(std::memory_order_relaxed);
+        if (head == tail) { continue; }
+
+        const RingRec* ring = pRec + i * n_slot;
+        uint64_t from = tail & mask;
+        uint64_t todo = head - tail;
+        uint64_t part = (from + todo > n_slot) ? n_slot - from : todo;
+        fn(ring + from, part);
+        if (part < todo) { fn(ring, todo - part); }
+
+        c.tail.store(head, std::memory_order_release);
+        total += todo;
+    }
+    return total;
+}
+
+/**
+ * Whether the producer has finished. Records pushed before that
+ * are still in the rings, so call `Poll` once more afterwards.
+ */
+bool RingReader::Closed() const {
+    return pHead && pHead->closed.load(std::memory_order_acquire);
+}
+
+/**
+ * Whether the producer process still runs. A killed producer never
+ * closes the segment, so stop once it is gone rather than wait for
+ * `Closed`, after a last `Poll`. A zombie is gone as well.
+ */
+bool RingReader::Alive() const {
+    return !pHead || PidAlive(pHead->pid);
+}
+
+/**
+ * Look up a symbol string by its ID
+ * @param id ID carried by a record
+ * @param str recieves the start of the string in shared memory
+ * @param len recieves length of the string
+ * @return false for ID 0 or an unknown ID
+ */
+bool RingReader::SymName(uint32_t id, const char* &str, size_t &len){
+    if (!pHead || 0 == id) { return false; }
+    if (id >= Syms.size()) {
+        uint64_t pub = pHead->sym_len.load(std::memory_order_acquire);
+        const char* arena = pBase + pHead->off_sym;
+        while (SymSeen < pub) {
+            const RingSym* ent = reinterpret_cast<const RingSym*>(arena + SymSeen);
+            if (ent->id >= Syms.size()) { Syms.resize(ent->id + 1, std::make_pair(nullptr, 0)); }
+            Syms[ent->id] = std::make_pair(reinterpret_cast<const char*>(ent + 1), ent->len);
+            SymSeen += SHM_SYM_ALIGN(sizeof(RingSym) + ent->len);
+        }
+        if (id >= Syms.size()) { return false; }
+    }
+    str = Syms[id].first;
+    len = Syms[id].second;
+    return str != nullptr;
+}
+
+/**
+ * Number of records dropped by full rings so far
+ */
+uint64_t RingReader::Drops() const {
+    if (!pHead) { return 0; }
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < pHead->n_ring; ++i)
+        { n += pCtl[i].drops.load(std::memory_order_relaxed); }
+    return n;
+}
+
+/**
+ * Number of records lost because their threads had no ring
+ */
+uint64_t RingReader::Lost() const {
+    return pHead ? pHead->lost.load(std::memory_order_relaxed) : 0;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef HEAD_RINGREAD_H
+#define HEAD_RINGREAD_H
+
+#include "shmring.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Consumer side of the shared-memory rings written by TracerCore
+// with `-TrDatPath shm:<name>`. Records are handed out as spans
+// pointing right into the shared memory, nothing is copied.
+class RingReader
+{
+public:
+    // Called with a contiguous span of records of one ring.
+    // The span is only valid during the call.
+    typedef std::function<void(const RingRec*, size_t)> Visitor;
+protected:
+    std::string   ShmPath;
+    char*         pBase;
+    size_t        nSize;
+    RingHead*     pHead;
+    RingCtl*      pCtl;
+    RingRec*      pRec;
+    uint64_t      SymSeen; //bytes of the arena parsed so far
+    std::vector<std::pair<const char*, uint32_t> > Syms; //indexed by ID
+public:
+    bool Attach(const std::string &name, unsigned wait_sec);
+    void Detach();
+    void Unlink();
+    size_t Poll(const Visitor &fn);
+    bool Closed() const;
+    bool Alive() const;
+    uint32_t Pid() const { return pHead ? pHead->pid : 0; }
+    bool SymName(uint32_t id, const char* &str, size_t &len);
+    uint64_t Drops() const;
+    uint64_t Lost() const;
+    uint32_t Policy() const { return pHead ? pHead->policy : 0; }
+    RingReader();
+    ~RingReader();
+    RingReader(const RingReader &) = delete;
+    RingReader &operator=(const RingReader &) = delete;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef HEAD_TMSG_H
+#define HEAD_TMSG_H
+
+#define GOOD_EXIT      ((int) 0)
+#define EVIL_EXIT_ARGV ((int) 10) //about command line args
+#define EVIL_EXIT_READ ((int) 20) //failed on reading traces or an index
+#define EVIL_EXIT_SAVE ((int) 21) //failed on writing outputs
+#define EVIL_EXIT_MISS ((int) 30) //nothing matched in a query
+
+#endif
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include "trfile.h"
+#include "trmap.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Constructor
+ */
+MappedFile::MappedFile(){
+    pData   = nullptr;
+    nSize   = 0;
+    pBase   = nullptr;
+    nMapped = 0;
+}
+
+/**
+ * Destructor to release the mapping
+ */
+MappedFile::~MappedFile(){
+    Close();
+}
+
+/**
+ * Map the whole file into memory as read-only.
+ * An opened file will be closed firstly.
+ * The header of a mapped trace is skipped, see `trmap.h`.
+ * @param path path of the file
+ * @return true for success or false for any failed syscall
+ */
+bool MappedFile::Open(const std::string &path){
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat st;
+    if (0 != fstat(fd, &st)) { close(fd); return false; }
+    if (0 == st.st_size) { close(fd); return true; }
+
+    void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == mem) { return false; }
+    madvise(mem, st.st_size, MADV_SEQUENTIAL);
+
+    pBase   = static_cast<const char*>(mem);
+    nMapped = st.st_size;
+    pData   = pBase;
+    nSize   = nMapped;
+    if (nMapped >= sizeof(MapHead) && 0 == memcmp(pBase, MAP_MAGIC, sizeof(MAP_MAGIC))) {
+        const uint64_t n = MapCommitted(reinterpret_cast<const MapHead*>(pBase), nMapped);
+        pData = n ? pBase + sizeof(MapHead) : nullptr;
+        nSize = n;
+    }
+    return true;
+}
+
+/**
+ * Unmap the file if it is mapped
+ */
+void MappedFile::Close(){
+    if (pBase) { munmap(const_cast<char*>(pBase), nMapped); }
+    pData   = nullptr;
+    nSize   = 0;
+    pBase   = nullptr;
+    nMapped = 0;
+}
+
+/**
+ * Get size and modification time of a file
+ * @param path path of the file
+ * @param stamp recieves the result
+ * @return false if the file cannot be stat
+ */
+bool GetFileStamp(const std::string &path, FileStamp &stamp){
+    struct stat st;
+    if (0 != stat(path.c_str(), &st)) { return false; }
+    stamp.fsize = st.st_size;
+    stamp.mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL
+                + static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    return true;
+}
+
+/**
+ * Join a directory path and a relative path
+ * @param dir directory path
+ * @param rel relative path
+ * @return the joined path
+ */
+std::string JoinPath(const std::string &dir, const std::string &rel){
+    if (dir.size() == 0) { return rel; }
+    if (dir[dir.size()-1] == '/') { return dir + rel; }
+    return dir + "/" + rel;
+}
+
+/**
+ * Walk the directory recursively like `os.walk(followlinks=True)`
+ * in TConsole and collect paths of all regular files.
+ * @param root directory acts like root
+ * @param prefix path of current directory relative to root
+ * @param rel_paths recieves paths relative to root
+ */
+static void WalkDir(const std::string &root, const std::string &prefix,
+                    std::vector<std::string> &rel_paths)
+{
+    DIR* dp = opendir(JoinPath(root, prefix).c_str());
+    if (!dp) { return; }
+    struct dirent* de;
+    while ((de = readdir(dp)) != nullptr) {
+        std::string name = de->d_name;
+        if (name == "." || name == "..") { continue; }
+        std::string rel = prefix.size() ? JoinPath(prefix, name) : name;
+
+        struct stat st;
+        if (0 != stat(JoinPath(root, rel).c_str(), &st)) { continue; }
+        if      (S_ISDIR(st.st_mode)) { WalkDir(root, rel, rel_paths); }
+        else if (S_ISREG(st.st_mode)) { rel_paths.push_back(rel); }
+    }
+    closedir(dp);
+}
+
+/**
+ * Collect all regular files under a directory recursively.
+ * Paths are sorted just like `check_all_file_from_dir` in TConsole.
+ * @param root directory acts like root
+ * @param rel_paths recieves paths relative to root
+ */
+void ListFiles(const std::string &root, std::vector<std::string> &rel_paths){
+    rel_paths.clear();
+    WalkDir(root, "", rel_paths);
+    std::sort(rel_paths.begin(), rel_paths.end());
+}
+
+/**
+ * Format a number like what `hexstr` of Pin gives, i.e. "0x401a2b"
+ * @param addr the number
+ * @return the hex string
+ */
+std::string HexStr(uint64_t addr){
+    char buf[24];
+    snprintf(buf, sizeof(buf), "0x%llx", static_cast<unsigned long long>(addr));
+    return buf;
+}
+
+/**
+ * Escape a string for JSON or DOT. CSV fields take `CsvQuote`.
+ */
+std::string Quote(const std::string &s){
+    std::string q = "\"";
+    for (char c : s) {
+        if      (c == '"')  { q += "\\\""; }
+        else if (c == '\\') { q += "\\\\"; }
+        else if ((unsigned char)c < 0x20) { q += ' '; }
+        else { q += c; }
+    }
+    return q + "\"";
+}
+
+/**
+ * Quote a string as a CSV field, doubling the quotes inside
+ */
+std::string CsvQuote(const std::string &s){
+    std::string q = "\"";
+    for (char c : s) {
+        if (c == '"') { q += '"'; }
+        q += c;
+    }
+    return q + "\"";
+}
+
+/**
+ * Read a hex number like what `hexstr` gives, i.e. "0x401a2b".
+ * The "0x" prefix is optional.
+ * @param p start of the number and will be moved after it
+ * @param end end of the buffer
+ * @param addr recieves the number
+ * @return false if no hex digit is found
+ */
+bool ParseHexAddr(const char* &p, const char* end, uint64_t &addr){
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) { p += 2; }
+    uint64_t v = 0;
+    const char* s = p;
+    for (; p < end; ++p) {
+        char c = *p;
+        if      (c >= '0' && c <= '9') { v = (v << 4) | (uint64_t)(c - '0'); }
+        else if (c >= 'a' && c <= 'f') { v = (v << 4) | (uint64_t)(c - 'a' + 10); }
+        else if (c >= 'A' && c <= 'F') { v = (v << 4) | (uint64_t)(c - 'A' + 10); }
+        else { break; }
+    }
+    addr = v;
+    return p != s;
+}
+
+/**
+ * Move to the beginning of next line
+ */
+static inline const char* NextLine(const char* p, const char* end){
+    const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    return nl ? nl + 1 : end;
+}
+
+/**
+ * Fetch the next record from a text trace file (TrDat).
+ * Each record is a line with an address. Lines which do
+ * not start with a hex number (like markers beginning
+ * with '#') are skipped.
+ * @param p current position and will be moved to next line
+ * @param end end of the buffer
+ * @param addr recieves the address
+ * @return false when the end of buffer is reached
+ */
+bool ParseDatLine(const char* &p, const char* end, uint64_t &addr){
+    while (p < end) {
+        const char* line = p;
+        p = NextLine(p, end);
+        if (ParseHexAddr(line, p, addr)) { return true; }
+    }
+    return false;
+}
+
+/**
+ * Fetch the next record from a text trace symbol file (TrSym).
+ * Each record is a line like "<thread ID>,<symbol string>".
+ * Malformed lines are skipped.
+ * @param p current position and will be moved to next line
+ * @param end end of the buffer
+ * @param tidv recieves the thread ID
+ * @param sym recieves the start of symbol string
+ * @param sym_len recieves length of symbol string
+ * @return false when the end of buffer is reached
+ */
+bool ParseSymLine(const char* &p, const char* end, uint64_t &tidv,
+                  const char* &sym, size_t &sym_len)
+{
+    while (p < end) {
+        const char* line = p;
+        p = NextLine(p, end);
+        if (!ParseHexAddr(line, p, tidv)) { continue; }
+        if (line >= p || *line != ',') { continue; }
+        sym = line + 1;
+        const char* tail = p;
+        if (tail > sym && tail[-1] == '\n') { --tail; }
+        if (tail > sym && tail[-1] == '\r') { --tail; }
+        sym_len = tail - sym;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Get the routine name from a symbol string made by `DumpSymInfo`.
+ * The string is either "<section name>+<offset>:<routine name>"
+ * or just "<routine name>" (with `-TrSecInfo 0`).
+ * @param sym start of the symbol string
+ * @param sym_len length of the symbol string
+ * @param name recieves the start of routine name
+ * @param name_len recieves length of routine name
+ */
+void SymRoutineName(const char* sym, size_t sym_len,
+                    const char* &name, size_t &name_len)
+{
+    name = sym; name_len = sym_len;
+    const char* end  = sym + sym_len;
+    const char* plus = static_cast<const char*>(memchr(sym, '+', sym_len));
+    if (!plus) { return; }
+    const char* p = plus + 1;
+    uint64_t offset;
+    if (!ParseHexAddr(p, end, offset)) { return; }
+    if (p >= end || *p != ':') { return; }
+    name = p + 1;
+    name_len = end - name;
+}
\ No newline at end of file
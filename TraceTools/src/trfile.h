@@ -0,0 +1,55 @@
+#ifndef HEAD_TRFILE_H
+#define HEAD_TRFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A read-only view of a whole file mapped by `mmap`.
+// Empty files are legal and have `Data() == nullptr`.
+// A trace written by `-TrDatPath map:<path>` (see `trmap.h`) is seen
+// without its header, and only up to its committed length, so it reads
+// as a plain trace even if the target was killed while writing it.
+class MappedFile
+{
+protected:
+    const char* pData;
+    size_t      nSize;
+    const char* pBase; //the whole mapping
+    size_t      nMapped;
+public:
+    bool Open(const std::string &path);
+    void Close();
+    const char* Data() const { return pData; }
+    size_t      Size() const { return nSize; }
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+// Size and modification time of a file, used to
+// find out traces which changed since last time.
+struct FileStamp
+{
+    uint64_t fsize;
+    uint64_t mtime;
+};
+
+bool GetFileStamp(const std::string &path, FileStamp &stamp);
+
+void ListFiles(const std::string &root, std::vector<std::string> &rel_paths);
+std::string JoinPath(const std::string &dir, const std::string &rel);
+
+std::string HexStr(uint64_t addr);
+std::string Quote(const std::string &s);
+std::string CsvQuote(const std::string &s);
+bool ParseHexAddr(const char* &p, const char* end, uint64_t &addr);
+bool ParseDatLine(const char* &p, const char* end, uint64_t &addr);
+bool ParseSymLine(const char* &p, const char* end, uint64_t &tidv,
+                  const char* &sym, size_t &sym_len);
+void SymRoutineName(const char* sym, size_t sym_len,
+                    const char* &name, size_t &name_len);
+
+#endif
\ No newline at end of file
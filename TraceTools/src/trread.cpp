@@ -0,0 +1,262 @@
+#include "trread.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * Constructor
+ */
+TraceReader::TraceReader(){
+    IsChunk = false;
+    Trunc   = false;
+    pDat    = nullptr;
+    pSym    = nullptr;
+    ChkNext = 0;
+    ChkPos  = 0;
+    ChkTid  = 0;
+    Syms.resize(1);
+}
+
+/**
+ * Map the outputs of a run
+ * @param dat_path path of TrDat, either text or a chunked container
+ * @param sym_path path of TrSym, or "" for none. Containers have none.
+ * @return false if a file can not be mapped or is malformed
+ */
+bool TraceReader::Open(const std::string &dat_path, const std::string &sym_path){
+    Close();
+    if (!Dat.Open(dat_path)) { return false; }
+    IsChunk = Dat.Size() >= sizeof(CHK_MAGIC) - 1 &&
+              0 == memcmp(Dat.Data(), CHK_MAGIC, sizeof(CHK_MAGIC) - 1);
+    if (IsChunk) {
+        Dat.Close();
+        if (sym_path.size() || !Chk.Open(dat_path)) { Close(); return false; }
+    } else if (sym_path.size() && !Sym.Open(sym_path)) {
+        Close();
+        return false;
+    }
+    Rewind();
+    return true;
+}
+
+/**
+ * Unmap everything and forget all symbols
+ */
+void TraceReader::Close(){
+    Dat.Close();
+    Sym.Close();
+    Chk.Close();
+    IsChunk = false;
+    Syms.resize(1);
+    SymIds.clear();
+    ChkBuf.clear();
+    Rewind();
+}
+
+/**
+ * Go back to the first record. Symbol IDs given so far are kept.
+ */
+void TraceReader::Rewind(){
+    Trunc   = false;
+    pDat    = Dat.Data();
+    pSym    = Sym.Data();
+    ChkNext = 0;
+    ChkPos  = 0;
+    ChkBuf.clear();
+}
+
+/**
+ * Get the ID of a symbol string, giving a new one if unseen
+ */
+uint32_t TraceReader::SymId(const char* p, size_t n){
+    SymSpan s = {p, n};
+    std::unordered_map<SymSpan, uint32_t, SymSpanHash>::iterator it = SymIds.find(s);
+    if (it != SymIds.end()) { return it->second; }
+    const uint32_t id = static_cast<uint32_t>(Syms.size());
+    Syms.push_back(s);
+    SymIds[s] = id;
+    return id;
+}
+
+/**
+ * Decode the next chunk which is not empty
+ * @return false when no chunk is left
+ */
+bool TraceReader::NextChunk(){
+    while (ChkNext < Chk.Chunks().size()) {
+        const size_t i = ChkNext++;
+        ChkPos = 0;
+        if (!Chk.Decode(i, ChkBuf)) { continue; } //damaged ones are skipped
+        ChkTid = Chk.Chunks()[i].tid;
+        if (ChkBuf.size()) { return true; }
+    }
+    ChkBuf.clear();
+    return false;
+}
+
+/**
+ * Fetch the next record
+ * @param rec recieves the record
+ * @return false at the end of the trace
+ */
+bool TraceReader::Next(TraceRec &rec){
+    if (IsChunk) {
+        if (ChkPos >= ChkBuf.size() && !NextChunk()) { return false; }
+        rec.addr = ChkBuf[ChkPos++];
+        rec.tid  = ChkTid;
+        rec.sym  = 0;
+        return true;
+    }
+    //lines of both files match one by one, markers included
+    const char* dat_end = Dat.Data() + Dat.Size();
+    while (pDat < dat_end) {
+        const char* line = pDat;
+        const char* nl = static_cast<const char*>(memchr(line, '\n', dat_end - line));
+        pDat = nl ? nl + 1 : dat_end;
+        const char* sline = pSym;
+        size_t slen = 0;
+        if (pSym) {
+            const char* sym_end = Sym.Data() + Sym.Size();
+            const char* snl = (pSym < sym_end) ? static_cast<const char*>(memchr(pSym, '\n', sym_end - pSym)) : nullptr;
+            pSym = snl ? snl + 1 : sym_end;
+            slen = (snl ? snl : sym_end) - sline;
+            if (slen && sline[slen - 1] == '\r') { --slen; }
+        }
+        const char* q = line;
+        if (!ParseHexAddr(q, pDat, rec.addr)) {
+            if (pDat - line >= 10 && 0 == memcmp(line, "#TRUNCATED", 10)) { Trunc = true; }
+            continue;
+        }
+        rec.tid = 0;
+        rec.sym = 0;
+        const char* s = sline;
+        if (slen && ParseHexAddr(s, sline + slen, rec.tid) && s < sline + slen && *s == ',')
+            { rec.sym = SymId(s + 1, sline + slen - s - 1); }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Fetch records in a batch
+ * @param recs recieves the records
+ * @param max size of `recs`
+ * @return number of records fetched, 0 at the end of the trace
+ */
+size_t TraceReader::Read(TraceRec* recs, size_t max){
+    size_t n = 0;
+    if (IsChunk) {
+        while (n < max) {
+            if (ChkPos >= ChkBuf.size() && !NextChunk()) { break; }
+            const size_t take = std::min(max - n, ChkBuf.size() - ChkPos);
+            for (size_t k = 0; k < take; ++k) {
+                recs[n + k].addr = ChkBuf[ChkPos + k];
+                recs[n + k].tid  = ChkTid;
+                recs[n + k].sym  = 0;
+            }
+            ChkPos += take;
+            n += take;
+        }
+        return n;
+    }
+    while (n < max && Next(recs[n])) { ++n; }
+    return n;
+}
+
+/**
+ * Get a symbol string by its ID
+ * @param id ID of the symbol
+ * @param str recieves the start of the string inside the mapping
+ * @param len recieves length of the string
+ * @return false for an unknown ID
+ */
+bool TraceReader::SymName(uint32_t id, const char* &str, size_t &len) const{
+    if (id == 0 || id >= Syms.size()) { return false; }
+    str = Syms[id].p;
+    len = Syms[id].n;
+    return true;
+}
+
+/**
+ * Open a reader, see `TraceReader::Open`
+ * @param dat_path path of TrDat
+ * @param sym_path path of TrSym, NULL or "" for none
+ * @return handle of the reader, or NULL for any failure
+ */
+void* trread_open(const char* dat_path, const char* sym_path){
+    TraceReader* rd = new TraceReader();
+    if (!rd->Open(dat_path, sym_path ? sym_path : "")) { delete rd; return nullptr; }
+    return rd;
+}
+
+/**
+ * Close a reader and free its handle
+ */
+void trread_close(void* rd){
+    delete static_cast<TraceReader*>(rd);
+}
+
+/**
+ * Go back to the first record
+ */
+void trread_rewind(void* rd){
+    static_cast<TraceReader*>(rd)->Rewind();
+}
+
+/**
+ * Fetch records in a batch, as columns
+ * @param rd handle of the reader
+ * @param addr recieves addresses, or NULL
+ * @param tid recieves thread IDs, or NULL
+ * @param sym recieves symbol IDs, or NULL
+ * @param max size of each column
+ * @return number of records fetched, 0 at the end of the trace
+ */
+size_t trread_next(void* rd, uint64_t* addr, uint64_t* tid, uint32_t* sym, size_t max){
+    TraceRec buf[4096];
+    size_t n = 0;
+    while (n < max) {
+        const size_t got = static_cast<TraceReader*>(rd)->Read(buf, std::min(max - n, sizeof(buf) / sizeof(buf[0])));
+        if (0 == got) { break; }
+        for (size_t k = 0; k < got; ++k) {
+            if (addr) { addr[n + k] = buf[k].addr; }
+            if (tid)  { tid[n + k]  = buf[k].tid;  }
+            if (sym)  { sym[n + k]  = buf[k].sym;  }
+        }
+        n += got;
+    }
+    return n;
+}
+
+/**
+ * Get a symbol string by its ID. The string is not NUL-terminated.
+ * @return start of the string, or NULL for an unknown ID
+ */
+const char* trread_sym(void* rd, uint32_t id, size_t* len){
+    const char* str;
+    size_t n;
+    if (!static_cast<TraceReader*>(rd)->SymName(id, str, n)) { return nullptr; }
+    if (len) { *len = n; }
+    return str;
+}
+
+/**
+ * Number of distinct symbol strings seen so far
+ */
+uint32_t trread_nsym(void* rd){
+    return static_cast<TraceReader*>(rd)->SymCount();
+}
+
+/**
+ * Whether the trace was cut by '-TrMaxEvents' / '-TrMaxBytes',
+ * known for text traces once the marker has been read
+ */
+int trread_truncated(void* rd){
+    return static_cast<TraceReader*>(rd)->Truncated() ? 1 : 0;
+}
+
+/**
+ * Whether the trace is a chunked container
+ */
+int trread_chunked(void* rd){
+    return static_cast<TraceReader*>(rd)->Chunked() ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef HEAD_TRREAD_H
+#define HEAD_TRREAD_H
+
+#include "trfile.h"
+#include "chunkread.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A record of a trace, whatever file it comes from
+struct TraceRec
+{
+    uint64_t addr;
+    uint64_t tid;  //thread ID in TrSym or of the chunk, 0 if unknown
+    uint32_t sym;  //ID of the symbol string, 0 for none
+};
+
+// Reader of TracerCore outputs behind one interface: a text trace
+// file (TrDat) with an optional trace symbol file (TrSym), or a
+// chunked container ('-TrDatPath chunk:<path>'), told by its magic.
+// Files are mapped and parsed in place. Symbol strings are never
+// copied: each distinct one gets an ID and points into the mapping.
+// Markers like "#TRUNCATED" are not records and are skipped.
+class TraceReader
+{
+protected:
+    // A symbol string inside the mapped TrSym
+    struct SymSpan
+    {
+        const char* p;
+        size_t      n;
+        bool operator==(const SymSpan &o) const
+            { return n == o.n && 0 == memcmp(p, o.p, n); }
+    };
+    struct SymSpanHash
+    {
+        size_t operator()(const SymSpan &s) const {
+            uint64_t h = 0xcbf29ce484222325ULL;
+            for (size_t i = 0; i < s.n; ++i) { h = (h ^ (unsigned char)s.p[i]) * 0x100000001b3ULL; }
+            return static_cast<size_t>(h);
+        }
+    };
+
+    MappedFile  Dat;
+    MappedFile  Sym;
+    ChunkReader Chk;
+    bool        IsChunk;
+    bool        Trunc;
+    const char* pDat;
+    const char* pSym;
+    size_t      ChkNext;  //next chunk to decode
+    size_t      ChkPos;   //next record in `ChkBuf`
+    uint32_t    ChkTid;
+    std::vector<uint64_t> ChkBuf;
+    std::vector<SymSpan>  Syms; //indexed by ID, 0 is unused
+    std::unordered_map<SymSpan, uint32_t, SymSpanHash> SymIds;
+
+    uint32_t SymId(const char* p, size_t n);
+    bool NextChunk();
+public:
+    // Input iterator for range-based for loops
+    class Iter
+    {
+    protected:
+        TraceReader* pRd;
+        TraceRec     Rec;
+    public:
+        Iter(TraceReader* rd) : pRd(rd) { if (pRd && !pRd->Next(Rec)) { pRd = nullptr; } }
+        const TraceRec &operator*() const { return Rec; }
+        const TraceRec* operator->() const { return &Rec; }
+        Iter &operator++() { if (!pRd->Next(Rec)) { pRd = nullptr; } return *this; }
+        bool operator!=(const Iter &o) const { return pRd != o.pRd; }
+    };
+
+    bool Open(const std::string &dat_path, const std::string &sym_path);
+    void Close();
+    void Rewind();
+    bool Next(TraceRec &rec);
+    size_t Read(TraceRec* recs, size_t max);
+    bool SymName(uint32_t id, const char* &str, size_t &len) const;
+    uint32_t SymCount() const { return static_cast<uint32_t>(Syms.size() - 1); }
+    bool Chunked() const { return IsChunk; }
+    bool Truncated() const { return Trunc || (IsChunk && Chk.Truncated()); }
+    Iter begin() { Rewind(); return Iter(this); }
+    Iter end() { return Iter(nullptr); }
+    TraceReader();
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+};
+
+// C interface of `TraceReader` for bindings (see TConsole).
+// Records come out as columns, and any column may be NULL.
+extern "C" {
+void*       trread_open(const char* dat_path, const char* sym_path);
+void        trread_close(void* rd);
+void        trread_rewind(void* rd);
+size_t      trread_next(void* rd, uint64_t* addr, uint64_t* tid, uint32_t* sym, size_t max);
+const char* trread_sym(void* rd, uint32_t id, size_t* len);
+uint32_t    trread_nsym(void* rd);
+int         trread_truncated(void* rd);
+int         trread_chunked(void* rd);
+}
+
+#endif
\ No newline at end of file